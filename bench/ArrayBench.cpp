@@ -0,0 +1,116 @@
+/**
+ * Benchmark of the containers used as a stack of executed commands
+ * Compares ResizableArray with its resize policies and DoublyLinkedList
+ * (with and without the node pool) when the stack is filled and emptied,
+ * and when it goes up and down around a capacity boundary
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+
+#include "CommandRecord.h"
+#include "DoublyLinkedList.h"
+#include "NodePool.h"
+#include "ResizableArray.h"
+
+typedef DoublyLinkedList<HistoryRecord> PlainList;
+typedef DoublyLinkedList<HistoryRecord, PoolAllocator<Node<HistoryRecord>>> PooledList;
+
+// Keeps the optimizer from dropping the measured loops
+static volatile long sink;
+
+static double NanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char *benchmark, const char *container, int size, double nsPerOp) {
+    printf("{\"benchmark\": \"%s\", \"container\": \"%s\", \"size\": %d, \"ns_per_op\": %.2f, "
+            "\"ops_per_sec\": %.0f}\n", benchmark, container, size, nsPerOp, 1e9 / nsPerOp);
+}
+
+static HistoryRecord Record(int i) {
+    return HistoryRecord(i & 1023, QueuedCommand(CommandType::GET, i & 255, i & 127, i & 15), -1, -1);
+}
+
+/**
+ * Pushes size records and pops them all, repeated until about
+ * totalOperations were done; the history grows and shrinks this way
+ * with EXECUTE and UNDO.
+ */
+template <typename Stack>
+static void BenchFill(const char *container, int size, long totalOperations) {
+    long rounds = totalOperations / (2L * size) > 0 ? totalOperations / (2L * size) : 1;
+    long checksum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long round = 0; round < rounds; round++) {
+        Stack stack;
+        for (int i = 0; i < size; i++) {
+            stack.addLast(Record(i));
+        }
+        while (!stack.isEmpty()) {
+            checksum += stack.removeLast().robotID();
+        }
+    }
+    double elapsed = NanosecondsSince(start);
+    sink = checksum;
+
+    Report("stack_fill", container, size, elapsed / (2.0 * rounds * size));
+}
+
+/**
+ * Goes from one record under a full capacity of size to one record over
+ * it and back, again and again; a policy that shrinks as soon as it can
+ * copies the whole array twice per round.
+ */
+template <typename Stack>
+static void BenchBoundary(const char *container, int size, long operations) {
+    Stack stack;
+    for (int i = 0; i < size - 1; i++) {
+        stack.addLast(Record(i));
+    }
+
+    long checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long i = 0; i < operations; i += 4) {
+        stack.addLast(Record((int) i));
+        stack.addLast(Record((int) i + 1));
+        checksum += stack.removeLast().robotID();
+        checksum += stack.removeLast().robotID();
+    }
+    double elapsed = NanosecondsSince(start);
+    sink = checksum;
+
+    Report("stack_boundary", container, size, elapsed / operations);
+}
+
+int main() {
+    // The capacities start at 5 and double, so these are all full capacities
+    const int sizes[] = { 1280, 81920, 1310720 };
+    const long fillOperations = 8000000;
+    const long boundaryOperations = 2000000;
+
+    for (int s = 0; s < 3; s++) {
+        int size = sizes[s];
+
+        BenchFill<ResizableArray<HistoryRecord> >("ResizableArray", size, fillOperations);
+        BenchFill<ResizableArray<HistoryRecord, EagerShrinkPolicy> >("ResizableArray+EagerShrink",
+                size, fillOperations);
+        BenchFill<ResizableArray<HistoryRecord, NeverShrinkPolicy> >("ResizableArray+NeverShrink",
+                size, fillOperations);
+        BenchFill<PlainList>("DoublyLinkedList", size, fillOperations);
+        BenchFill<PooledList>("DoublyLinkedList+NodePool", size, fillOperations);
+
+        BenchBoundary<ResizableArray<HistoryRecord> >("ResizableArray", size, boundaryOperations);
+        // Every round copies the whole array, so the rounds copy 2^25 records in all
+        BenchBoundary<ResizableArray<HistoryRecord, EagerShrinkPolicy> >("ResizableArray+EagerShrink",
+                size, 4L * ((1 << 24) / size));
+        BenchBoundary<ResizableArray<HistoryRecord, NeverShrinkPolicy> >("ResizableArray+NeverShrink",
+                size, boundaryOperations);
+        BenchBoundary<PooledList>("DoublyLinkedList+NodePool", size, boundaryOperations);
+    }
+
+    return 0;
+}
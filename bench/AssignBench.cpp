@@ -0,0 +1,94 @@
+/**
+ * Benchmark of the assignment of pending tasks to robots
+ * Compares OptimalAssignment with GreedyAssignment on batches of 1k to
+ * 100k tasks scattered over a grid, the robots starting at random cells
+ * with random queues; travel is the Manhattan distance
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <vector>
+
+#include "TaskAssignment.h"
+
+const int GRID_SIZE = 1000;
+const int NUMBER_ROBOTS = 64;
+const int MAX_QUEUE = 16;
+
+static uint64_t NextRandom(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Manhattan distance between the robots and the tasks
+struct GridTravel {
+    const std::vector<int> &robotX;
+    const std::vector<int> &robotY;
+    const std::vector<int> &taskX;
+    const std::vector<int> &taskY;
+
+    int operator()(int robot, int task) const {
+        return std::abs(robotX[robot] - taskX[task]) + std::abs(robotY[robot] - taskY[task]);
+    }
+};
+
+static void BenchAssignment(int numberTasks, int queueWeight) {
+    uint64_t state = 0x853C49E6748FEA9Bull + numberTasks;
+    std::vector<int> robotX(NUMBER_ROBOTS), robotY(NUMBER_ROBOTS), queueLengths(NUMBER_ROBOTS);
+    for (int r = 0; r < NUMBER_ROBOTS; r++) {
+        robotX[r] = (int) (NextRandom(state) % GRID_SIZE);
+        robotY[r] = (int) (NextRandom(state) % GRID_SIZE);
+        queueLengths[r] = (int) (NextRandom(state) % MAX_QUEUE);
+    }
+    std::vector<int> taskX(numberTasks), taskY(numberTasks);
+    for (int t = 0; t < numberTasks; t++) {
+        taskX[t] = (int) (NextRandom(state) % GRID_SIZE);
+        taskY[t] = (int) (NextRandom(state) % GRID_SIZE);
+    }
+    GridTravel travel = { robotX, robotY, taskX, taskY };
+
+    std::vector<int> assigned;
+    const char *variants[2] = { "greedy", "optimal" };
+    for (int v = 0; v < 2; v++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (v == 0) {
+            GreedyAssignment(numberTasks, queueLengths, queueWeight, travel, assigned);
+        } else {
+            OptimalAssignment(numberTasks, queueLengths, queueWeight, travel, assigned);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // The longest queue once the batch is assigned
+        std::vector<int> load(queueLengths);
+        int longestQueue = 0;
+        for (int t = 0; t < numberTasks; t++) {
+            longestQueue = std::max(longestQueue, ++load[assigned[t]]);
+        }
+
+        printf("{\"benchmark\": \"assign_batch\", \"variant\": \"%s\", \"tasks\": %d, \"robots\": %d, "
+                "\"queue_weight\": %d, \"total_cost\": %lld, \"longest_queue\": %d, "
+                "\"ns_per_task\": %.0f, \"tasks_per_sec\": %.0f}\n",
+                variants[v], numberTasks, NUMBER_ROBOTS, queueWeight,
+                AssignmentCost(assigned, queueLengths, queueWeight, travel), longestQueue,
+                seconds * 1e9 / numberTasks, numberTasks / seconds);
+    }
+}
+
+int main() {
+    const int taskCounts[] = { 1000, 10000, 100000 };
+    const int queueWeights[] = { 0, 10 };
+
+    for (int t = 0; t < 3; t++) {
+        for (int w = 0; w < 2; w++) {
+            BenchAssignment(taskCounts[t], queueWeights[w]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * Benchmark of concurrent EXECUTE commands on a shared map
+ * Compares Warehouse::ExecuteConcurrent (striped cell locks) with a
+ * single lock around Warehouse::Execute, while more and more of the
+ * robots work on a handful of hot cells
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "Warehouse.h"
+
+const int NUMBER_ROBOTS = 64;
+const int MAP_SIZE = 256;
+const int HOT_CELLS = 4;
+const long OPERATIONS_PER_THREAD = 200000;
+
+// A command prepared before the measurement
+struct PlannedCommand {
+    int robotID;
+    int x;
+    int y;
+    int numberBoxes;
+    bool isGet;
+};
+
+static uint64_t NextRandom(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+/**
+ * The commands of one thread, for the robots with robotID % numberThreads
+ * == thread; the first hotRobots robots only work on the hot cells.
+ */
+static std::vector<PlannedCommand> PlanCommands(int thread, int numberThreads, int hotRobots) {
+    std::vector<PlannedCommand> commands;
+    commands.reserve(OPERATIONS_PER_THREAD);
+    uint64_t state = 0x2545F4914F6CDD1Dull + thread;
+
+    std::vector<int> ownRobots;
+    for (int robotID = thread; robotID < NUMBER_ROBOTS; robotID += numberThreads) {
+        ownRobots.push_back(robotID);
+    }
+
+    for (long i = 0; i < OPERATIONS_PER_THREAD; i++) {
+        PlannedCommand command;
+        command.robotID = ownRobots[i % ownRobots.size()];
+        if (command.robotID < hotRobots) {
+            int hotCell = (int) (NextRandom(state) % HOT_CELLS);
+            command.x = hotCell;
+            command.y = hotCell;
+        } else {
+            command.x = (int) (NextRandom(state) % MAP_SIZE);
+            command.y = (int) (NextRandom(state) % MAP_SIZE);
+        }
+        command.numberBoxes = (int) (NextRandom(state) % 8);
+        command.isGet = (i & 1) == 0;
+        commands.push_back(command);
+    }
+    return commands;
+}
+
+static void Queue(Warehouse &warehouse, const PlannedCommand &command) {
+    if (command.isGet) {
+        warehouse.AddGetBox(command.robotID, command.x, command.y, command.numberBoxes, 0);
+    } else {
+        warehouse.AddDropBox(command.robotID, command.x, command.y, command.numberBoxes, 0);
+    }
+}
+
+static void BenchContention(bool striped, int numberThreads, int hotRobots) {
+    Warehouse warehouse(NUMBER_ROBOTS, MAP_SIZE, MAP_SIZE);
+    for (int x = 0; x < MAP_SIZE; x++) {
+        for (int y = 0; y < MAP_SIZE; y++) {
+            warehouse.SetMapValue(x, y, 10);
+        }
+    }
+
+    std::vector<std::vector<PlannedCommand> > plans;
+    for (int t = 0; t < numberThreads; t++) {
+        plans.push_back(PlanCommands(t, numberThreads, hotRobots));
+    }
+
+    std::mutex globalLock;
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int t = 0; t < numberThreads; t++) {
+        threads.push_back(std::thread([&, t] {
+            const std::vector<PlannedCommand> &plan = plans[t];
+            for (size_t i = 0; i < plan.size(); i++) {
+                // Every thread only queues commands for its own robots
+                Queue(warehouse, plan[i]);
+                if (striped) {
+                    warehouse.ExecuteConcurrent(plan[i].robotID);
+                } else {
+                    std::lock_guard<std::mutex> guard(globalLock);
+                    warehouse.Execute(plan[i].robotID);
+                }
+            }
+        }));
+    }
+    for (int t = 0; t < numberThreads; t++) {
+        threads[t].join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    warehouse.CommitConcurrentHistory();
+
+    double operations = (double) OPERATIONS_PER_THREAD * numberThreads;
+    printf("{\"benchmark\": \"execute_contention\", \"variant\": \"%s\", \"threads\": %d, "
+            "\"robots\": %d, \"hot_robots\": %d, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}\n",
+            striped ? "striped" : "global_lock", numberThreads, NUMBER_ROBOTS, hotRobots,
+            seconds * 1e9 / operations, operations / seconds);
+}
+
+int main() {
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    const int hotRobotCounts[] = { 0, 8, 32, 64 };
+
+    for (int t = 0; t < 4; t++) {
+        for (int h = 0; h < 4; h++) {
+            BenchContention(true, threadCounts[t], hotRobotCounts[h]);
+            BenchContention(false, threadCounts[t], hotRobotCounts[h]);
+        }
+    }
+
+    return 0;
+}
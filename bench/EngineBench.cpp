@@ -0,0 +1,226 @@
+/**
+ * Benchmark of the Warehouse engine
+ * Times Execute, Undo, UndoMany and PrintCommands on their own, then whole
+ * generated workloads (see WorkloadGenerator) run the way tema1 runs
+ * robots.in, parsing included
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+
+#include "Scenario.h"
+#include "Warehouse.h"
+#include "Workload.h"
+
+const int NUMBER_ROBOTS = 64;
+const int MAP_SIZE = 256;
+const int COMMANDS_PER_ROBOT = 16384;
+
+// Keeps the optimizer from dropping the measured loops
+static volatile long sink;
+
+static uint64_t NextRandom(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static double NanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char *benchmark, long operations, double nanoseconds) {
+    printf("{\"benchmark\": \"%s\", \"operations\": %ld, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}\n",
+            benchmark, operations, nanoseconds / operations, operations * 1e9 / nanoseconds);
+}
+
+static void FillMap(Warehouse &warehouse, uint64_t &state) {
+    for (int x = 0; x < MAP_SIZE; x++) {
+        for (int y = 0; y < MAP_SIZE; y++) {
+            warehouse.SetMapValue(x, y, (int) (NextRandom(state) % 21));
+        }
+    }
+}
+
+static void QueueRandomCommands(Warehouse &warehouse, int robotID, int count, uint64_t &state) {
+    for (int i = 0; i < count; i++) {
+        int x = (int) (NextRandom(state) % MAP_SIZE);
+        int y = (int) (NextRandom(state) % MAP_SIZE);
+        int numberBoxes = 1 + (int) (NextRandom(state) % 10);
+        if (NextRandom(state) & 1) {
+            warehouse.AddGetBox(robotID, x, y, numberBoxes, 1);
+        } else {
+            warehouse.AddDropBox(robotID, x, y, numberBoxes, 1);
+        }
+    }
+}
+
+/**
+ * Executes every queued command, the robots taking turns, then undoes
+ * them all, so the history grows to a million records and back.
+ */
+static void BenchExecuteUndo() {
+    uint64_t state = 0x243F6A8885A308D3ull;
+    Warehouse warehouse(NUMBER_ROBOTS, MAP_SIZE, MAP_SIZE);
+    FillMap(warehouse, state);
+    for (int robotID = 0; robotID < NUMBER_ROBOTS; robotID++) {
+        QueueRandomCommands(warehouse, robotID, COMMANDS_PER_ROBOT, state);
+    }
+
+    long operations = (long) NUMBER_ROBOTS * COMMANDS_PER_ROBOT;
+    long executed = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < COMMANDS_PER_ROBOT; i++) {
+        for (int robotID = 0; robotID < NUMBER_ROBOTS; robotID++) {
+            executed += warehouse.Execute(robotID) == STATUS_EXECUTED;
+        }
+    }
+    Report("execute", operations, NanosecondsSince(start));
+
+    long undone = 0;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < operations; i++) {
+        undone += warehouse.Undo() == STATUS_EXECUTED;
+    }
+    Report("undo", operations, NanosecondsSince(start));
+    sink = executed + undone;
+}
+
+/**
+ * Executes GETs on a MAP_SIZE x MAP_SIZE map, four per cell on average,
+ * then undoes them all with UNDO <count>
+ */
+static void BenchUndoMany(long count, bool regionIndex) {
+    uint64_t state = 0xA4093822299F31D0ull + count;
+    WarehouseOptions options;
+    options.regionIndex = regionIndex;
+    Warehouse warehouse(NUMBER_ROBOTS, MAP_SIZE, MAP_SIZE, options);
+    FillMap(warehouse, state);
+    warehouse.FinishLoading();
+    for (int robotID = 0; robotID < NUMBER_ROBOTS; robotID++) {
+        for (int i = 0; i < COMMANDS_PER_ROBOT / 4; i++) {
+            int x = (int) (NextRandom(state) % MAP_SIZE);
+            int y = (int) (NextRandom(state) % MAP_SIZE);
+            warehouse.AddGetBox(robotID, x, y, 1 + (int) (NextRandom(state) % 10), 1);
+        }
+    }
+    for (int i = 0; i < COMMANDS_PER_ROBOT / 4; i++) {
+        for (int robotID = 0; robotID < NUMBER_ROBOTS; robotID++) {
+            warehouse.Execute(robotID);
+        }
+    }
+
+    long undone = 0, calls = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long done = count; done == count; calls++) {
+        done = warehouse.UndoMany(count);
+        undone += done;
+    }
+    double elapsed = NanosecondsSince(start);
+    printf("{\"benchmark\": \"undo_many\", \"count\": %ld, \"region_index\": %s, \"operations\": %ld, "
+            "\"ns_per_command\": %.2f, \"commands_per_sec\": %.0f}\n",
+            count, regionIndex ? "true" : "false", undone, elapsed / undone, undone * 1e9 / elapsed);
+    sink = calls;
+}
+
+// Lists a queue of the given depth over and over
+static void BenchPrintCommands(int depth) {
+    uint64_t state = 0x13198A2E03707344ull + depth;
+    Warehouse warehouse(1, MAP_SIZE, MAP_SIZE);
+    FillMap(warehouse, state);
+    QueueRandomCommands(warehouse, 0, depth, state);
+
+    OutputBuffer discarded(NULL);
+    long calls = 8000000 / depth;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++) {
+        warehouse.PrintCommands(0, discarded);
+    }
+    double elapsed = NanosecondsSince(start);
+
+    printf("{\"benchmark\": \"print_commands\", \"depth\": %d, \"operations\": %ld, "
+            "\"ns_per_op\": %.2f, \"ns_per_command\": %.2f, \"ops_per_sec\": %.0f}\n",
+            depth, calls, elapsed / calls, elapsed / ((double) calls * depth), calls * 1e9 / elapsed);
+}
+
+// Writes the generated robots.in to a temporary file and runs it as tema1 does
+static void BenchWorkload(const char *name, const WorkloadSettings &workload) {
+    std::string text;
+    WorkloadGenerator(workload, text).generate();
+
+    char path[] = "/tmp/engine_benchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, text.data(), text.size()) != (ssize_t) text.size()) {
+        printf("{\"benchmark\": \"workload\", \"name\": \"%s\", \"error\": \"no temporary file\"}\n", name);
+        if (fd >= 0) {
+            close(fd);
+            unlink(path);
+        }
+        return;
+    }
+    close(fd);
+
+    ScenarioSettings settings;
+    ScenarioResult result;
+    ScenarioStatus status = RunScenario(path, "/dev/null", settings, result);
+    unlink(path);
+    if (status != SCENARIO_DONE) {
+        printf("{\"benchmark\": \"workload\", \"name\": \"%s\", \"error\": \"%s\"}\n",
+                name, ScenarioStatusMessage(status));
+        return;
+    }
+
+    printf("{\"benchmark\": \"workload\", \"name\": \"%s\", \"seed\": %llu, \"robots\": %d, "
+            "\"rows\": %d, \"columns\": %d, \"undo_percent\": %d, \"queue_depth\": %d, "
+            "\"queue_limit\": %d, \"commands\": %lld, \"ns_per_command\": %.2f, \"commands_per_sec\": %.0f}\n",
+            name, (unsigned long long) workload.seed, workload.numberRobots, workload.numberRows,
+            workload.numberColumns, workload.undoPercent, workload.queueDepth, workload.queueLimit,
+            result.numberCommands, result.seconds * 1e9 / result.numberCommands,
+            result.numberCommands / result.seconds);
+}
+
+int main() {
+    BenchExecuteUndo();
+
+    const long counts[] = { 1, 16, 1024 };
+    for (int c = 0; c < 3; c++) {
+        BenchUndoMany(counts[c], false);
+        BenchUndoMany(counts[c], true);
+    }
+
+    const int depths[] = { 16, 256, 4096 };
+    for (int d = 0; d < 3; d++) {
+        BenchPrintCommands(depths[d]);
+    }
+
+    WorkloadSettings workload;
+    workload.numberCommands = 1000000;
+    BenchWorkload("mixed", workload);
+
+    WorkloadSettings undoHeavy = workload;
+    undoHeavy.undoPercent = 30;
+    undoHeavy.addWeight = 20;
+    undoHeavy.executeWeight = 65;
+    BenchWorkload("undo_heavy", undoHeavy);
+
+    WorkloadSettings deepQueues = workload;
+    deepQueues.queueDepth = 1024;
+    deepQueues.queueLimit = 2048;
+    deepQueues.queryWeight = 2;
+    BenchWorkload("deep_queues", deepQueues);
+
+    WorkloadSettings largeGrid = workload;
+    largeGrid.numberRobots = 1024;
+    largeGrid.numberRows = 2048;
+    largeGrid.numberColumns = 2048;
+    BenchWorkload("large_grid", largeGrid);
+
+    return 0;
+}
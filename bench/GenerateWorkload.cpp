@@ -0,0 +1,74 @@
+/**
+ * Writes a generated robots.in, see WorkloadGenerator
+ *
+ * Usage: gen_workload [--seed n] [--robots n] [--rows n] [--columns n]
+ *        [--commands n] [--mix add,execute,query] [--undo percent]
+ *        [--queue-depth n] [--queue-limit n] [--max-boxes n] [--output file]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Workload.h"
+
+int main(int argc, char *argv[]) {
+    WorkloadSettings settings;
+    const char *outputPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            settings.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--robots") == 0 && i + 1 < argc) {
+            settings.numberRobots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            settings.numberRows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc) {
+            settings.numberColumns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--commands") == 0 && i + 1 < argc) {
+            settings.numberCommands = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d", &settings.addWeight, &settings.executeWeight,
+                    &settings.queryWeight) != 3) {
+                printf("The mix must be given as add,execute,query weights.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--undo") == 0 && i + 1 < argc) {
+            settings.undoPercent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--queue-depth") == 0 && i + 1 < argc) {
+            settings.queueDepth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--queue-limit") == 0 && i + 1 < argc) {
+            settings.queueLimit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-boxes") == 0 && i + 1 < argc) {
+            settings.maxBoxes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (settings.numberRobots < 1 || settings.numberRows < 1 || settings.numberColumns < 1
+            || settings.addWeight < 0 || settings.executeWeight < 0 || settings.queryWeight < 0
+            || settings.undoPercent < 0 || settings.undoPercent > 100 || settings.queueDepth < 0
+            || settings.queueLimit < settings.queueDepth || settings.maxBoxes < 1) {
+        printf("The settings of the workload are out of range.\n");
+        return 1;
+    }
+
+    std::string text;
+    WorkloadGenerator(settings, text).generate();
+
+    FILE *output = outputPath != NULL ? fopen(outputPath, "w") : stdout;
+    if (output == NULL) {
+        printf("The output file could not be opened.\n");
+        return 1;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), output) == text.size();
+    if (output != stdout) {
+        written = fclose(output) == 0 && written;
+    }
+    return written ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/**
+ * Benchmark of the command log
+ * Runs the same generated workload (see WorkloadGenerator) the way tema1
+ * runs robots.in, without a log and then logging it with several group
+ * sizes, and reports what the log costs against the run without it
+ *
+ * The log is written next to the input, in the directory given as the
+ * only argument (/tmp by default), so it can be put on the disk to measure
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+#include "Scenario.h"
+#include "Workload.h"
+
+// Every configuration is run this many times, each time after a run without the log, and the fastest runs are kept
+const int REPEATS = 5;
+
+/**
+    Times the workload with the log of the settings and without a log,
+    the runs taking turns so both see the same load of the machine
+
+    @return False if a run failed
+*/
+static bool FastestRuns(const char *inputPath, const ScenarioSettings &settings, double &withLog,
+        double &withoutLog, ScenarioResult &result) {
+    ScenarioSettings unlogged = settings;
+    unlogged.logPath = NULL;
+    for (int i = 0; i < REPEATS; i++) {
+        if (RunScenario(inputPath, "/dev/null", unlogged, result) != SCENARIO_DONE) {
+            return false;
+        }
+        if (i == 0 || result.seconds < withoutLog) {
+            withoutLog = result.seconds;
+        }
+
+        // A new log every time, the old one is not truncated while timed
+        unlink(settings.logPath);
+        if (RunScenario(inputPath, "/dev/null", settings, result) != SCENARIO_DONE) {
+            return false;
+        }
+        if (i == 0 || result.seconds < withLog) {
+            withLog = result.seconds;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::string directory = argc > 1 ? argv[1] : "/tmp";
+    std::string inputPath = directory + "/log_benchXXXXXX";
+    std::string logPath = directory + "/log_bench.wal";
+
+    WorkloadSettings workload;
+    workload.numberCommands = 1000000;
+    std::string text;
+    WorkloadGenerator(workload, text).generate();
+
+    int fd = mkstemp(&inputPath[0]);
+    if (fd < 0 || write(fd, text.data(), text.size()) != (ssize_t) text.size()) {
+        printf("{\"benchmark\": \"log\", \"error\": \"no temporary file in %s\"}\n", directory.c_str());
+        if (fd >= 0) {
+            close(fd);
+            unlink(inputPath.c_str());
+        }
+        return 1;
+    }
+    close(fd);
+
+    ScenarioSettings settings;
+    ScenarioResult result;
+    settings.logPath = logPath.c_str();
+    const size_t groups[] = { 64, 256, 1024, 4096, 16384 };
+    for (int g = 0; g < 5; g++) {
+        settings.logGroupSize = groups[g];
+        double withLog = 0;
+        double withoutLog = 0;
+        if (!FastestRuns(inputPath.c_str(), settings, withLog, withoutLog, result)) {
+            printf("{\"benchmark\": \"log\", \"group\": %zu, \"error\": \"the log could not be written\"}\n",
+                    groups[g]);
+            continue;
+        }
+        printf("{\"benchmark\": \"log\", \"group\": %zu, \"window_ms\": %d, \"commands\": %lld, "
+                "\"ns_per_command\": %.2f, \"unlogged_ns_per_command\": %.2f, \"commands_per_sec\": %.0f, "
+                "\"overhead_percent\": %.1f}\n",
+                groups[g], settings.logWindowMilliseconds, result.numberCommands,
+                withLog * 1e9 / result.numberCommands, withoutLog * 1e9 / result.numberCommands,
+                result.numberCommands / withLog, (withLog / withoutLog - 1) * 100);
+    }
+
+    unlink(logPath.c_str());
+    unlink(inputPath.c_str());
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * Benchmark of the map layouts
+ * Loads large maps with boxes in a given fraction of the cells, in
+ * clusters or spread evenly, once dense, once tiled (see TiledMap) and
+ * once with the layout chosen from the map (MAP_AUTO); reports the bytes
+ * of the map, the time to load it, and the time of a random read, a
+ * random write and an Execute, so the overhead of the tiles can be
+ * weighed against the memory they save
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+#include "Warehouse.h"
+
+const int MAP_SIDE = 8192;
+const int NUMBER_ROBOTS = 64;
+const int COMMANDS_PER_ROBOT = 4096;
+const int NUMBER_ACCESSES = 1 << 22;
+// The boxes are put in squares of this side, in the clustered maps
+const int CLUSTER_SIDE = 32;
+
+// Keeps the optimizer from dropping the measured loops
+static volatile long sink;
+
+static uint64_t NextRandom(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static double NanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    The cells holding boxes, about permille / 1000 of the map, with
+    CLUSTER_SIDE x CLUSTER_SIDE squares of them or one at a time
+*/
+static void PlaceBoxes(int permille, bool clustered, std::vector<std::pair<int, int> > &cells) {
+    uint64_t state = 0x452821E638D01377ull + permille * 2 + clustered;
+    long long wanted = (long long) MAP_SIDE * MAP_SIDE * permille / 1000;
+    cells.clear();
+    while ((long long) cells.size() < wanted) {
+        int x = (int) (NextRandom(state) % MAP_SIDE);
+        int y = (int) (NextRandom(state) % MAP_SIDE);
+        if (!clustered) {
+            cells.push_back(std::make_pair(x, y));
+            continue;
+        }
+        x -= x % CLUSTER_SIDE;
+        y -= y % CLUSTER_SIDE;
+        for (int i = 0; i < CLUSTER_SIDE && (long long) cells.size() < wanted; i++) {
+            for (int j = 0; j < CLUSTER_SIDE && (long long) cells.size() < wanted; j++) {
+                cells.push_back(std::make_pair(x + i, y + j));
+            }
+        }
+    }
+}
+
+static void BenchLayout(const char *placement, int permille, MapLayout layout,
+        const std::vector<std::pair<int, int> > &cells) {
+    WarehouseOptions options;
+    options.mapLayout = layout;
+    Warehouse warehouse(NUMBER_ROBOTS, MAP_SIDE, MAP_SIDE, options);
+
+    // The rows as they are read from robots.in, each filled from the cells in it
+    std::vector<std::vector<int> > boxesInRow(MAP_SIDE);
+    for (size_t i = 0; i < cells.size(); i++) {
+        boxesInRow[cells[i].first].push_back(cells[i].second);
+    }
+    std::vector<int> row(MAP_SIDE);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int x = 0; x < MAP_SIDE; x++) {
+        std::fill(row.begin(), row.end(), 0);
+        for (size_t i = 0; i < boxesInRow[x].size(); i++) {
+            row[boxesInRow[x][i]] = 20;
+        }
+        warehouse.LoadMapRow(x, row.data());
+    }
+    warehouse.FinishLoading();
+    double loadNanoseconds = NanosecondsSince(start);
+    // What the same warehouse holds without a map
+    Warehouse noMap(NUMBER_ROBOTS, 0, 0);
+    size_t mapBytes = warehouse.MemoryUsage() - noMap.MemoryUsage();
+
+    // Half the accesses go to the cells with boxes, half anywhere on the map
+    uint64_t state = 0xA4093822299F31D0ull;
+    std::vector<std::pair<int, int> > targets(NUMBER_ACCESSES);
+    for (int i = 0; i < NUMBER_ACCESSES; i++) {
+        if ((i & 1) && !cells.empty()) {
+            targets[i] = cells[NextRandom(state) % cells.size()];
+        } else {
+            targets[i] = std::make_pair((int) (NextRandom(state) % MAP_SIDE), (int) (NextRandom(state) % MAP_SIDE));
+        }
+    }
+
+    long total = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUMBER_ACCESSES; i++) {
+        total += warehouse.GetMapValue(targets[i].first, targets[i].second);
+    }
+    double readNanoseconds = NanosecondsSince(start);
+
+    // Writes the value read back, so the map and its tiles stay the same
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUMBER_ACCESSES; i++) {
+        int x = targets[i].first;
+        int y = targets[i].second;
+        warehouse.SetMapValue(x, y, warehouse.GetMapValue(x, y));
+    }
+    double writeNanoseconds = NanosecondsSince(start);
+
+    // Every robot picks up from and drops to the cells with boxes
+    for (int robotID = 0; robotID < NUMBER_ROBOTS; robotID++) {
+        for (int i = 0; i < COMMANDS_PER_ROBOT; i++) {
+            const std::pair<int, int> &target = targets[(robotID * COMMANDS_PER_ROBOT + i) | 1];
+            if (i & 1) {
+                warehouse.AddDropBox(robotID, target.first, target.second, 1 + i % 7, 1);
+            } else {
+                warehouse.AddGetBox(robotID, target.first, target.second, 1 + i % 7, 1);
+            }
+        }
+    }
+    long executed = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < COMMANDS_PER_ROBOT; i++) {
+        for (int robotID = 0; robotID < NUMBER_ROBOTS; robotID++) {
+            executed += warehouse.Execute(robotID) == STATUS_EXECUTED;
+        }
+    }
+    double executeNanoseconds = NanosecondsSince(start);
+    sink = total + executed;
+
+    const char *names[] = { "auto", "dense", "tiled" };
+    printf("{\"benchmark\": \"map\", \"side\": %d, \"placement\": \"%s\", \"boxes_permille\": %d, "
+            "\"layout\": \"%s\", \"tiled\": %s, \"map_bytes\": %zu, \"percent_of_dense\": %.2f, \"load_ms\": %.1f, "
+            "\"read_ns\": %.2f, \"write_ns\": %.2f, \"execute_ns\": %.2f}\n",
+            MAP_SIDE, placement, permille, names[layout], warehouse.IsMapTiled() ? "true" : "false", mapBytes,
+            mapBytes * 100.0 / ((double) MAP_SIDE * MAP_SIDE * sizeof(int)), loadNanoseconds / 1e6,
+            readNanoseconds / NUMBER_ACCESSES, writeNanoseconds / NUMBER_ACCESSES,
+            executeNanoseconds / ((double) NUMBER_ROBOTS * COMMANDS_PER_ROBOT));
+    fflush(stdout);
+}
+
+int main() {
+    std::vector<std::pair<int, int> > cells;
+    const int densities[] = { 1, 10, 100, 500 };
+    for (int clustered = 1; clustered >= 0; clustered--) {
+        for (int d = 0; d < 4; d++) {
+            // Spread evenly, a few boxes already put one in every tile
+            if (!clustered && densities[d] > 10) {
+                continue;
+            }
+            PlaceBoxes(densities[d], clustered, cells);
+            const MapLayout layouts[] = { MAP_DENSE, MAP_TILED, MAP_AUTO };
+            for (int l = 0; l < 3; l++) {
+                BenchLayout(clustered ? "clustered" : "spread", densities[d], layouts[l], cells);
+            }
+        }
+    }
+    return 0;
+}
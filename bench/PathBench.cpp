@@ -0,0 +1,96 @@
+/**
+ * Benchmark of PathPlanner on a 100k-cell grid with random obstacles
+ * The destinations are drawn from a set of hot cells, so the cache of
+ * distance fields is compared with plain A* searches as the set grows
+ * past the size of the cache
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+#include "PathPlanner.h"
+
+const int GRID_SIZE = 317;              // 100489 cells
+const int OBSTACLE_PERCENT = 15;
+const int NUMBER_PLANS = 10000;
+
+static uint64_t NextRandom(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void AddObstacles(PathPlanner &planner) {
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            if ((int) (NextRandom(state) % 100) < OBSTACLE_PERCENT) {
+                planner.addObstacle(x, y);
+            }
+        }
+    }
+}
+
+// A random cell that is not an obstacle
+static void FreeCell(const PathPlanner &planner, uint64_t &state, int &x, int &y) {
+    do {
+        x = (int) (NextRandom(state) % GRID_SIZE);
+        y = (int) (NextRandom(state) % GRID_SIZE);
+    } while (planner.isObstacle(x, y));
+}
+
+static void BenchPlans(int hotTargets, int cacheFields) {
+    PathPlanner planner(GRID_SIZE, GRID_SIZE, cacheFields);
+    AddObstacles(planner);
+
+    uint64_t state = 0xD1B54A32D192ED03ull + hotTargets;
+    std::vector<int> targetsX(hotTargets);
+    std::vector<int> targetsY(hotTargets);
+    for (int i = 0; i < hotTargets; i++) {
+        FreeCell(planner, state, targetsX[i], targetsY[i]);
+    }
+
+    std::vector<int> sourcesX(NUMBER_PLANS);
+    std::vector<int> sourcesY(NUMBER_PLANS);
+    std::vector<int> targets(NUMBER_PLANS);
+    for (int i = 0; i < NUMBER_PLANS; i++) {
+        FreeCell(planner, state, sourcesX[i], sourcesY[i]);
+        targets[i] = (int) (NextRandom(state) % hotTargets);
+    }
+
+    long long unreachable = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUMBER_PLANS; i++) {
+        int target = targets[i];
+        if (planner.distance(sourcesX[i], sourcesY[i], targetsX[target], targetsY[target]) < 0) {
+            unreachable++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("{\"benchmark\": \"path_plan\", \"cells\": %d, \"obstacle_percent\": %d, "
+            "\"hot_targets\": %d, \"cache_fields\": %d, \"hits\": %lld, \"searches\": %lld, "
+            "\"fields_built\": %lld, \"unreachable\": %lld, \"ns_per_op\": %.0f, \"plans_per_sec\": %.0f, "
+            "\"memory_bytes\": %zu}\n",
+            GRID_SIZE * GRID_SIZE, OBSTACLE_PERCENT, hotTargets, cacheFields,
+            planner.getNumberHits(), planner.getNumberSearches(), planner.getNumberFields(),
+            unreachable, seconds * 1e9 / NUMBER_PLANS, NUMBER_PLANS / seconds, planner.memoryUsage());
+}
+
+int main() {
+    const int hotTargetCounts[] = { 16, 64, 256, 4096 };
+    const int cacheSizes[] = { 1, 64, 256 };
+
+    for (int t = 0; t < 4; t++) {
+        for (int c = 0; c < 3; c++) {
+            BenchPlans(hotTargetCounts[t], cacheSizes[c]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * Benchmark of the command queue containers
+ * Compares DoublyLinkedList (with and without the node pool) and
+ * RingDeque at various queue depths
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <tuple>
+
+#include "DoublyLinkedList.h"
+#include "NodePool.h"
+#include "RingDeque.h"
+
+typedef std::tuple<int, int, int, int> Entry;
+
+typedef DoublyLinkedList<Entry> PlainList;
+typedef DoublyLinkedList<Entry, PoolAllocator<Node<Entry>>> PooledList;
+typedef RingDeque<Entry> Ring;
+
+// Keeps the optimizer from dropping the measured loops
+static volatile long sink;
+
+static double NanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char *benchmark, const char *container, int depth, double nsPerOp) {
+    printf("{\"benchmark\": \"%s\", \"container\": \"%s\", \"depth\": %d, \"ns_per_op\": %.2f}\n",
+            benchmark, container, depth, nsPerOp);
+}
+
+/**
+ * Keeps the queue at the given depth while pushing and popping at
+ * both ends, the way commands are queued, executed and undone.
+ */
+template <typename Queue>
+static void BenchChurn(const char *container, int depth, long operations) {
+    Queue queue;
+    for (int i = 0; i < depth; i++) {
+        queue.addLast(Entry(i, i, i, i));
+    }
+
+    long checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long i = 0; i < operations; i++) {
+        if (i & 1) {
+            queue.addFirst(Entry((int) i, 0, 0, 0));
+            checksum += std::get<0>(queue.removeLast());
+        } else {
+            queue.addLast(Entry((int) i, 0, 0, 0));
+            checksum += std::get<0>(queue.removeFirst());
+        }
+    }
+    double elapsed = NanosecondsSince(start);
+    sink = checksum;
+
+    Report("churn", container, depth, elapsed / (2 * operations));
+}
+
+/**
+ * Reads every element by position, the access pattern of PRINT_COMMANDS.
+ */
+template <typename Queue>
+static void BenchIndexedScan(const char *container, int depth, long maxVisits) {
+    Queue queue;
+    for (int i = 0; i < depth; i++) {
+        queue.addLast(Entry(i, i, i, i));
+    }
+
+    long checksum = 0;
+    long visits = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    do {
+        for (int i = 0; i < queue.size(); i++) {
+            checksum += std::get<1>(queue.get(i));
+        }
+        visits += depth;
+    } while (visits < maxVisits);
+    double elapsed = NanosecondsSince(start);
+    sink = checksum;
+
+    Report("indexed_scan", container, depth, elapsed / visits);
+}
+
+int main() {
+    const int depths[] = { 16, 256, 4096, 65536 };
+    const long churnOperations = 2000000;
+
+    for (int d = 0; d < (int) (sizeof(depths) / sizeof(depths[0])); d++) {
+        int depth = depths[d];
+
+        BenchChurn<PlainList>("DoublyLinkedList", depth, churnOperations);
+        BenchChurn<PooledList>("DoublyLinkedList+NodePool", depth, churnOperations);
+        BenchChurn<Ring>("RingDeque", depth, churnOperations);
+
+        // The linked list scan is quadratic, a single pass is enough
+        if (depth <= 4096) {
+            BenchIndexedScan<PlainList>("DoublyLinkedList", depth, depth);
+        }
+        BenchIndexedScan<Ring>("RingDeque", depth, 4000000);
+    }
+
+    return 0;
+}
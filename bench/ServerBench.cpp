@@ -0,0 +1,307 @@
+/**
+ * Load generator of the server mode
+ * Starts a server (see Server.h) on a generated workload (see
+ * WorkloadGenerator), then clients send its commands in pipelined
+ * requests; reports the requests per second and the latency of the
+ * requests for several numbers of clients, batch sizes, pipeline depths
+ * and both request formats. Every configuration gets a new server
+ *
+ * With a socket as the only argument, the server already listening there
+ * is loaded instead; its warehouse must be as large as the workload's
+ * (16 robots, 64 x 64), or the requests are rejected and counted as errors
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Server.h"
+#include "Stream.h"
+#include "Workload.h"
+
+struct LoadSettings {
+    ServerFormat format;
+    int numberClients;
+    int batchSize;              // commands in a request
+    int depth;                  // requests a client sends before it waits for a response
+};
+
+// What one client saw
+struct ClientResult {
+    std::vector<uint64_t> latencies;    // of every request, from its first byte sent to its response read
+    long long errors;                   // responses that are not SERVER_OK, or requests left unanswered
+
+    ClientResult() : errors(0) {}
+};
+
+static int Connect(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Keeps up to depth requests on the way, sending the next one as every response comes in
+static void Client(const char *socketPath, const std::vector<std::string> &requests, int depth,
+        ClientResult &result) {
+    int fd = Connect(socketPath);
+    if (fd < 0) {
+        result.errors = requests.size();
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    std::vector<std::chrono::steady_clock::time_point> sentAt(requests.size());
+    std::vector<char> input(1 << 16);
+    size_t inputEnd = 0;
+    size_t numberSent = 0;
+    size_t offset = 0;          // bytes of the request numberSent already sent
+    size_t numberReceived = 0;
+
+    while (numberReceived < requests.size()) {
+        bool sending = numberSent < requests.size() && numberSent - numberReceived < (size_t) depth;
+        struct pollfd request = { fd, (short) (POLLIN | (sending ? POLLOUT : 0)), 0 };
+        if (poll(&request, 1, 10000) <= 0 || (request.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+            break;
+        }
+
+        if (sending && (request.revents & POLLOUT)) {
+            const std::string &text = requests[numberSent];
+            if (offset == 0) {
+                sentAt[numberSent] = std::chrono::steady_clock::now();
+            }
+            ssize_t count = send(fd, text.data() + offset, text.size() - offset, MSG_NOSIGNAL);
+            if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                break;
+            }
+            offset += count > 0 ? count : 0;
+            if (offset == text.size()) {
+                numberSent++;
+                offset = 0;
+            }
+        }
+
+        if (request.revents & POLLIN) {
+            ssize_t count = read(fd, input.data() + inputEnd, input.size() - inputEnd);
+            if (count <= 0 && !(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))) {
+                break;
+            }
+            inputEnd += count > 0 ? count : 0;
+
+            // Every whole response, the buffer growing for one that does not fit
+            size_t start = 0;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            while (inputEnd - start >= sizeof(ServerResponseHeader)) {
+                ServerResponseHeader header;
+                memcpy(&header, input.data() + start, sizeof(header));
+                if (inputEnd - start < sizeof(header) + header.size) {
+                    if (sizeof(header) + header.size > input.size()) {
+                        input.resize(sizeof(header) + header.size);
+                    }
+                    break;
+                }
+                result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        now - sentAt[numberReceived]).count());
+                if (header.status != SERVER_OK || header.requestID != numberReceived) {
+                    result.errors++;
+                }
+                numberReceived++;
+                start += sizeof(header) + header.size;
+            }
+            memmove(input.data(), input.data() + start, inputEnd - start);
+            inputEnd -= start;
+        }
+    }
+
+    result.errors += requests.size() - numberReceived;
+    close(fd);
+}
+
+/**
+    Frames the commands of the workload into the requests of every
+    client, a batch at a time, the batches dealt to the clients in turn
+*/
+static void BuildRequests(const std::vector<std::string> &lines, const LoadSettings &load,
+        std::vector<std::vector<std::string> > &requests) {
+    requests.assign(load.numberClients, std::vector<std::string>());
+    CommandScanner scanner(NULL, 0);
+    Command command;
+    memset(&command, 0, sizeof(command));
+
+    for (size_t first = 0, batch = 0; first < lines.size(); first += load.batchSize, batch++) {
+        std::string payload;
+        for (size_t i = first; i < first + load.batchSize && i < lines.size(); i++) {
+            if (load.format == SERVER_TEXT) {
+                payload += lines[i];
+            } else {
+                scanner.reset(lines[i].data(), lines[i].size());
+                if (scanner.nextCommand(command)) {
+                    payload.append((const char *) &command, sizeof(command));
+                }
+            }
+        }
+
+        std::vector<std::string> &client = requests[batch % load.numberClients];
+        ServerRequestHeader header = { (uint32_t) load.format, (uint32_t) payload.size(), client.size() };
+        client.push_back(std::string((const char *) &header, sizeof(header)) + payload);
+    }
+}
+
+static void BenchServer(const char *socketPath, const std::vector<std::string> &lines, const LoadSettings &load) {
+    std::vector<std::vector<std::string> > requests;
+    BuildRequests(lines, load, requests);
+
+    std::vector<ClientResult> results(load.numberClients);
+    std::vector<std::thread> clients;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < load.numberClients; i++) {
+        clients.push_back(std::thread(Client, socketPath, std::cref(requests[i]), load.depth,
+                std::ref(results[i])));
+    }
+    for (int i = 0; i < load.numberClients; i++) {
+        clients[i].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LatencyHistogram latencies;
+    long long numberRequests = 0;
+    long long errors = 0;
+    for (int i = 0; i < load.numberClients; i++) {
+        for (size_t j = 0; j < results[i].latencies.size(); j++) {
+            latencies.add(results[i].latencies[j]);
+        }
+        numberRequests += requests[i].size();
+        errors += results[i].errors;
+    }
+
+    printf("{\"benchmark\": \"server\", \"format\": \"%s\", \"clients\": %d, \"batch\": %d, \"depth\": %d, "
+            "\"requests\": %lld, \"errors\": %lld, \"requests_per_sec\": %.0f, \"commands_per_sec\": %.0f, "
+            "\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}\n",
+            load.format == SERVER_TEXT ? "text" : "binary", load.numberClients, load.batchSize, load.depth,
+            numberRequests, errors, numberRequests / seconds, lines.size() / seconds,
+            latencies.percentile(0.5) / 1e3, latencies.percentile(0.99) / 1e3, latencies.getMaximum() / 1e3);
+    fflush(stdout);
+}
+
+/**
+    Runs a server on the map of the input in a child process
+
+    @return The process of the server, once it accepts connections, or -1
+*/
+static pid_t StartServer(const char *inputPath, const char *socketPath) {
+    unlink(socketPath);
+    pid_t pid = fork();
+    if (pid == 0) {
+        ScenarioSettings settings;
+        ServerSettings server;
+        ScenarioResult result;
+        ServerStats stats;
+        _exit(RunServer(inputPath, socketPath, settings, server, result, stats) == SCENARIO_DONE ? 0 : 1);
+    }
+
+    for (int i = 0; pid > 0 && i < 10000; i++) {
+        int fd = Connect(socketPath);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+    return -1;
+}
+
+static void KillServer(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char *argv[]) {
+    const char *externalSocket = argc > 1 ? argv[1] : NULL;
+    char inputPath[] = "/tmp/server_benchXXXXXX";
+    std::string socketPath = std::string(inputPath) + ".sock";
+
+    WorkloadSettings workload;
+    workload.numberCommands = 100000;
+    std::string text;
+    WorkloadGenerator(workload, text).generate();
+
+    // The commands, one line each, after N ROW COL and the map
+    CommandScanner scanner(text.data(), text.size());
+    int value;
+    for (long long i = 3 + (long long) workload.numberRows * workload.numberColumns; i > 0; i--) {
+        scanner.nextInt(value);
+    }
+    std::vector<std::string> lines;
+    for (const char *line = scanner.getPosition(), *end = text.data() + text.size(); line < end; ) {
+        const char *newline = (const char *) memchr(line, '\n', end - line);
+        const char *next = newline != NULL ? newline + 1 : end;
+        if (next - line > 1) {
+            lines.push_back(std::string(line, next));
+        }
+        line = next;
+    }
+
+    if (externalSocket == NULL) {
+        int fd = mkstemp(inputPath);
+        if (fd < 0 || write(fd, text.data(), text.size()) != (ssize_t) text.size()) {
+            printf("{\"benchmark\": \"server\", \"error\": \"no temporary file\"}\n");
+            return 1;
+        }
+        close(fd);
+        socketPath = std::string(inputPath) + ".sock";
+    }
+
+    const ServerFormat formats[] = { SERVER_TEXT, SERVER_BINARY };
+    const int clients[] = { 1, 4 };
+    const int batches[] = { 1, 64, 1024 };
+    const int depths[] = { 1, 16 };
+    for (int f = 0; f < 2; f++) {
+        for (int c = 0; c < 2; c++) {
+            for (int b = 0; b < 3; b++) {
+                for (int d = 0; d < 2; d++) {
+                    LoadSettings load = { formats[f], clients[c], batches[b], depths[d] };
+                    if (externalSocket != NULL) {
+                        BenchServer(externalSocket, lines, load);
+                        continue;
+                    }
+
+                    pid_t pid = StartServer(inputPath, socketPath.c_str());
+                    if (pid < 0) {
+                        printf("{\"benchmark\": \"server\", \"error\": \"the server did not start\"}\n");
+                        unlink(inputPath);
+                        return 1;
+                    }
+                    BenchServer(socketPath.c_str(), lines, load);
+                    KillServer(pid);
+                }
+            }
+        }
+    }
+
+    if (externalSocket == NULL) {
+        unlink(inputPath);
+    }
+    return 0;
+}
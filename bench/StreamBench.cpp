@@ -0,0 +1,110 @@
+/**
+ * Benchmark of the streaming mode
+ * A thread feeds a generated workload (see WorkloadGenerator) through a
+ * pipe at a steady number of commands per second, while RunStream runs
+ * it; reports the command to output latency for several rates and flush
+ * thresholds
+ *
+ * Every result is printed as one JSON object per line
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Stream.h"
+#include "Workload.h"
+
+// Writes the lines of text to fd, linesPerSecond of them every second (0 for as fast as it can)
+static void Feed(int fd, const std::string &text, const std::vector<size_t> &lineEnds, double linesPerSecond) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t written = 0;
+    size_t line = 0;
+    while (line < lineEnds.size()) {
+        size_t due = lineEnds.size();
+        if (linesPerSecond > 0) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            due = (size_t) (elapsed * linesPerSecond) + 1;
+            due = due < lineEnds.size() ? due : lineEnds.size();
+        }
+        if (due <= line) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+
+        line = due;
+        while (written < lineEnds[line - 1]) {
+            ssize_t count = write(fd, text.data() + written, lineEnds[line - 1] - written);
+            if (count <= 0) {
+                close(fd);
+                return;
+            }
+            written += count;
+        }
+    }
+    close(fd);
+}
+
+static void BenchStream(const std::string &text, const std::vector<size_t> &lineEnds, double linesPerSecond,
+        const StreamSettings &stream) {
+    int pipeFds[2];
+    FILE *output = fopen("/dev/null", "w");
+    if (output == NULL || pipe(pipeFds) != 0) {
+        printf("{\"benchmark\": \"stream\", \"error\": \"no pipe\"}\n");
+        if (output != NULL) {
+            fclose(output);
+        }
+        return;
+    }
+
+    std::thread feeder(Feed, pipeFds[1], std::cref(text), std::cref(lineEnds), linesPerSecond);
+    ScenarioSettings settings;
+    ScenarioResult result;
+    LatencyHistogram latencies;
+    ScenarioStatus status = RunStream(pipeFds[0], output, settings, stream, result, latencies);
+    feeder.join();
+    close(pipeFds[0]);
+    fclose(output);
+
+    if (status != SCENARIO_DONE) {
+        printf("{\"benchmark\": \"stream\", \"error\": \"%s\"}\n", ScenarioStatusMessage(status));
+        return;
+    }
+    printf("{\"benchmark\": \"stream\", \"lines_per_sec\": %.0f, \"flush_commands\": %ld, \"flush_ms\": %d, "
+            "\"commands\": %lld, \"commands_per_sec\": %.0f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+            "\"max_us\": %.1f}\n",
+            linesPerSecond, stream.flushCommands, stream.flushMilliseconds, result.numberCommands,
+            result.numberCommands / result.seconds, latencies.percentile(0.5) / 1e3,
+            latencies.percentile(0.99) / 1e3, latencies.getMaximum() / 1e3);
+}
+
+int main() {
+    WorkloadSettings workload;
+    workload.numberCommands = 200000;
+    std::string text;
+    WorkloadGenerator(workload, text).generate();
+
+    std::vector<size_t> lineEnds;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\n') {
+            lineEnds.push_back(i + 1);
+        }
+    }
+    if (lineEnds.empty() || lineEnds.back() != text.size()) {
+        lineEnds.push_back(text.size());
+    }
+
+    const double rates[] = { 100000, 500000, 1000000, 0 };
+    const long flushes[] = { 1, 64, 1024 };
+    for (int r = 0; r < 4; r++) {
+        for (int f = 0; f < 3; f++) {
+            StreamSettings stream;
+            stream.flushCommands = flushes[f];
+            BenchStream(text, lineEnds, rates[r], stream);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * Deterministic generator of robots.in workloads
+ * The same settings always give the same file, so a run can be repeated
+ * and compared with an older one. Every robot first gets queueDepth
+ * commands, then the stream mixes ADD, EXECUTE, the queries and UNDO
+ *
+ * EXECUTE leaves the command at the head of the queue and UNDO puts one
+ * back, so the queues only grow; the generator follows their lengths and
+ * gives EXECUTE instead of an ADD or UNDO that would pass queueLimit
+ */
+
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct WorkloadSettings {
+    uint64_t seed;
+    int numberRobots;
+    int numberRows;
+    int numberColumns;
+    long numberCommands;        // of the mixed stream, after the queues are filled
+    /**
+        Relative weights of ADD_GET_BOX / ADD_DROP_BOX, of EXECUTE and of
+        the queries (PRINT_COMMANDS, HOW_MANY_BOXES, HOW_MUCH_TIME,
+        LAST_EXECUTED_COMMAND) in the commands that are not UNDO
+    */
+    int addWeight;
+    int executeWeight;
+    int queryWeight;
+    int undoPercent;            // of all the commands of the stream
+    int queueDepth;             // commands queued for every robot before the stream
+    int queueLimit;             // most commands a queue gets in the stream
+    int maxBoxes;               // in a cell of the map and in a command
+
+    WorkloadSettings()
+            : seed(1), numberRobots(16), numberRows(64), numberColumns(64), numberCommands(100000),
+              addWeight(40), executeWeight(45), queryWeight(15), undoPercent(5), queueDepth(8),
+              queueLimit(64), maxBoxes(20) {}
+};
+
+class WorkloadGenerator {
+private:
+    const WorkloadSettings &settings;
+    uint64_t state;
+    std::string &text;
+    std::vector<int> queueLengths;
+    std::vector<int> executedRobots;     // the history that UNDO pops
+
+    uint64_t nextRandom() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Uniform in 0..bound-1
+    int below(int bound) {
+        return bound > 0 ? (int) (nextRandom() % (uint64_t) bound) : 0;
+    }
+
+    void append(const char *format, int a, int b = 0, int c = 0, int d = 0, int e = 0) {
+        char line[128];
+        int length = snprintf(line, sizeof(line), format, a, b, c, d, e);
+        text.append(line, length);
+    }
+
+    void addCommand(int robotID) {
+        queueLengths[robotID]++;
+        append(below(2) == 0 ? "ADD_GET_BOX %d %d %d %d %d\n" : "ADD_DROP_BOX %d %d %d %d %d\n",
+                robotID, below(settings.numberRows), below(settings.numberColumns),
+                1 + below(settings.maxBoxes), below(2));
+    }
+
+    void executeCommand(int robotID) {
+        if (queueLengths[robotID] > 0) {
+            executedRobots.push_back(robotID);
+        }
+        append("EXECUTE %d\n", robotID);
+    }
+
+    void queryCommand(int robotID) {
+        switch (below(4)) {
+        case 0:
+            append("PRINT_COMMANDS %d\n", robotID);
+            break;
+        case 1:
+            append("HOW_MANY_BOXES %d\n", robotID);
+            break;
+        case 2:
+            append("HOW_MUCH_TIME %d\n", robotID);
+            break;
+        default:
+            text.append("LAST_EXECUTED_COMMAND\n");
+        }
+    }
+
+public:
+    WorkloadGenerator(const WorkloadSettings &settings, std::string &text)
+            : settings(settings), state(settings.seed * 0x9E3779B97F4A7C15ull | 1), text(text),
+              queueLengths(settings.numberRobots, 0) {}
+
+    // Appends the whole robots.in to the text
+    void generate() {
+        append("%d %d %d\n", settings.numberRobots, settings.numberRows, settings.numberColumns);
+        for (int x = 0; x < settings.numberRows; x++) {
+            for (int y = 0; y < settings.numberColumns; y++) {
+                append(y + 1 < settings.numberColumns ? "%d " : "%d\n", below(settings.maxBoxes + 1));
+            }
+        }
+
+        for (int i = 0; i < settings.queueDepth; i++) {
+            for (int robotID = 0; robotID < settings.numberRobots; robotID++) {
+                addCommand(robotID);
+            }
+        }
+
+        int mixWeight = settings.addWeight + settings.executeWeight + settings.queryWeight;
+        for (long i = 0; i < settings.numberCommands; i++) {
+            int robotID = below(settings.numberRobots);
+            if (below(100) < settings.undoPercent || mixWeight <= 0) {
+                if (executedRobots.empty()) {
+                    text.append("UNDO\n");
+                    continue;
+                }
+                int undoneRobot = executedRobots.back();
+                if (queueLengths[undoneRobot] < settings.queueLimit) {
+                    executedRobots.pop_back();
+                    queueLengths[undoneRobot]++;
+                    text.append("UNDO\n");
+                } else {
+                    executeCommand(robotID);
+                }
+                continue;
+            }
+
+            int kind = below(mixWeight);
+            if (kind < settings.addWeight && queueLengths[robotID] < settings.queueLimit) {
+                addCommand(robotID);
+            } else if (kind < settings.addWeight + settings.executeWeight) {
+                executeCommand(robotID);
+            } else {
+                queryCommand(robotID);
+            }
+        }
+    }
+};
+
+#endif // __WORKLOAD_H__
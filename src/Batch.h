@@ -0,0 +1,268 @@
+/**
+ * Batch mode: many independent scenarios, each on its own Warehouse,
+ * run on a WorkStealingPool
+ *
+ * The jobs come from a manifest (one input path per line, optionally
+ * followed by the output path; empty lines and lines starting with #
+ * are skipped) or from all the *.in files of a directory
+ */
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <dirent.h>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "Scenario.h"
+#include "WorkStealingPool.h"
+
+struct BatchJob {
+    std::string inputPath;
+    std::string outputPath;
+    size_t inputBytes;
+    ScenarioStatus status;
+    ScenarioResult result;
+
+    BatchJob() : inputBytes(0), status(SCENARIO_DONE) {}
+};
+
+struct BatchSettings {
+    ScenarioSettings scenario;
+    int numberWorkers;
+    /**
+        Memory that all the running jobs may hold together, 0 for no
+        limit; see BatchReservation()
+    */
+    size_t memoryBudget;
+    std::string outputDirectory;    // empty to write next to the inputs
+
+    BatchSettings() : numberWorkers(1), memoryBudget(0) {}
+};
+
+/**
+ * Shared amount of memory, jobs wait until their part is available
+ * A job larger than the whole budget runs when no other job is running
+ */
+class MemoryBudget {
+private:
+    size_t budget;
+    size_t reserved;
+    std::mutex lock;
+    std::condition_variable released;
+
+public:
+    explicit MemoryBudget(size_t budget) : budget(budget), reserved(0) {}
+
+    void acquire(size_t bytes) {
+        std::unique_lock<std::mutex> guard(lock);
+        released.wait(guard, [&] {
+            return budget == 0 || reserved == 0 || reserved + bytes <= budget;
+        });
+        reserved += bytes;
+    }
+
+    void release(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            reserved -= bytes;
+        }
+        released.notify_all();
+    }
+};
+
+/**
+    Memory a job is expected to need: its memory limit if it has one,
+    otherwise three times its input, which covers the map, the queues and
+    the history of a typical robots.in
+*/
+inline size_t BatchReservation(const BatchJob &job, const BatchSettings &settings) {
+    if (settings.scenario.memoryLimit > 0) {
+        return settings.scenario.memoryLimit;
+    }
+    return job.inputBytes * 3;
+}
+
+// robots.in -> robots.out, anything else gets .out appended
+inline std::string BatchOutputPath(const std::string &inputPath, const std::string &outputDirectory) {
+    std::string path = inputPath;
+    if (!outputDirectory.empty()) {
+        size_t slash = path.find_last_of('/');
+        path = outputDirectory + "/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+    }
+
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".in") == 0) {
+        path.replace(path.size() - 3, 3, ".out");
+    } else {
+        path += ".out";
+    }
+    return path;
+}
+
+inline bool EndsWith(const std::string &text, const char *suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+/**
+ * Reads the jobs from a manifest or a directory.
+ *
+ * @return False if the path can not be read.
+ */
+inline bool LoadBatchJobs(const char *path, const std::string &outputDirectory,
+        std::vector<BatchJob> &jobs) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return false;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        DIR *directory = opendir(path);
+        if (directory == NULL) {
+            return false;
+        }
+
+        std::vector<std::string> names;
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != NULL) {
+            if (EndsWith(entry->d_name, ".in")) {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(directory);
+
+        std::sort(names.begin(), names.end());
+        for (size_t i = 0; i < names.size(); i++) {
+            BatchJob job;
+            job.inputPath = std::string(path) + "/" + names[i];
+            job.outputPath = BatchOutputPath(job.inputPath, outputDirectory);
+            jobs.push_back(job);
+        }
+    } else {
+        MappedFile manifest;
+        if (!manifest.open(path)) {
+            return false;
+        }
+
+        // The manifest uses the same tokens as robots.in, one job per line
+        const char *position = manifest.data();
+        const char *end = position + manifest.size();
+        while (position < end) {
+            const char *lineEnd = (const char *) memchr(position, '\n', end - position);
+            if (lineEnd == NULL) {
+                lineEnd = end;
+            }
+
+            CommandScanner line(position, lineEnd - position);
+            const char *token;
+            int length;
+            if (line.nextToken(token, length) && token[0] != '#') {
+                BatchJob job;
+                job.inputPath.assign(token, length);
+                if (line.nextToken(token, length)) {
+                    job.outputPath.assign(token, length);
+                } else {
+                    job.outputPath = BatchOutputPath(job.inputPath, outputDirectory);
+                }
+                jobs.push_back(job);
+            }
+
+            position = lineEnd + 1;
+        }
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (stat(jobs[i].inputPath.c_str(), &info) == 0) {
+            jobs[i].inputBytes = info.st_size;
+        }
+    }
+    return true;
+}
+
+// Writes a string as a JSON string literal
+inline void WriteJsonString(FILE *file, const std::string &text) {
+    fputc('"', file);
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\') {
+            fputc('\\', file);
+        }
+        fputc(text[i], file);
+    }
+    fputc('"', file);
+}
+
+/**
+ * Runs all the jobs and prints one JSON object per job, in the order of
+ * the jobs, followed by one for the whole batch.
+ *
+ * @return The number of jobs that failed.
+ */
+inline int RunBatch(std::vector<BatchJob> &jobs, const BatchSettings &settings, FILE *summary) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Larger inputs first, so no long job is left for the end
+    std::vector<int> order(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        order[i] = (int) i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&jobs](int a, int b) {
+        return jobs[a].inputBytes > jobs[b].inputBytes;
+    });
+
+    MemoryBudget budget(settings.memoryBudget);
+    WorkStealingPool pool(settings.numberWorkers);
+
+    pool.run((int) jobs.size(), [&](int task, int) {
+        BatchJob &job = jobs[order[task]];
+        size_t reservation = BatchReservation(job, settings);
+
+        budget.acquire(reservation);
+        try {
+            job.status = RunScenario(job.inputPath.c_str(), job.outputPath.c_str(),
+                    settings.scenario, job.result);
+        } catch (const std::exception &) {
+            // Only this job is lost, for example when its map can not be allocated
+            job.status = SCENARIO_FAILED;
+        }
+        budget.release(reservation);
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    long long numberCommands = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const BatchJob &job = jobs[i];
+        if (job.status != SCENARIO_DONE) {
+            failed++;
+        }
+        numberCommands += job.result.numberCommands;
+
+        fprintf(summary, "{\"job\": %zu, \"input\": ", i);
+        WriteJsonString(summary, job.inputPath);
+        fprintf(summary, ", \"output\": ");
+        WriteJsonString(summary, job.outputPath);
+        fprintf(summary, ", \"status\": ");
+        WriteJsonString(summary, ScenarioStatusMessage(job.status));
+        fprintf(summary, ", \"commands\": %lld, \"seconds\": %.6f, \"peak_memory_bytes\": %zu, "
+                "\"region_index_bytes\": %zu}\n",
+                job.result.numberCommands, job.result.seconds, job.result.peakMemory,
+                job.result.regionIndexMemory);
+    }
+
+    fprintf(summary, "{\"jobs\": %zu, \"failed\": %d, \"workers\": %d, \"seconds\": %.3f, "
+            "\"jobs_per_sec\": %.2f, \"commands_per_sec\": %.0f}\n",
+            jobs.size(), failed, pool.size(), seconds,
+            seconds > 0 ? jobs.size() / seconds : 0.0,
+            seconds > 0 ? numberCommands / seconds : 0.0);
+    return failed;
+}
+
+#endif // __BATCH_H__
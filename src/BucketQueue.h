@@ -0,0 +1,181 @@
+/**
+ * Priority queue with a fixed number of levels, 0 being the most urgent
+ * Every level is a RingDeque, and a bitmap tells which levels are not
+ * empty, so adding an element and finding the most urgent one are O(1)
+ * Elements of the same level keep the order they were added in
+ */
+
+#ifndef __BUCKETQUEUE_H__
+#define __BUCKETQUEUE_H__
+
+#include <assert.h>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+
+#include "RingDeque.h"
+
+template <typename T>
+class BucketQueue {
+public:
+    static const int maxLevels = 256;
+
+private:
+    static const int bitmapWords = maxLevels / 64;
+
+    int numberLevels;
+    int numElements;
+    uint64_t nonEmpty[bitmapWords];                 // bit l is set if level l has elements
+    std::unique_ptr<RingDeque<T>[]> buckets;        // allocated with the first element
+
+    BucketQueue(const BucketQueue &);
+    BucketQueue &operator=(const BucketQueue &);
+
+    RingDeque<T> &bucketFor(int level) {
+        assert(level >= 0 && level < numberLevels);
+        if (!buckets) {
+            buckets.reset(new RingDeque<T>[numberLevels]);
+        }
+        nonEmpty[level >> 6] |= uint64_t(1) << (level & 63);
+        return buckets[level];
+    }
+
+    void markIfEmpty(int level) {
+        if (buckets[level].isEmpty()) {
+            nonEmpty[level >> 6] &= ~(uint64_t(1) << (level & 63));
+        }
+    }
+
+    // The first non-empty level from the given one on, -1 if there is none
+    int levelFrom(int level) const {
+        for (int word = level >> 6; word < bitmapWords; word++) {
+            uint64_t bits = nonEmpty[word];
+            if (word == level >> 6) {
+                bits &= ~uint64_t(0) << (level & 63);
+            }
+            if (bits != 0) {
+                return (word << 6) + __builtin_ctzll(bits);
+            }
+        }
+        return -1;
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param numberLevels Between 1 and maxLevels.
+     */
+    explicit BucketQueue(int numberLevels = 1) : numberLevels(numberLevels), numElements(0) {
+        assert(numberLevels >= 1 && numberLevels <= maxLevels);
+        for (int i = 0; i < bitmapWords; i++) {
+            nonEmpty[i] = 0;
+        }
+    }
+
+    // Move constructor
+    BucketQueue(BucketQueue &&other)
+            : numberLevels(other.numberLevels), numElements(other.numElements),
+              buckets(std::move(other.buckets)) {
+        for (int i = 0; i < bitmapWords; i++) {
+            nonEmpty[i] = other.nonEmpty[i];
+            other.nonEmpty[i] = 0;
+        }
+        other.numElements = 0;
+    }
+
+    /**
+     * Changes the number of levels, only while the queue is empty.
+     */
+    void setNumberLevels(int numberLevels) {
+        assert(isEmpty() && numberLevels >= 1 && numberLevels <= maxLevels);
+        this->numberLevels = numberLevels;
+        buckets.reset();
+    }
+
+    int getNumberLevels() const {
+        return numberLevels;
+    }
+
+    /**
+     * Adds an element after the others of its level.
+     */
+    void addLast(int level, const T &element) {
+        bucketFor(level).addLast(element);
+        numElements++;
+    }
+
+    /**
+     * Adds an element before the others of its level.
+     */
+    void addFirst(int level, const T &element) {
+        bucketFor(level).addFirst(element);
+        numElements++;
+    }
+
+    /**
+     * Returns the first element of the most urgent non-empty level.
+     */
+    T &getFirst() {
+        if (isEmpty()) {
+            std::cerr << "The list is empty";
+        }
+        return buckets[levelFrom(0)].getFirst();
+    }
+
+    /**
+     * Removes and returns the first element of the most urgent non-empty level.
+     */
+    T removeFirst() {
+        if (isEmpty()) {
+            std::cerr << "The list is empty";
+            return T();
+        }
+
+        int level = levelFrom(0);
+        T element = buckets[level].removeFirst();
+        markIfEmpty(level);
+        numElements--;
+        return element;
+    }
+
+    /**
+     * The non-empty levels in increasing order: firstLevel(), then
+     * nextLevel() of the previous one, until -1
+     */
+    int firstLevel() const {
+        return levelFrom(0);
+    }
+
+    int nextLevel(int level) const {
+        return level + 1 < numberLevels ? levelFrom(level + 1) : -1;
+    }
+
+    // The elements of one level, in order
+    RingDeque<T> &bucket(int level) {
+        return buckets[level];
+    }
+
+    bool isEmpty() const {
+        return (numElements == 0);
+    }
+
+    int size() const {
+        return numElements;
+    }
+
+    /**
+     * Returns the number of elements the levels can hold without growing.
+     */
+    long capacity() {
+        long total = 0;
+        if (buckets) {
+            for (int i = 0; i < numberLevels; i++) {
+                total += buckets[i].capacity();
+            }
+        }
+        return total;
+    }
+};
+
+#endif // __BUCKETQUEUE_H__
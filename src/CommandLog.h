@@ -0,0 +1,597 @@
+/**
+ * Write-ahead log of the commands that change a warehouse
+ * Every such command is appended before it runs, with its position in
+ * the stream. The records are written and synced in groups (group
+ * commit): a group is committed once it is full, or once its oldest
+ * record has waited for the durability window
+ *
+ * Layout of the file (native byte order):
+ *   LogHeader
+ *   blocks of LogBlockHeader then size bytes holding numberRecords records
+ * A record is the distance of its command from the previous one in the
+ * stream, the opcode and only the parameters the command uses, as
+ * variable-length integers (7 bits a byte, signed ones zigzag encoded);
+ * most take 2 to 8 bytes instead of the 32 of a Command
+ *
+ * A block that is cut short or does not match its checksum ends the log;
+ * it was being written when the process stopped. So do the zeros of an
+ * extent allocated ahead and not written yet
+ */
+
+#ifndef __COMMANDLOG_H__
+#define __COMMANDLOG_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "CommandParser.h"
+#include "Snapshot.h"
+
+const char LOG_MAGIC[4] = { 'R', 'B', 'W', 'L' };
+const uint32_t LOG_VERSION = 1;
+
+// The file is allocated this many bytes at a time
+const uint64_t LOG_EXTENT = 8 << 20;
+
+// Groups of records that may pile up while the writer is busy, before the commands wait for it
+const size_t LOG_BACKLOG_GROUPS = 16;
+
+// Longest encoded record: the distance, the opcode and five parameters
+const size_t LOG_MAX_RECORD = 10 + 1 + 5 * 5;
+
+struct LogHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t logID;             // also written in the snapshots taken while logging
+};
+
+struct LogBlockHeader {
+    uint32_t numberRecords;
+    uint32_t size;              // bytes of the records
+    uint64_t firstSequence;     // position in the stream the distances of the block start from
+    uint64_t checksum;          // of firstSequence and the records
+};
+
+static_assert(sizeof(LogHeader) == 16, "LogHeader must stay 16 bytes");
+static_assert(sizeof(LogBlockHeader) == 24, "LogBlockHeader must stay 24 bytes");
+
+// One command read back from a log
+struct LogRecord {
+    uint64_t sequence;          // position of the command in the input stream, from 0
+    Command command;
+};
+
+// The commands that change the warehouse, the only ones logged
+inline bool IsLoggedCommand(int opcode) {
+    switch (opcode) {
+    case OP_ADD_GET_BOX:
+    case OP_ADD_DROP_BOX:
+    case OP_EXECUTE:
+    case OP_UNDO:
+    case OP_CHECKPOINT:
+    case OP_ROLLBACK_TO:
+    case OP_ASSIGN_BATCH:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline unsigned char *EncodeUnsigned(unsigned char *position, uint64_t value) {
+    while (value >= 0x80) {
+        *position++ = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    *position++ = (unsigned char) value;
+    return position;
+}
+
+inline unsigned char *EncodeSigned(unsigned char *position, int32_t value) {
+    return EncodeUnsigned(position, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+
+// @return NULL if the value does not end before end
+inline const unsigned char *DecodeUnsigned(const unsigned char *position, const unsigned char *end,
+        uint64_t &value) {
+    value = 0;
+    for (int shift = 0; position != end && shift < 64; shift += 7) {
+        unsigned char byte = *position++;
+        value |= (uint64_t) (byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return position;
+        }
+    }
+    return NULL;
+}
+
+inline const unsigned char *DecodeSigned(const unsigned char *position, const unsigned char *end,
+        int32_t &value) {
+    uint64_t encoded;
+    position = DecodeUnsigned(position, end, encoded);
+    value = (int32_t) ((uint32_t) (encoded >> 1) ^ (0 - (uint32_t) (encoded & 1)));
+    return position;
+}
+
+/**
+ * Encodes the parameters a logged command uses.
+ *
+ * @return The end of the record.
+ */
+inline unsigned char *EncodeLoggedCommand(unsigned char *position, const Command &command) {
+    *position++ = command.opcode;
+    switch (command.opcode) {
+    case OP_ADD_GET_BOX:
+    case OP_ADD_DROP_BOX:
+        position = EncodeSigned(position, command.robotID);
+        position = EncodeSigned(position, command.x);
+        position = EncodeSigned(position, command.y);
+        position = EncodeSigned(position, command.numberBoxes);
+        return EncodeSigned(position, command.priority);
+    case OP_EXECUTE:
+        return EncodeSigned(position, command.robotID);
+    case OP_UNDO:
+    case OP_CHECKPOINT:
+    case OP_ROLLBACK_TO:
+        return EncodeSigned(position, command.argument);
+    default:
+        return position;
+    }
+}
+
+/**
+ * Decodes a record of EncodeLoggedCommand(), the other parameters of the
+ * command being 0.
+ *
+ * @return NULL if the record is malformed or does not end before end.
+ */
+inline const unsigned char *DecodeLoggedCommand(const unsigned char *position, const unsigned char *end,
+        Command &command) {
+    memset(&command, 0, sizeof(command));
+    if (position == end || !IsLoggedCommand(*position)) {
+        return NULL;
+    }
+    command.opcode = *position++;
+    switch (command.opcode) {
+    case OP_ADD_GET_BOX:
+    case OP_ADD_DROP_BOX:
+        if ((position = DecodeSigned(position, end, command.robotID)) == NULL
+                || (position = DecodeSigned(position, end, command.x)) == NULL
+                || (position = DecodeSigned(position, end, command.y)) == NULL
+                || (position = DecodeSigned(position, end, command.numberBoxes)) == NULL) {
+            return NULL;
+        }
+        return DecodeSigned(position, end, command.priority);
+    case OP_EXECUTE:
+        return DecodeSigned(position, end, command.robotID);
+    case OP_UNDO:
+    case OP_CHECKPOINT:
+    case OP_ROLLBACK_TO:
+        return DecodeSigned(position, end, command.argument);
+    default:
+        return position;
+    }
+}
+
+// Tells if two commands are logged the same, so a record matches the command of the input it came from
+inline bool SameLoggedCommand(const Command &first, const Command &second) {
+    unsigned char firstRecord[LOG_MAX_RECORD];
+    unsigned char secondRecord[LOG_MAX_RECORD];
+    size_t size = EncodeLoggedCommand(firstRecord, first) - firstRecord;
+    return size == (size_t) (EncodeLoggedCommand(secondRecord, second) - secondRecord)
+            && memcmp(firstRecord, secondRecord, size) == 0;
+}
+
+/**
+ * The records of a log that made it to the file, in order
+ */
+class LogReader {
+private:
+    LogHeader header;
+    std::vector<LogRecord> records;
+    uint64_t validLength;       // bytes up to the end of the last whole block
+
+    // Decodes a block whose checksum matched; false if its records do not fill it exactly
+    bool readBlock(const LogBlockHeader &block, const unsigned char *position) {
+        const unsigned char *end = position + block.size;
+        uint64_t sequence = block.firstSequence;
+        size_t first = records.size();
+        for (uint32_t i = 0; i < block.numberRecords; i++) {
+            uint64_t distance;
+            LogRecord record;
+            if ((position = DecodeUnsigned(position, end, distance)) == NULL
+                    || (position = DecodeLoggedCommand(position, end, record.command)) == NULL) {
+                records.resize(first);
+                return false;
+            }
+            sequence += distance;
+            record.sequence = sequence;
+            records.push_back(record);
+        }
+        if (position != end) {
+            records.resize(first);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    LogReader() : validLength(0) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    /**
+     * Reads a log up to its last whole block.
+     *
+     * @return False if the file can not be read or is not a log.
+     */
+    bool open(const char *path) {
+        MappedFile file;
+        records.clear();
+        if (!file.open(path) || file.size() < sizeof(LogHeader)) {
+            return false;
+        }
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) != 0 || header.version != LOG_VERSION) {
+            return false;
+        }
+
+        uint64_t position = sizeof(LogHeader);
+        LogBlockHeader block;
+        while (file.size() - position >= sizeof(block)) {
+            memcpy(&block, file.data() + position, sizeof(block));
+            const unsigned char *data = (const unsigned char *) file.data() + position + sizeof(block);
+            if (block.numberRecords == 0 || file.size() - position - sizeof(block) < block.size) {
+                break;
+            }
+            SnapshotChecksum checksum;
+            checksum.update(&block.firstSequence, sizeof(block.firstSequence));
+            checksum.update(data, block.size);
+            if (checksum.value() != block.checksum || !readBlock(block, data)) {
+                break;
+            }
+            position += sizeof(block) + block.size;
+        }
+        validLength = position;
+        return true;
+    }
+
+    // Getters & Setters
+    uint64_t getLogID() const {
+        return header.logID;
+    }
+
+    const std::vector<LogRecord> &getRecords() const {
+        return records;
+    }
+
+    uint64_t getValidLength() const {
+        return validLength;
+    }
+};
+
+/**
+ * Appends the commands to a log, a group at a time
+ * The groups are written and synced by a thread of their own, so the
+ * commands go on running while the disk syncs; while it is busy, the next
+ * group keeps growing and goes out as one block when it is done, so a
+ * slow disk gets fewer, larger writes. The writer also keeps the window:
+ * it sleeps until the oldest pending record is due and takes the group
+ * itself, so a record is committed in time even when no command follows
+ * it. The file grows by whole extents allocated ahead, so writing a group
+ * does not allocate blocks
+ */
+class CommandLog {
+private:
+    // The encoded records of one block
+    struct Group {
+        std::vector<unsigned char> bytes;
+        size_t size;
+        uint32_t numberRecords;
+        uint64_t firstSequence;
+
+        Group() : size(0), numberRecords(0), firstSequence(0) {}
+    };
+
+    int fd;
+    uint64_t logID;
+    uint64_t fileSize;          // allocated
+    uint64_t writePosition;     // end of the last block written
+
+    // Filled by the thread running the commands under the mutex, taken by the writer when it is due
+    Group pending;
+    size_t groupSize;
+    std::chrono::steady_clock::duration window;
+    std::chrono::steady_clock::time_point oldestPending;
+
+    // Only used by the thread running the commands
+    uint64_t nextSequence;
+    uint64_t lastSequence;      // of the last command logged, the distances start from it
+    uint64_t numberRecords;     // in the log, committed or pending
+
+    // Written and synced by the writer thread while busy is set
+    Group writing;
+    bool busy;
+    bool stopping;
+    bool failed;
+    long long numberCommits;
+    std::mutex mutex;
+    std::condition_variable groupReady;
+    std::condition_variable groupWritten;
+    std::thread writer;
+
+    CommandLog(const CommandLog &);
+    CommandLog &operator=(const CommandLog &);
+
+    bool writeAll(const void *data, size_t size) {
+        const char *bytes = (const char *) data;
+        while (size > 0) {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written <= 0) {
+                return false;
+            }
+            bytes += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    // Writes one group as a block, allocating the next extent first if it does not fit
+    bool writeBlock(const Group &group) {
+        LogBlockHeader block;
+        block.numberRecords = group.numberRecords;
+        block.size = (uint32_t) group.size;
+        block.firstSequence = group.firstSequence;
+        SnapshotChecksum checksum;
+        checksum.update(&block.firstSequence, sizeof(block.firstSequence));
+        checksum.update(group.bytes.data(), group.size);
+        block.checksum = checksum.value();
+
+        uint64_t blockBytes = sizeof(block) + group.size;
+        if (writePosition + blockBytes > fileSize) {
+            uint64_t grown = (writePosition + blockBytes + LOG_EXTENT - 1) / LOG_EXTENT * LOG_EXTENT;
+            if (posix_fallocate(fd, fileSize, grown - fileSize) == 0) {
+                fileSize = grown;
+            }
+        }
+        if (!writeAll(&block, sizeof(block)) || !writeAll(group.bytes.data(), group.size)
+                || fdatasync(fd) != 0) {
+            return false;
+        }
+        writePosition += blockBytes;
+        return true;
+    }
+
+    // Hands the pending records to the writer thread; the mutex is held
+    void takePending() {
+        std::swap(pending, writing);
+        busy = true;
+    }
+
+    // The pending group is full, or its oldest record has waited for the window
+    bool pendingDue() const {
+        return pending.numberRecords >= groupSize || (pending.numberRecords > 0 && window.count() > 0
+                && std::chrono::steady_clock::now() - oldestPending >= window);
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (!busy && pendingDue()) {
+                takePending();
+            }
+            if (!busy) {
+                if (stopping) {
+                    return;
+                }
+                if (pending.numberRecords > 0 && window.count() > 0) {
+                    groupReady.wait_until(lock, oldestPending + window);
+                } else {
+                    groupReady.wait(lock);
+                }
+                continue;
+            }
+
+            lock.unlock();
+            bool written = failed || writeBlock(writing);
+            lock.lock();
+
+            failed = !written;
+            writing.size = 0;
+            writing.numberRecords = 0;
+            busy = false;
+            numberCommits++;
+            groupWritten.notify_all();
+        }
+    }
+
+    /**
+        Hands the pending records to the writer thread, if it is done with
+        the previous group; with wait, waits for it to be done
+
+        @param lock Holds the mutex
+    */
+    void handOff(std::unique_lock<std::mutex> &lock, bool wait) {
+        if (wait) {
+            groupWritten.wait(lock, [this] { return !busy; });
+        }
+        if (!busy && pending.numberRecords > 0) {
+            takePending();
+            groupReady.notify_one();
+        }
+    }
+
+    bool start() {
+        fileSize = lseek(fd, 0, SEEK_END);
+        writer = std::thread(&CommandLog::writerLoop, this);
+        return true;
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param groupSize Records committed together, unless the writer is
+     * still busy with the previous group.
+     * @param windowMilliseconds Longest a record waits before the writer
+     * takes its group, 0 to only hand over full groups.
+     */
+    CommandLog(size_t groupSize, int windowMilliseconds)
+            : fd(-1), logID(0), fileSize(0), writePosition(0), groupSize(groupSize > 0 ? groupSize : 1),
+              window(std::chrono::milliseconds(windowMilliseconds)), nextSequence(0), lastSequence(0),
+              numberRecords(0), busy(false), stopping(false), failed(false), numberCommits(0) {
+        pending.bytes.resize(this->groupSize * LOG_MAX_RECORD);
+        writing.bytes.resize(this->groupSize * LOG_MAX_RECORD);
+    }
+
+    ~CommandLog() {
+        close();
+    }
+
+    /**
+     * Starts a new log, replacing the file.
+     *
+     * @return False if the file could not be written.
+     */
+    bool create(const char *path) {
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+
+        LogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+        header.version = LOG_VERSION;
+        header.logID = ((uint64_t) std::chrono::system_clock::now().time_since_epoch().count() << 16)
+                ^ (uint64_t) getpid();
+        logID = header.logID;
+        writePosition = sizeof(header);
+        return writeAll(&header, sizeof(header)) && fdatasync(fd) == 0 && start();
+    }
+
+    /**
+     * Goes on with a log that was read back, dropping the block it was
+     * writing when it stopped.
+     *
+     * @param nextSequence The position in the stream of the next command,
+     * after the last one logged.
+     * @return False if the file could not be opened.
+     */
+    bool reopen(const char *path, const LogReader &reader, uint64_t nextSequence) {
+        fd = ::open(path, O_WRONLY);
+        if (fd < 0 || ftruncate(fd, reader.getValidLength()) != 0
+                || lseek(fd, reader.getValidLength(), SEEK_SET) < 0) {
+            return false;
+        }
+        logID = reader.getLogID();
+        writePosition = reader.getValidLength();
+        numberRecords = reader.getRecords().size();
+        if (!reader.getRecords().empty()) {
+            lastSequence = reader.getRecords().back().sequence;
+        }
+        this->nextSequence = nextSequence;
+        return start();
+    }
+
+    /**
+     * Takes the next command of the stream, logging it if it changes the
+     * warehouse; must be called for every command, in order, before it runs.
+     */
+    void append(const Command &command) {
+        uint64_t sequence = nextSequence++;
+        if (!IsLoggedCommand(command.opcode)) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        bool first = pending.numberRecords == 0;
+        if (first) {
+            oldestPending = std::chrono::steady_clock::now();
+            pending.firstSequence = lastSequence;
+        }
+        if (pending.size + LOG_MAX_RECORD > pending.bytes.size()) {
+            pending.bytes.resize(pending.bytes.size() * 2);
+        }
+        unsigned char *position = EncodeUnsigned(&pending.bytes[pending.size], sequence - lastSequence);
+        position = EncodeLoggedCommand(position, command);
+        pending.size = position - pending.bytes.data();
+        pending.numberRecords++;
+        lastSequence = sequence;
+        numberRecords++;
+
+        if (pending.numberRecords >= groupSize) {
+            handOff(lock, pending.numberRecords >= groupSize * LOG_BACKLOG_GROUPS);
+        } else if (first && window.count() > 0 && !busy) {
+            groupReady.notify_one();    // the writer starts timing the window of the new group
+        }
+    }
+
+    /**
+     * Writes the pending records and waits until all the log is on disk.
+     *
+     * @return False if the log could not be written, then or before.
+     */
+    bool commit() {
+        if (fd < 0) {
+            return !failed;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        handOff(lock, true);
+        groupWritten.wait(lock, [this] { return !busy; });
+        return !failed;
+    }
+
+    // Commits what is pending, gives back the extent allocated ahead and closes the file
+    bool close() {
+        if (fd < 0) {
+            return !failed;
+        }
+        bool committed = commit();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        groupReady.notify_one();
+        writer.join();
+
+        if (ftruncate(fd, writePosition) != 0) {
+            committed = false;
+        }
+        ::close(fd);
+        fd = -1;
+        return committed;
+    }
+
+    // Getters & Setters
+    bool hasPending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending.numberRecords > 0;
+    }
+
+    uint64_t getLogID() const {
+        return logID;
+    }
+
+    uint64_t getNumberRecords() const {
+        return numberRecords;
+    }
+
+    uint64_t getNextSequence() const {
+        return nextSequence;
+    }
+
+    long long getNumberCommits() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return numberCommits;
+    }
+};
+
+#endif // __COMMANDLOG_H__
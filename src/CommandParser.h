@@ -0,0 +1,464 @@
+/**
+ * Zero-copy parser for the command stream of robots.in
+ * The input file is mapped in memory and tokenized in place,
+ * command names are resolved through a precomputed opcode table
+ */
+
+#ifndef __COMMANDPARSER_H__
+#define __COMMANDPARSER_H__
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum Opcode {
+    OP_ADD_GET_BOX,
+    OP_ADD_DROP_BOX,
+    OP_EXECUTE,
+    OP_PRINT_COMMANDS,
+    OP_LAST_EXECUTED_COMMAND,
+    OP_UNDO,
+    OP_HOW_MUCH_TIME,
+    OP_HOW_MANY_BOXES,
+    OP_CHECKPOINT,
+    OP_ROLLBACK_TO,
+    OP_QUERY_REGION,
+    OP_ASSIGN_BATCH,
+    OP_STATS,
+    OP_SNAPSHOT,
+    OP_INVALID
+};
+
+/**
+ * One command of the stream with its parameters
+ * Fixed width, so the same record is used by the binary trace format
+ * Parameters the command does not take keep their previous values,
+ * the same way the variables filled by fscanf() did
+ */
+struct Command {
+    uint8_t opcode;
+    uint8_t reserved[3];
+    int32_t robotID;
+    int32_t x;
+    int32_t y;
+    int32_t numberBoxes;
+    int32_t priority;
+    /**
+        UNDO: the number of commands to undo
+        CHECKPOINT, ROLLBACK_TO: the ID given to the checkpoint name
+        HOW_MUCH_TIME: 1 if a robot was given, 0 otherwise
+        QUERY_REGION: the row of the second corner, x and y being the first
+        SNAPSHOT: the ID given to the file name
+    */
+    int32_t argument;
+    /**
+        QUERY_REGION: the column of the second corner
+    */
+    int32_t secondArgument;
+};
+
+/**
+ * The names given in the stream, by the IDs the commands hold: the
+ * checkpoint names (CHECKPOINT, ROLLBACK_TO) and the file names (SNAPSHOT)
+ */
+struct CommandNames {
+    std::vector<std::string> checkpoints;
+    std::vector<std::string> files;
+};
+
+/**
+ * Read-only view of a whole file
+ * Regular files are memory mapped, anything that can not be mapped
+ * (pipes, empty files) is read into a heap buffer instead
+ */
+class MappedFile {
+private:
+    const char *contents;
+    size_t length;
+    bool mapped;
+
+    // A mapping can not be shared between two owners
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    bool readWhole(int fd) {
+        size_t capacity = 1 << 16;
+        char *buffer = (char *) malloc(capacity);
+        size_t used = 0;
+        ssize_t count = 0;
+
+        while (buffer != NULL && (count = read(fd, buffer + used, capacity - used)) > 0) {
+            used += count;
+            if (used == capacity) {
+                capacity *= 2;
+                char *grown = (char *) realloc(buffer, capacity);
+                if (grown == NULL) {
+                    free(buffer);
+                }
+                buffer = grown;
+            }
+        }
+        if (buffer == NULL || count < 0) {
+            free(buffer);
+            return false;
+        }
+
+        contents = buffer;
+        length = used;
+        return true;
+    }
+
+public:
+    // Constructor
+    MappedFile() : contents(NULL), length(0), mapped(false) {}
+
+    // Destructor
+    ~MappedFile() {
+        close();
+    }
+
+    /**
+     * Maps the file with the given path.
+     *
+     * @return True if the file could be opened, False otherwise.
+     */
+    bool open(const char *path) {
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        bool opened = false;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void *address = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                // The parser walks the file once from start to end
+                madvise(address, info.st_size, MADV_SEQUENTIAL);
+                contents = (const char *) address;
+                length = info.st_size;
+                mapped = true;
+                opened = true;
+            }
+        }
+        if (!opened) {
+            opened = readWhole(fd);
+        }
+
+        ::close(fd);
+        return opened;
+    }
+
+    void close() {
+        if (mapped) {
+            munmap((void *) contents, length);
+        } else {
+            free((void *) contents);
+        }
+        contents = NULL;
+        length = 0;
+        mapped = false;
+    }
+
+    // Getters & Setters
+    const char *data() const {
+        return contents;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+/**
+ * Cursor over an in-memory command stream
+ * Follows the conventions of fscanf(): tokens are separated by any
+ * whitespace and a malformed number is left in place for the next read
+ */
+class CommandScanner {
+private:
+    const char *position;
+    const char *end;
+
+    // IDs given to the checkpoint names, in order of appearance
+    std::unordered_map<std::string, int> checkpointIDs;
+    CommandNames names;
+
+    static bool isSpace(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    void skipSpaces() {
+        while (position != end && isSpace(*position)) {
+            position++;
+        }
+    }
+
+public:
+    // Constructor
+    CommandScanner(const char *data, size_t size) : position(data), end(data + size) {}
+
+    /**
+     * Goes on with the next part of a stream, keeping the names seen so far.
+     */
+    void reset(const char *data, size_t size) {
+        position = data;
+        end = data + size;
+    }
+
+    // The first character not read yet
+    const char *getPosition() const {
+        return position;
+    }
+
+    /**
+     * Returns the next whitespace separated token, without copying it.
+     *
+     * @param token Set to the first character of the token.
+     * @param length Set to the number of characters of the token.
+     * @return False if the end of the stream was reached, True otherwise.
+     */
+    bool nextToken(const char *&token, int &length) {
+        skipSpaces();
+        if (position == end) {
+            return false;
+        }
+
+        token = position;
+        while (position != end && !isSpace(*position)) {
+            position++;
+        }
+        length = (int) (position - token);
+        return true;
+    }
+
+    /**
+     * Reads the next decimal integer.
+     *
+     * @param value Set to the number read, left unchanged on failure.
+     * @return True if a number was read, False otherwise.
+     */
+    bool nextInt(int &value) {
+        skipSpaces();
+
+        bool negative = false;
+        if (position != end && (*position == '-' || *position == '+')) {
+            negative = (*position == '-');
+            position++;
+        }
+        if (position == end || *position < '0' || *position > '9') {
+            return false;
+        }
+
+        unsigned int number = 0;
+        while (position != end && *position >= '0' && *position <= '9') {
+            number = number * 10 + (*position - '0');
+            position++;
+        }
+
+        value = (int) (negative ? 0u - number : number);
+        return true;
+    }
+
+    /**
+     * Reads the next command and the parameters it takes.
+     * Like fscanf(), stops at the first parameter that is not a number.
+     *
+     * @param command Updated with the opcode and the parameters read.
+     * @return False if the end of the stream was reached, True otherwise.
+     */
+    bool nextCommand(Command &command);
+
+    /**
+     * Returns the ID of a checkpoint name, giving it a new one if the
+     * name was not seen before.
+     */
+    int checkpointID(const char *name, int length) {
+        std::pair<std::unordered_map<std::string, int>::iterator, bool> inserted =
+                checkpointIDs.insert(std::make_pair(std::string(name, length),
+                        (int) checkpointIDs.size()));
+        if (inserted.second) {
+            names.checkpoints.push_back(inserted.first->first);
+        }
+        return inserted.first->second;
+    }
+
+    /**
+     * Gives the names the next IDs, in order, as if the stream had
+     * started with them; used to go on from a snapshot.
+     */
+    void addCheckpointNames(const std::vector<std::string> &checkpointNames) {
+        for (size_t i = 0; i < checkpointNames.size(); i++) {
+            checkpointID(checkpointNames[i].data(), (int) checkpointNames[i].size());
+        }
+    }
+
+    /**
+     * Returns the ID of a file name given to a command.
+     */
+    int fileNameID(const char *name, int length) {
+        names.files.push_back(std::string(name, length));
+        return (int) names.files.size() - 1;
+    }
+
+    // The names seen so far, with their IDs
+    const CommandNames &getNames() const {
+        return names;
+    }
+};
+
+/**
+ * Returns the name of a command as written in the input file.
+ */
+inline const char *OpcodeName(Opcode opcode) {
+    static const char *const names[OP_INVALID + 1] = {
+        "ADD_GET_BOX", "ADD_DROP_BOX", "EXECUTE", "PRINT_COMMANDS",
+        "LAST_EXECUTED_COMMAND", "UNDO", "HOW_MUCH_TIME", "HOW_MANY_BOXES",
+        "CHECKPOINT", "ROLLBACK_TO", "QUERY_REGION", "ASSIGN_BATCH", "STATS", "SNAPSHOT", ""
+    };
+    return names[opcode];
+}
+
+/**
+ * Open addressing hash table from command names to opcodes
+ * Built once, so a lookup costs one hash and one comparison
+ * instead of a chain of strcmp() calls
+ */
+class OpcodeTable {
+private:
+    static const int tableSize = 64;
+
+    const char *names[tableSize];
+    int lengths[tableSize];
+    Opcode opcodes[tableSize];
+
+    static unsigned int hash(const char *text, int length) {
+        unsigned int h = 2166136261u;
+        for (int i = 0; i < length; i++) {
+            h = (h ^ (unsigned char) text[i]) * 16777619u;
+        }
+        return h & (tableSize - 1);
+    }
+
+public:
+    // Constructor
+    OpcodeTable() {
+        for (int i = 0; i < tableSize; i++) {
+            names[i] = NULL;
+            lengths[i] = 0;
+            opcodes[i] = OP_INVALID;
+        }
+
+        for (int op = 0; op < OP_INVALID; op++) {
+            const char *name = OpcodeName((Opcode) op);
+            int length = (int) strlen(name);
+
+            unsigned int slot = hash(name, length);
+            while (names[slot] != NULL) {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            names[slot] = name;
+            lengths[slot] = length;
+            opcodes[slot] = (Opcode) op;
+        }
+    }
+
+    /**
+     * Returns the opcode of a command name.
+     *
+     * @return OP_INVALID if the name is not a known command.
+     */
+    Opcode lookup(const char *token, int length) const {
+        unsigned int slot = hash(token, length);
+        while (names[slot] != NULL) {
+            if (lengths[slot] == length && memcmp(names[slot], token, length) == 0) {
+                return opcodes[slot];
+            }
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        return OP_INVALID;
+    }
+};
+
+inline Opcode LookupOpcode(const char *token, int length) {
+    static const OpcodeTable table;
+    return table.lookup(token, length);
+}
+
+inline bool CommandScanner::nextCommand(Command &command) {
+    const char *token;
+    int length;
+
+    if (!nextToken(token, length)) {
+        return false;
+    }
+
+    Opcode opcode = LookupOpcode(token, length);
+    command.opcode = (uint8_t) opcode;
+
+    switch (opcode) {
+    case OP_ADD_GET_BOX:
+    case OP_ADD_DROP_BOX:
+        if (nextInt(command.robotID) && nextInt(command.x) && nextInt(command.y)
+                && nextInt(command.numberBoxes)) {
+            nextInt(command.priority);
+        }
+        break;
+
+    case OP_EXECUTE:
+    case OP_PRINT_COMMANDS:
+    case OP_HOW_MANY_BOXES:
+        nextInt(command.robotID);
+        break;
+
+    case OP_HOW_MUCH_TIME:
+        // The robot is optional, without it the command does nothing as before
+        command.argument = nextInt(command.robotID) ? 1 : 0;
+        break;
+
+    case OP_UNDO:
+        // The number of commands is optional
+        command.argument = 1;
+        nextInt(command.argument);
+        break;
+
+    case OP_QUERY_REGION:
+        if (nextInt(command.x) && nextInt(command.y) && nextInt(command.argument)) {
+            nextInt(command.secondArgument);
+        }
+        break;
+
+    case OP_CHECKPOINT:
+    case OP_ROLLBACK_TO:
+        if (nextToken(token, length)) {
+            command.argument = checkpointID(token, length);
+        } else {
+            command.opcode = OP_INVALID;
+        }
+        break;
+
+    case OP_SNAPSHOT:
+        if (nextToken(token, length)) {
+            command.argument = fileNameID(token, length);
+        } else {
+            command.opcode = OP_INVALID;
+        }
+        break;
+
+    default:
+        break;
+    }
+    return true;
+}
+
+#endif // __COMMANDPARSER_H__
@@ -0,0 +1,165 @@
+/**
+ * Packed records for the commands kept in the robots' queues and in the
+ * history of executed commands
+ * A command is stored in 12 bytes instead of a std::tuple
+ */
+
+#ifndef __COMMANDRECORD_H__
+#define __COMMANDRECORD_H__
+
+#include <stdint.h>
+
+enum CommandType { GET, DROP };
+
+/**
+ * Number of bits of the x and y coordinates, the warehouse can have at
+ * most 2^WAREHOUSE_COORDINATE_BITS rows and columns
+ * The ID of the robot in a HistoryRecord takes the bits left over, so a
+ * wider coordinate allows fewer robots
+ */
+#ifndef WAREHOUSE_COORDINATE_BITS
+#define WAREHOUSE_COORDINATE_BITS 18
+#endif
+
+/**
+ * A 64-bit word holding, from the least significant bit:
+ *   1 bit          CommandType
+ *   CoordBits      x
+ *   CoordBits      y
+ * followed by the number of boxes, a whole int: the history keeps the
+ * boxes actually moved, which can be all the boxes of a cell
+ */
+#pragma pack(push, 4)
+template <unsigned CoordBits>
+class PackedCommand {
+private:
+    static_assert(CoordBits >= 1 && CoordBits <= 31, "unsupported coordinate width");
+
+    static const unsigned xShift = 1;
+    static const unsigned yShift = 1 + CoordBits;
+    static const uint64_t coordinateMask = (uint64_t(1) << CoordBits) - 1;
+
+    uint64_t bits;
+    int32_t boxes;
+
+public:
+    static const int maxCoordinate = (int) coordinateMask;
+
+    // The bits of the word above the coordinates, left for the records that embed a command
+    static const unsigned spareShift = 1 + 2 * CoordBits;
+    static const unsigned spareBits = 64 - spareShift;
+
+    // Constructor
+    PackedCommand() : bits(0), boxes(0) {}
+
+    // Another constructor
+    PackedCommand(CommandType commandType, int x, int y, int numberBoxes)
+            : bits((uint64_t) commandType
+                    | (((uint64_t) x & coordinateMask) << xShift)
+                    | (((uint64_t) y & coordinateMask) << yShift)),
+              boxes(numberBoxes) {}
+
+    CommandType type() const {
+        return (CommandType) (bits & 1);
+    }
+
+    int x() const {
+        return (int) ((bits >> xShift) & coordinateMask);
+    }
+
+    int y() const {
+        return (int) ((bits >> yShift) & coordinateMask);
+    }
+
+    int numberBoxes() const {
+        return boxes;
+    }
+
+    uint64_t spare() const {
+        return bits >> spareShift;
+    }
+
+    // The same command, with the given value in the spare bits
+    PackedCommand withSpare(uint64_t value) const {
+        PackedCommand command = *this;
+        command.bits = (bits & ((uint64_t(1) << spareShift) - 1)) | (value << spareShift);
+        return command;
+    }
+};
+#pragma pack(pop)
+
+typedef PackedCommand<WAREHOUSE_COORDINATE_BITS> QueuedCommand;
+
+/**
+ * A command in the history of executed commands: the command, with the
+ * number of boxes actually moved, the robot that executed it and the
+ * cell the robot was at before (-1 if it had not executed anything yet)
+ *
+ * The robot and its cell fill the spare bits of the command's word, then
+ * one more 32-bit word, from the least significant bit:
+ *   1 bit          whether the robot had a cell before
+ *   CoordBits      originX
+ *   CoordBits      originY
+ *   the rest       robotID, at most 31 bits
+ * Packed to 16 bytes
+ */
+#pragma pack(push, 4)
+class HistoryRecord {
+private:
+    static const unsigned coordinateBits = WAREHOUSE_COORDINATE_BITS;
+    static const unsigned originXShift = 1;
+    static const unsigned originYShift = 1 + coordinateBits;
+    static const unsigned robotShift = 1 + 2 * coordinateBits;
+    static const unsigned tailBits = QueuedCommand::spareBits + 32 > 64 ? 64 : QueuedCommand::spareBits + 32;
+    static const uint64_t coordinateMask = (uint64_t(1) << coordinateBits) - 1;
+
+    static_assert(tailBits >= robotShift + 16,
+            "WAREHOUSE_COORDINATE_BITS leaves fewer than 16 bits for the robot IDs");
+
+    QueuedCommand packed;       // the command, with the low bits of the tail
+    uint32_t extra;             // the high bits of the tail
+
+    uint64_t tail() const {
+        return packed.spare() | ((uint64_t) extra << QueuedCommand::spareBits);
+    }
+
+public:
+    static const unsigned robotBits = tailBits - robotShift > 31 ? 31 : tailBits - robotShift;
+    static const int maxRobotID = (int) ((uint64_t(1) << robotBits) - 1);
+
+    HistoryRecord() : packed(), extra(0) {}
+
+    HistoryRecord(int robotID, QueuedCommand command, int originX = -1, int originY = -1) {
+        uint64_t value = (uint64_t) robotID << robotShift;
+        if (originX >= 0) {
+            value |= 1 | (((uint64_t) originX & coordinateMask) << originXShift)
+                    | (((uint64_t) originY & coordinateMask) << originYShift);
+        }
+        packed = command.withSpare(value);
+        extra = (uint32_t) (value >> QueuedCommand::spareBits);
+    }
+
+    QueuedCommand command() const {
+        return packed.withSpare(0);
+    }
+
+    int robotID() const {
+        return (int) ((tail() >> robotShift) & maxRobotID);
+    }
+
+    int originX() const {
+        uint64_t value = tail();
+        return (value & 1) ? (int) ((value >> originXShift) & coordinateMask) : -1;
+    }
+
+    int originY() const {
+        uint64_t value = tail();
+        return (value & 1) ? (int) ((value >> originYShift) & coordinateMask) : -1;
+    }
+};
+#pragma pack(pop)
+
+static_assert(sizeof(QueuedCommand) == 12, "QueuedCommand must stay 12 bytes");
+static_assert(sizeof(HistoryRecord) == 16, "HistoryRecord must stay 16 bytes");
+
+#endif // __COMMANDRECORD_H__
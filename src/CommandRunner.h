@@ -0,0 +1,111 @@
+/**
+ * Execution of the parsed commands on a warehouse
+ */
+
+#ifndef __COMMANDRUNNER_H__
+#define __COMMANDRUNNER_H__
+
+#include "CommandParser.h"
+#include "OutputBuffer.h"
+#include "Warehouse.h"
+
+/**
+    Executes one command on the warehouse and writes its result
+    Shared by the text input, the binary trace replay and ParallelRunner
+
+    @param names The checkpoint and file names of the stream, by ID
+    @param discarded Receives the results that are not part of robots.out
+*/
+inline void RunCommand(Warehouse &warehouse, const Command &command,
+        const CommandNames &names, OutputBuffer &output, OutputBuffer &discarded) {
+    WarehouseStatus status;
+#ifdef WAREHOUSE_STATS
+    StatsTimer timer(warehouse.GetStats(), command.opcode);
+#endif
+
+    switch (command.opcode) {
+    case OP_ADD_GET_BOX:
+        warehouse.AddGetBox(command.robotID, command.x, command.y,
+                command.numberBoxes, command.priority);
+        break;
+
+    case OP_ADD_DROP_BOX:
+        warehouse.AddDropBox(command.robotID, command.x, command.y,
+                command.numberBoxes, command.priority);
+        break;
+
+    case OP_EXECUTE:
+        status = warehouse.Execute(command.robotID);
+        if (status != STATUS_EXECUTED) {
+            output.writeLine(StatusMessage(status));
+        }
+        break;
+
+    case OP_PRINT_COMMANDS:
+        warehouse.PrintCommands(command.robotID, discarded);
+        break;
+
+    case OP_LAST_EXECUTED_COMMAND:
+        warehouse.LastExecutedCommand(discarded);
+        break;
+
+    case OP_UNDO:
+        if (command.argument == 1) {
+            status = warehouse.Undo();
+            if (status != STATUS_EXECUTED) {
+                output.writeLine(StatusMessage(status));
+            }
+        } else {
+            // Every command the history could not provide is one failed UNDO
+            output.writeLines(StatusMessage(STATUS_NO_HISTORY), command.argument - warehouse.UndoMany(command.argument));
+        }
+        break;
+
+    case OP_CHECKPOINT:
+        warehouse.SetCheckpoint(command.argument);
+        break;
+
+    case OP_ROLLBACK_TO:
+        status = warehouse.RollbackTo(command.argument);
+        if (status != STATUS_EXECUTED) {
+            output.writeLine(StatusMessage(status));
+        }
+        break;
+
+    case OP_HOW_MUCH_TIME:
+        if (command.argument == 1) {
+            warehouse.HowMuchTime(command.robotID, output);
+        }
+        break;
+
+    case OP_HOW_MANY_BOXES:
+        warehouse.HowManyBoxes(command.robotID, output);
+        break;
+
+    case OP_QUERY_REGION:
+        warehouse.QueryRegion(command.x, command.y, command.argument, command.secondArgument, output);
+        break;
+
+    case OP_ASSIGN_BATCH:
+        warehouse.AssignBatch(output);
+        break;
+
+    case OP_STATS:
+        warehouse.PrintStats(output);
+        break;
+
+    case OP_SNAPSHOT:
+        status = command.argument >= 0 && command.argument < (int) names.files.size()
+                ? warehouse.SaveSnapshot(names.files[command.argument].c_str(), names.checkpoints, output.sync())
+                : STATUS_NO_SNAPSHOT;
+        if (status != STATUS_EXECUTED) {
+            output.writeLine(StatusMessage(status));
+        }
+        break;
+
+    default:
+        output.writeLine("The command is incorrect");
+    }
+}
+
+#endif // __COMMANDRUNNER_H__
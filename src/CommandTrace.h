@@ -0,0 +1,238 @@
+/**
+ * Binary command trace
+ * A robots.in file compiled into fixed-width records, so the same
+ * input can be replayed many times without parsing any text
+ *
+ * Layout of the file (native byte order):
+ *   TraceHeader
+ *   numberRows * numberColumns int32 map values, row by row
+ *   numberCommands Command records
+ *   the names given to the commands, in the order of their IDs, each as
+ *   an uint32 length followed by its characters: an uint32 count and the
+ *   checkpoint names, then the file names up to the end
+ */
+
+#ifndef __COMMANDTRACE_H__
+#define __COMMANDTRACE_H__
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "CommandParser.h"
+
+const char TRACE_MAGIC[4] = { 'R', 'B', 'T', 'R' };
+const uint32_t TRACE_VERSION = 5;
+
+struct TraceHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t numberRobots;
+    int32_t numberRows;
+    int32_t numberColumns;
+    uint32_t commandSize;       // sizeof(Command) of the writer
+    uint64_t numberCommands;
+};
+
+static_assert(sizeof(TraceHeader) == 32, "TraceHeader must stay 32 bytes");
+static_assert(sizeof(Command) == 32, "Command records must stay 32 bytes");
+
+/**
+ * Compiles a text command stream into a binary trace.
+ *
+ * @param input The contents of a robots.in file.
+ * @param tracePath Path of the trace to be written.
+ * @return Number of commands written, -1 if the trace could not be written.
+ */
+inline long long CompileTrace(const MappedFile &input, const char *tracePath) {
+    FILE *traceFile = fopen(tracePath, "wb");
+    if (traceFile == NULL) {
+        return -1;
+    }
+
+    CommandScanner scanner(input.data(), input.size());
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.commandSize = sizeof(Command);
+
+    int numberRobots = 0, numberRows = 0, numberColumns = 0;
+    if (scanner.nextInt(numberRobots) && scanner.nextInt(numberRows)) {
+        scanner.nextInt(numberColumns);
+    }
+    header.numberRobots = numberRobots;
+    header.numberRows = numberRows;
+    header.numberColumns = numberColumns;
+    bool written = fwrite(&header, sizeof(header), 1, traceFile) == 1;
+
+    // The map is stored exactly as the text parser would have read it
+    std::vector<int32_t> row(numberColumns > 0 ? numberColumns : 0);
+    int value = 0;
+    for (int i = 0; i < numberRows && written; i++) {
+        for (int j = 0; j < numberColumns; j++) {
+            scanner.nextInt(value);
+            row[j] = value;
+        }
+        written = fwrite(row.data(), sizeof(int32_t), row.size(), traceFile) == row.size();
+    }
+
+    // Commands are written in blocks to keep the number of writes low
+    const size_t blockSize = 4096;
+    std::vector<Command> block;
+    block.reserve(blockSize);
+    Command command;
+    memset(&command, 0, sizeof(command));
+
+    while (written && scanner.nextCommand(command)) {
+        block.push_back(command);
+        header.numberCommands++;
+        if (block.size() == blockSize) {
+            written = fwrite(block.data(), sizeof(Command), block.size(), traceFile) == block.size();
+            block.clear();
+        }
+    }
+    if (written && !block.empty()) {
+        written = fwrite(block.data(), sizeof(Command), block.size(), traceFile) == block.size();
+    }
+
+    const CommandNames &names = scanner.getNames();
+    uint32_t numberCheckpoints = (uint32_t) names.checkpoints.size();
+    written = written && fwrite(&numberCheckpoints, sizeof(numberCheckpoints), 1, traceFile) == 1;
+    for (size_t i = 0; i < names.checkpoints.size() + names.files.size() && written; i++) {
+        const std::string &name = i < names.checkpoints.size()
+                ? names.checkpoints[i] : names.files[i - names.checkpoints.size()];
+        uint32_t length = (uint32_t) name.size();
+        written = fwrite(&length, sizeof(length), 1, traceFile) == 1
+                && fwrite(name.data(), 1, length, traceFile) == length;
+    }
+
+    // The number of commands is only known at the end
+    if (written) {
+        written = fseek(traceFile, 0, SEEK_SET) == 0
+                && fwrite(&header, sizeof(header), 1, traceFile) == 1;
+    }
+    if (fclose(traceFile) != 0) {
+        written = false;
+    }
+
+    return written ? (long long) header.numberCommands : -1;
+}
+
+/**
+ * Memory mapped binary trace
+ * Map values and commands are used in place, straight from the mapping
+ */
+class TraceReader {
+private:
+    MappedFile file;
+    const TraceHeader *header;
+    CommandNames names;
+
+    // Reads a length and the characters after it, moving position past them
+    static bool readName(const char *&position, const char *end, std::string &name) {
+        uint32_t length;
+        if ((size_t) (end - position) < sizeof(length)) {
+            return false;
+        }
+        memcpy(&length, position, sizeof(length));
+        position += sizeof(length);
+        if ((size_t) (end - position) < length) {
+            return false;
+        }
+        name.assign(position, length);
+        position += length;
+        return true;
+    }
+
+public:
+    // Constructor
+    TraceReader() : header(NULL) {}
+
+    /**
+     * Maps a trace and checks that it is complete.
+     *
+     * @return True if the trace is valid, False otherwise.
+     */
+    bool open(const char *path) {
+        header = NULL;
+        if (!file.open(path) || file.size() < sizeof(TraceHeader)) {
+            return false;
+        }
+
+        const TraceHeader *candidate = (const TraceHeader *) file.data();
+        if (memcmp(candidate->magic, TRACE_MAGIC, sizeof(candidate->magic)) != 0
+                || candidate->version != TRACE_VERSION
+                || candidate->commandSize != sizeof(Command)
+                || candidate->numberRows < 0 || candidate->numberColumns < 0) {
+            return false;
+        }
+
+        uint64_t mapSize = (uint64_t) candidate->numberRows * candidate->numberColumns * sizeof(int32_t);
+        uint64_t expectedSize = sizeof(TraceHeader) + mapSize + candidate->numberCommands * sizeof(Command);
+        if (expectedSize > file.size()) {
+            return false;
+        }
+
+        // The rest of the file holds the names, exactly
+        names = CommandNames();
+        const char *position = file.data() + expectedSize;
+        const char *end = file.data() + file.size();
+        uint32_t numberCheckpoints;
+        if ((size_t) (end - position) < sizeof(numberCheckpoints)) {
+            return false;
+        }
+        memcpy(&numberCheckpoints, position, sizeof(numberCheckpoints));
+        position += sizeof(numberCheckpoints);
+
+        std::string name;
+        for (uint32_t i = 0; i < numberCheckpoints; i++) {
+            if (!readName(position, end, name)) {
+                return false;
+            }
+            names.checkpoints.push_back(name);
+        }
+        while (position != end) {
+            if (!readName(position, end, name)) {
+                return false;
+            }
+            names.files.push_back(name);
+        }
+
+        header = candidate;
+        return true;
+    }
+
+    // Getters & Setters
+    int numberRobots() const {
+        return header->numberRobots;
+    }
+
+    int numberRows() const {
+        return header->numberRows;
+    }
+
+    int numberColumns() const {
+        return header->numberColumns;
+    }
+
+    const int32_t *map() const {
+        return (const int32_t *) (file.data() + sizeof(TraceHeader));
+    }
+
+    uint64_t numberCommands() const {
+        return header->numberCommands;
+    }
+
+    const CommandNames &getNames() const {
+        return names;
+    }
+
+    const Command *commands() const {
+        return (const Command *) (map() + (uint64_t) header->numberRows * header->numberColumns);
+    }
+};
+
+#endif // __COMMANDTRACE_H__
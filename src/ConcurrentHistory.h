@@ -0,0 +1,104 @@
+/**
+ * Append-only log that many threads can add to at once
+ * Every element gets a global sequence number, which is also its position
+ * in the log, so the elements can be read back in one order
+ * Chunks are allocated on first use and never relocated
+ */
+
+#ifndef __CONCURRENTHISTORY_H__
+#define __CONCURRENTHISTORY_H__
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+template <typename T>
+class ConcurrentHistory {
+private:
+    static_assert(std::is_trivially_copyable<T>::value,
+            "elements are copied into raw chunks");
+
+    static const int chunkBits = 16;
+    static const long chunkSize = 1L << chunkBits;
+    static const int maxChunks = 1 << 14;
+
+    std::atomic<long> nextSequence;
+    std::atomic<T *> *chunks;
+
+    ConcurrentHistory(const ConcurrentHistory &);
+    ConcurrentHistory &operator=(const ConcurrentHistory &);
+
+    // Returns a chunk, the first thread to need it allocates it
+    T *chunkAt(long index) {
+        T *chunk = chunks[index].load(std::memory_order_acquire);
+        if (chunk != NULL) {
+            return chunk;
+        }
+
+        T *allocated = (T *) malloc(chunkSize * sizeof(T));
+        if (allocated == NULL) {
+            throw std::bad_alloc();
+        }
+        if (chunks[index].compare_exchange_strong(chunk, allocated, std::memory_order_acq_rel)) {
+            return allocated;
+        }
+
+        // Another thread was faster, chunk now holds its allocation
+        free(allocated);
+        return chunk;
+    }
+
+public:
+    // Constructor
+    ConcurrentHistory() : nextSequence(0) {
+        chunks = new std::atomic<T *>[maxChunks];
+        for (int i = 0; i < maxChunks; i++) {
+            chunks[i].store(NULL, std::memory_order_relaxed);
+        }
+    }
+
+    // Destructor
+    ~ConcurrentHistory() {
+        for (int i = 0; i < maxChunks; i++) {
+            free(chunks[i].load(std::memory_order_relaxed));
+        }
+        delete[] chunks;
+    }
+
+    /**
+     * Adds an element, safe to call from many threads at once.
+     *
+     * @return The sequence number of the element.
+     */
+    long append(const T &element) {
+        long sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+        if (sequence >= (long) maxChunks * chunkSize) {
+            throw std::length_error("the concurrent history is full");
+        }
+
+        chunkAt(sequence >> chunkBits)[sequence & (chunkSize - 1)] = element;
+        return sequence;
+    }
+
+    /**
+     * The element with the given sequence number
+     * Only valid once the threads that appended it are done
+     */
+    const T &get(long sequence) const {
+        return chunks[sequence >> chunkBits].load(std::memory_order_acquire)[sequence & (chunkSize - 1)];
+    }
+
+    // Number of elements appended, exact only when no append is running
+    long size() const {
+        return nextSequence.load(std::memory_order_acquire);
+    }
+
+    // Empties the log, keeping the chunks for reuse
+    void clear() {
+        nextSequence.store(0, std::memory_order_release);
+    }
+};
+
+#endif // __CONCURRENTHISTORY_H__
@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <iostream>
+#include <memory>
 
 template <typename T>
 struct Node {
@@ -23,12 +24,30 @@ struct Node {
     }
 };
 
-template <typename T>
+/**
+ * Nodes are obtained from Allocator, which can be a PoolAllocator
+ * to recycle them instead of calling new and delete for every element
+ */
+template <typename T, typename Allocator = std::allocator<Node<T>>>
 class DoublyLinkedList {
 private:
+    typedef std::allocator_traits<Allocator> AllocatorTraits;
+
     Node<T> *head;
     Node<T> *tail;
     int numElements;
+    Allocator allocator;
+
+    Node<T> *createNode(const T &data) {
+        Node<T> *node = AllocatorTraits::allocate(allocator, 1);
+        AllocatorTraits::construct(allocator, node, data);
+        return node;
+    }
+
+    void destroyNode(Node<T> *node) {
+        AllocatorTraits::destroy(allocator, node);
+        AllocatorTraits::deallocate(allocator, node, 1);
+    }
 
 public:
     /**
@@ -55,8 +74,11 @@ public:
     // Another constructor
     DoublyLinkedList(Node<T> *head) {
         this->head = head;
+        this->tail = head;
+        numElements = 0;
         while (head != nullptr) {
             numElements++;
+            tail = head;
             head = head->next;
         }
     }
@@ -66,7 +88,7 @@ public:
         Node<T> *temp = head;
         while(temp != nullptr) {
             Node<T> *nextNode = temp->next;
-            delete temp;
+            destroyNode(temp);
             temp = nextNode;
         }
 
@@ -82,7 +104,7 @@ public:
      * @param data Data to be added at the end of the list.
      */
     void addLast(T data) {
-        Node<T> *newNode = new Node<T>(data);
+        Node<T> *newNode = createNode(data);
 
         if (isEmpty()) {
 
@@ -106,7 +128,7 @@ public:
      * @param data Data to be added at the beginning of the list.
      */
     void addFirst(T data) {
-        Node<T> *newNode = new Node<T>(data);
+        Node<T> *newNode = createNode(data);
 
         if (isEmpty()) {
 
@@ -145,12 +167,14 @@ public:
                 temp = tail->prev;
                 temp->next = nullptr;
                 tail->prev = nullptr;
-                delete tail;
+                destroyNode(tail);
                 tail = temp;
 
             } else {
 
-                delete tail;
+                destroyNode(tail);
+                head = nullptr;
+                tail = nullptr;
 
             }
 
@@ -185,12 +209,14 @@ public:
                 temp = head->next;
                 head->next = nullptr;
                 temp->prev = nullptr;
-                delete head;
+                destroyNode(head);
                 head = temp;
 
             } else {
 
-                delete head;
+                destroyNode(head);
+                head = nullptr;
+                tail = nullptr;
 
             }
 
@@ -220,6 +246,21 @@ public:
         return numElements;
     }
 
+    /**
+     * Returns the data of the pos'th node in the list.
+     */
+    T &get(int pos) {
+        return goToPos(pos)->data;
+    }
+
+    T &getFirst() {
+        return head->data;
+    }
+
+    T &getLast() {
+        return tail->data;
+    }
+
     // Getters & Setters
     Node<T> *getHead() {
         return head;
@@ -229,13 +270,13 @@ public:
         return tail;
     }
 
-    template <typename U>
+    template <typename U, typename A>
     friend std::ostream& operator<<(std::ostream& os,
-            DoublyLinkedList<U>& list);
+            DoublyLinkedList<U, A>& list);
 };
 
-template <typename T>
-std::ostream& operator<<(std::ostream& os, DoublyLinkedList<T>& list) {
+template <typename T, typename Allocator>
+std::ostream& operator<<(std::ostream& os, DoublyLinkedList<T, Allocator>& list) {
     Node<T> *it = list.getHead();
 
     if (list.size() > 0) {
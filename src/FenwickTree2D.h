@@ -0,0 +1,114 @@
+/**
+ * Two-dimensional Fenwick tree (binary indexed tree) over a grid of ints
+ * A cell can be changed and the sum of any rectangle read in
+ * O(log rows * log columns); the tree is built from a whole grid in
+ * one linear pass
+ */
+
+#ifndef __FENWICKTREE2D_H__
+#define __FENWICKTREE2D_H__
+
+#include <cstddef>
+#include <vector>
+
+class FenwickTree2D {
+private:
+    int numberRows;
+    int numberColumns;
+    /**
+        Node (i, j), 1-based, holds the sum of the cells in rows
+        (i - lowbit(i), i] and columns (j - lowbit(j), j]
+    */
+    std::vector<long long> tree;
+
+    long long &node(int i, int j) {
+        return tree[(size_t) i * (numberColumns + 1) + j];
+    }
+
+    // Sum of the cells in rows [0, x) and columns [0, y)
+    long long prefixSum(int x, int y) {
+        long long sum = 0;
+        for (int i = x; i > 0; i -= i & -i) {
+            for (int j = y; j > 0; j -= j & -j) {
+                sum += node(i, j);
+            }
+        }
+        return sum;
+    }
+
+public:
+    // Constructor
+    FenwickTree2D() : numberRows(0), numberColumns(0) {}
+
+    /**
+     * Builds the tree from a grid stored row by row.
+     *
+     * @param rowStride Distance between the starts of two rows of values.
+     */
+    void build(const int *values, int numberRows, int numberColumns, size_t rowStride) {
+        this->numberRows = numberRows;
+        this->numberColumns = numberColumns;
+        tree.assign((size_t) (numberRows + 1) * (numberColumns + 1), 0);
+
+        for (int i = 1; i <= numberRows; i++) {
+            const int *row = values + (size_t) (i - 1) * rowStride;
+            for (int j = 1; j <= numberColumns; j++) {
+                node(i, j) = row[j - 1];
+            }
+        }
+
+        // Every node passes its sum to its parent, first along the rows, then along the columns
+        for (int i = 1; i <= numberRows; i++) {
+            for (int j = 1; j <= numberColumns; j++) {
+                int parent = j + (j & -j);
+                if (parent <= numberColumns) {
+                    node(i, parent) += node(i, j);
+                }
+            }
+        }
+        for (int i = 1; i <= numberRows; i++) {
+            int parent = i + (i & -i);
+            if (parent <= numberRows) {
+                for (int j = 1; j <= numberColumns; j++) {
+                    node(parent, j) += node(i, j);
+                }
+            }
+        }
+    }
+
+    /**
+     * Adds delta to the cell (x, y).
+     */
+    void add(int x, int y, long long delta) {
+        for (int i = x + 1; i <= numberRows; i += i & -i) {
+            for (int j = y + 1; j <= numberColumns; j += j & -j) {
+                node(i, j) += delta;
+            }
+        }
+    }
+
+    /**
+     * Same as add(), safe while other threads add to other cells.
+     */
+    void addShared(int x, int y, long long delta) {
+        for (int i = x + 1; i <= numberRows; i += i & -i) {
+            for (int j = y + 1; j <= numberColumns; j += j & -j) {
+                __atomic_fetch_add(&node(i, j), delta, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    /**
+     * Returns the sum of the cells in rows [x1, x2] and columns [y1, y2].
+     */
+    long long regionSum(int x1, int y1, int x2, int y2) {
+        return prefixSum(x2 + 1, y2 + 1) - prefixSum(x1, y2 + 1)
+                - prefixSum(x2 + 1, y1) + prefixSum(x1, y1);
+    }
+
+    size_t memoryUsage() const {
+        return tree.capacity() * sizeof(long long);
+    }
+};
+
+#endif // __FENWICKTREE2D_H__
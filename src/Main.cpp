@@ -1,94 +1,290 @@
-#include <fstream>
-#include <iostream>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <string>
-
-#include "Warehouse.h"
-
-int main () {
-    int numberRobots;
-    int numberRows;
-    int numberColumns;
-    int value;                  // store the values for every cell of map
-    char commandString[30];     // store the string of command
-    int robotID;
-    int x;
-    int y;
-    int numberBoxes;
-    int priority;
-    char outputFunction[30];
-
-    FILE* inputFile = fopen("robots.in", "r");
-    if (inputFile == NULL) {
-        printf("The input file could not be opened.\n");
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Batch.h"
+#include "CommandParser.h"
+#include "CommandTrace.h"
+#include "Scenario.h"
+#include "Server.h"
+#include "Stream.h"
+
+int main (int argc, char *argv[]) {
+    const char *compilePath = NULL;
+    const char *replayPath = NULL;
+    const char *batchPath = NULL;
+    const char *statsPath = NULL;
+    const char *streamPath = NULL;
+    const char *socketPath = NULL;
+    bool reportThroughput = false;
+    BatchSettings batch;
+    ScenarioSettings &settings = batch.scenario;
+    StreamSettings stream;
+    ServerSettings server;
+
+    batch.numberWorkers = (int) std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--throughput") == 0) {
+            reportThroughput = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            settings.numberThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--history-chunks") == 0 && i + 1 < argc) {
+            settings.warehouse.historyResidentChunks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--spill-dir") == 0 && i + 1 < argc) {
+            settings.warehouse.historySpillDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--time-per-command") == 0 && i + 1 < argc) {
+            settings.warehouse.timeModel.timePerCommand = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--time-per-box") == 0 && i + 1 < argc) {
+            settings.warehouse.timeModel.timePerBox = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--time-per-cell") == 0 && i + 1 < argc) {
+            settings.warehouse.timeModel.timePerCell = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--region-index") == 0) {
+            settings.warehouse.regionIndex = true;
+        } else if (strcmp(argv[i], "--priority-levels") == 0 && i + 1 < argc) {
+            settings.warehouse.priorityLevels = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--path-planning") == 0) {
+            settings.warehouse.pathPlanning = true;
+        } else if (strcmp(argv[i], "--path-cache") == 0 && i + 1 < argc) {
+            settings.warehouse.pathCacheFields = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            const char *layout = argv[++i];
+            if (strcmp(layout, "auto") == 0) {
+                settings.warehouse.mapLayout = MAP_AUTO;
+            } else if (strcmp(layout, "dense") == 0) {
+                settings.warehouse.mapLayout = MAP_DENSE;
+            } else if (strcmp(layout, "tiled") == 0) {
+                settings.warehouse.mapLayout = MAP_TILED;
+            } else {
+                printf("The map layout must be auto, dense or tiled.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--queue-weight") == 0 && i + 1 < argc) {
+            settings.warehouse.queueWeight = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            statsPath = argv[++i];
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            settings.restorePath = argv[++i];
+        } else if (strcmp(argv[i], "--trust-snapshot") == 0) {
+            settings.verifySnapshot = false;
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            settings.logPath = argv[++i];
+        } else if (strcmp(argv[i], "--log-group") == 0 && i + 1 < argc) {
+            settings.logGroupSize = (size_t) atol(argv[++i]);
+        } else if (strcmp(argv[i], "--log-window") == 0 && i + 1 < argc) {
+            settings.logWindowMilliseconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--recover") == 0) {
+            settings.recoverLog = true;
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            streamPath = argv[++i];
+        } else if (strcmp(argv[i], "--flush-commands") == 0 && i + 1 < argc) {
+            stream.flushCommands = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--flush-ms") == 0 && i + 1 < argc) {
+            stream.flushMilliseconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stream-buffer") == 0 && i + 1 < argc) {
+            stream.bufferSize = (size_t) atol(argv[++i]) << 10;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--max-connections") == 0 && i + 1 < argc) {
+            server.maxConnections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-request") == 0 && i + 1 < argc) {
+            server.maxRequestSize = (size_t) atol(argv[++i]) << 10;
+        } else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) {
+            compilePath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            batch.numberWorkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc) {
+            batch.outputDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+            settings.memoryLimit = (size_t) atol(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) {
+            batch.memoryBudget = (size_t) atol(argv[++i]) << 20;
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (settings.warehouse.priorityLevels < 0
+            || settings.warehouse.priorityLevels > BucketQueue<QueuedCommand>::maxLevels) {
+        printf("The number of priority levels must be between 0 and %d.\n",
+                BucketQueue<QueuedCommand>::maxLevels);
         return 1;
     }
 
-    FILE* outputFile = fopen("robots.out", "w");
-    if (outputFile == NULL) {
-        printf("The output file could not be opened.\n");
+    if (settings.warehouse.queueWeight < 0) {
+        printf("The queue weight can not be negative.\n");
         return 1;
     }
 
-    // Read the first three elements from file: N ROW COL
-    fscanf(inputFile, "%d %d %d", &numberRobots, &numberRows, &numberColumns);
+    if (settings.restorePath != NULL && (batchPath != NULL || compilePath != NULL || replayPath != NULL)) {
+        printf("A snapshot can only be restored for robots.in.\n");
+        return 1;
+    }
 
-    // Warehouse initialization with given data from the file 
-    Warehouse warehouse = Warehouse(numberRobots, numberRows, numberColumns);
+    if (settings.logPath != NULL && (batchPath != NULL || compilePath != NULL || replayPath != NULL)) {
+        printf("Only the commands of robots.in can be logged.\n");
+        return 1;
+    }
 
-    // Read all the values for the map
-    for (int i = 0; i < numberRows; i++) {
-        for (int j = 0; j < numberColumns; j++) {
-            fscanf(inputFile, "%d", &value);
-            warehouse.SetMapValue(i, j, value);
-        }
+    if (settings.recoverLog && settings.logPath == NULL) {
+        printf("Recovery needs the command log, given with --log.\n");
+        return 1;
     }
 
-    // Read the rest of the file - the commands and parameters
-    while (fscanf(inputFile, "%s", commandString) != EOF) {
+    // A logged run reads its map from robots.in, so recovering it can always start from there
+    if (settings.logPath != NULL && settings.restorePath != NULL && !settings.recoverLog) {
+        printf("A logged run can only start from a snapshot when recovering.\n");
+        return 1;
+    }
 
-        if (strcmp(commandString, "ADD_GET_BOX") == 0) {
-            fscanf(inputFile, "%d %d %d %d %d", &robotID, &x, &y, &numberBoxes, &priority);
-            warehouse.AddGetBox(robotID, x, y, numberBoxes, priority);
+    if (settings.logGroupSize < 1 || settings.logWindowMilliseconds < 0) {
+        printf("The log group must hold at least one command and its window can not be negative.\n");
+        return 1;
+    }
 
-        } else if (strcmp(commandString, "ADD_DROP_BOX") == 0) {
-            fscanf(inputFile, "%d %d %d %d %d", &robotID, &x, &y, &numberBoxes, &priority);
-            warehouse.AddDropBox(robotID, x, y, numberBoxes, priority);
+    if (streamPath != NULL && (batchPath != NULL || compilePath != NULL || replayPath != NULL
+            || settings.recoverLog)) {
+        printf("A stream can not be combined with --batch, --compile, --replay or --recover.\n");
+        return 1;
+    }
 
-        } else if (strcmp(commandString, "EXECUTE") == 0) {
-            fscanf(inputFile, "%d", &robotID);
-            strcpy(outputFunction, warehouse.Execute(robotID).c_str());
-            if (strcmp(outputFunction, "Executed") != 0) {
-                fprintf(outputFile, "%s\n", outputFunction);
-            }
+    if (stream.flushCommands < 1 || stream.flushMilliseconds < 0 || stream.bufferSize == 0) {
+        printf("The stream needs a buffer and a flush every one or more commands.\n");
+        return 1;
+    }
+
+    if (socketPath != NULL && (batchPath != NULL || compilePath != NULL || replayPath != NULL
+            || streamPath != NULL || settings.logPath != NULL || settings.numberThreads > 1)) {
+        printf("A server can not be combined with --batch, --compile, --replay, --stream, --log or --threads.\n");
+        return 1;
+    }
 
-        } else if (strcmp(commandString, "PRINT_COMMANDS") == 0) {
-            fscanf(inputFile, "%d", &robotID);
-            warehouse.PrintCommands(robotID);
+    if (server.maxConnections < 1 || server.maxRequestSize == 0 || server.maxRequestSize > UINT32_MAX) {
+        printf("The server needs room for one connection and a request of 1 KB to 4 GB.\n");
+        return 1;
+    }
 
-        } else if (strcmp(commandString, "LAST_EXECUTED_COMMAND") == 0) {
-            warehouse.LastExecutedCommand();
+#ifndef WAREHOUSE_STATS
+    if (statsPath != NULL) {
+        printf("The statistics are not compiled in, build with make STATS=1.\n");
+        return 1;
+    }
+#endif
 
-        } else if (strcmp(commandString, "UNDO") == 0) {
-            strcpy(outputFunction, warehouse.Undo().c_str());
-            if (strcmp(outputFunction, "Executed") != 0) {
-                fprintf(outputFile, "%s\n", outputFunction);
-            }
+    // Run every scenario of a manifest or a directory
+    if (batchPath != NULL) {
+        std::vector<BatchJob> jobs;
+        if (!LoadBatchJobs(batchPath, batch.outputDirectory, jobs)) {
+            printf("The batch could not be read.\n");
+            return 1;
+        }
+        settings.format = INPUT_AUTO;
+        return RunBatch(jobs, batch, stdout) == 0 ? 0 : 1;
+    }
 
-        } else if (strcmp(commandString, "HOW_MUCH_TIME") == 0) {
+    // Only convert robots.in to a binary trace, without running it
+    if (compilePath != NULL) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        MappedFile inputFile;
+        if (!inputFile.open("robots.in")) {
+            printf("The input file could not be opened.\n");
+            return 1;
+        }
 
-        } else if (strcmp(commandString, "HOW_MANY_BOXES") == 0) {
-            fscanf(inputFile, "%d", &robotID);
-            strcpy(outputFunction, warehouse.HowManyBoxes(robotID).c_str());
-            fprintf(outputFile, "%s\n", outputFunction);
+        long long numberCommands = CompileTrace(inputFile, compilePath);
+        if (numberCommands < 0) {
+            printf("The trace file could not be written.\n");
+            return 1;
+        }
+        if (reportThroughput) {
+            double seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+            fprintf(stderr, "%lld commands compiled in %.3f s\n", numberCommands, seconds);
+        }
+        return 0;
+    }
 
-        } else {
-            fprintf(outputFile, "The command is incorrect\n");
+    settings.format = replayPath != NULL ? INPUT_TRACE : INPUT_TEXT;
+    settings.countLines = reportThroughput;
+
+    ScenarioResult result;
+    LatencyHistogram latencies;
+    ScenarioStatus status;
+    ServerStats serverStats;
+    if (socketPath != NULL) {
+        // One warehouse answering the clients of the socket until SIGINT or SIGTERM
+        status = RunServer("robots.in", socketPath, settings, server, result, serverStats);
+    } else if (streamPath != NULL) {
+        // Commands from stdin or a FIFO, results to stdout as they come
+        int inputFd = strcmp(streamPath, "-") == 0 ? 0 : open(streamPath, O_RDONLY);
+        if (inputFd < 0) {
+            printf("%s\n", ScenarioStatusMessage(SCENARIO_NO_INPUT));
+            return 1;
+        }
+        status = RunStream(inputFd, stdout, settings, stream, result, latencies);
+        if (inputFd != 0) {
+            close(inputFd);
         }
+    } else {
+        status = RunScenario(replayPath != NULL ? replayPath : "robots.in", "robots.out", settings, result);
+    }
+    if (status != SCENARIO_DONE) {
+        printf("%s\n", ScenarioStatusMessage(status));
+        return 1;
+    }
+
+    if (settings.warehouse.regionIndex) {
+        fprintf(stderr, "Region index: %zu bytes (%zu bytes in total)\n",
+                result.regionIndexMemory, result.peakMemory);
     }
 
-    fclose(inputFile);
-    fclose(outputFile);
+    if (settings.warehouse.pathPlanning) {
+        fprintf(stderr, "Path planning: %d obstacles, %lld plans from distance fields, %lld A* searches\n",
+                result.numberObstacles, result.pathHits, result.pathSearches);
+    }
+
+#ifdef WAREHOUSE_STATS
+    // The statistics go to stderr unless a file was given
+    FILE *statsFile = statsPath != NULL ? fopen(statsPath, "w") : stderr;
+    if (statsFile == NULL) {
+        printf("The statistics file could not be opened.\n");
+        return 1;
+    }
+    result.stats.writeJson(statsFile);
+    if (statsFile != stderr) {
+        fclose(statsFile);
+    }
+#endif
+
+    if (reportThroughput) {
+        double seconds = result.seconds;
+        if (socketPath != NULL) {
+            fprintf(stderr, "%lld commands in %lld requests (%lld rejected) from %lld connections in %.3f s\n",
+                    result.numberCommands, serverStats.numberRequests, serverStats.rejectedRequests,
+                    serverStats.numberConnections, seconds);
+        } else if (streamPath != NULL) {
+            fprintf(stderr, "%lld commands in %.3f s (%.0f commands/sec), command to output latency "
+                    "p50 %.1f us, p99 %.1f us, max %.1f us\n",
+                    result.numberCommands, seconds, seconds > 0 ? result.numberCommands / seconds : 0.0,
+                    latencies.percentile(0.5) / 1e3, latencies.percentile(0.99) / 1e3,
+                    latencies.getMaximum() / 1e3);
+        } else if (replayPath != NULL) {
+            fprintf(stderr, "%lld commands in %.3f s (%.0f commands/sec)\n",
+                    result.numberCommands, seconds,
+                    seconds > 0 ? result.numberCommands / seconds : 0.0);
+        } else {
+            fprintf(stderr, "%ld lines in %.3f s (%.0f lines/sec)\n",
+                    result.numberLines, seconds, seconds > 0 ? result.numberLines / seconds : 0.0);
+        }
+    }
 
     return 0;
-}
\ No newline at end of file
+}
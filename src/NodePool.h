@@ -0,0 +1,165 @@
+/**
+ * Slab allocator for list nodes
+ * Nodes are carved out of large slabs and recycled through a free list,
+ * so adding and removing elements does not go through malloc
+ * One pool per node type is shared by every list that uses it
+ */
+
+#ifndef __NODEPOOL_H__
+#define __NODEPOOL_H__
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+struct NodePoolStats {
+    size_t liveNodes;       // nodes currently handed out
+    size_t peakLiveNodes;   // the maximum number of live nodes so far
+    size_t capacity;        // nodes in all the slabs
+    size_t slabs;           // number of times the pool had to grow
+};
+
+/**
+ * The pool is not thread safe, it must be used from a single thread.
+ */
+template <typename T>
+class NodePool {
+private:
+    static const size_t firstSlabSize = 64;
+    static const size_t maxSlabSize = 1 << 16;
+
+    union Slot {
+        Slot *next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    Slot *freeList;
+    std::vector<Slot *> slabs;
+    size_t nextSlabSize;
+    NodePoolStats statistics;
+
+    NodePool() : freeList(nullptr), nextSlabSize(firstSlabSize) {
+        statistics.liveNodes = 0;
+        statistics.peakLiveNodes = 0;
+        statistics.capacity = 0;
+        statistics.slabs = 0;
+    }
+
+    NodePool(const NodePool &);
+    NodePool &operator=(const NodePool &);
+
+    /**
+     * Allocates a new slab, twice as large as the previous one,
+     * and chains all its slots into the free list.
+     */
+    void grow() {
+        Slot *slab = static_cast<Slot *>(::operator new(nextSlabSize * sizeof(Slot)));
+        slabs.push_back(slab);
+
+        for (size_t i = 0; i < nextSlabSize; i++) {
+            slab[i].next = (i + 1 < nextSlabSize) ? &slab[i + 1] : freeList;
+        }
+        freeList = slab;
+
+        statistics.capacity += nextSlabSize;
+        statistics.slabs++;
+        if (nextSlabSize < maxSlabSize) {
+            nextSlabSize *= 2;
+        }
+    }
+
+public:
+    // Destructor
+    ~NodePool() {
+        for (size_t i = 0; i < slabs.size(); i++) {
+            ::operator delete(slabs[i]);
+        }
+    }
+
+    // The pool shared by all the lists with nodes of type T
+    static NodePool &instance() {
+        static NodePool pool;
+        return pool;
+    }
+
+    /**
+     * Returns uninitialized memory for one node.
+     */
+    T *allocate() {
+        if (freeList == nullptr) {
+            grow();
+        }
+
+        Slot *slot = freeList;
+        freeList = slot->next;
+
+        statistics.liveNodes++;
+        if (statistics.liveNodes > statistics.peakLiveNodes) {
+            statistics.peakLiveNodes = statistics.liveNodes;
+        }
+        return reinterpret_cast<T *>(slot);
+    }
+
+    /**
+     * Gives the memory of a destroyed node back to the pool.
+     */
+    void deallocate(T *node) {
+        Slot *slot = reinterpret_cast<Slot *>(node);
+        slot->next = freeList;
+        freeList = slot;
+        statistics.liveNodes--;
+    }
+
+    const NodePoolStats &stats() const {
+        return statistics;
+    }
+};
+
+/**
+ * Standard allocator interface over the shared NodePool
+ * Single element requests come from the pool, anything else from
+ * the global operator new
+ */
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    PoolAllocator() {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        if (n == 1) {
+            return NodePool<T>::instance().allocate();
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n) {
+        if (n == 1) {
+            NodePool<T>::instance().deallocate(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    // Statistics of the pool behind this allocator
+    static const NodePoolStats &stats() {
+        return NodePool<T>::instance().stats();
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return false;
+}
+
+#endif // __NODEPOOL_H__
@@ -0,0 +1,197 @@
+/**
+ * Buffered writer for the results of the commands
+ * Results are formatted straight into one large reusable buffer,
+ * which is written to the file in big blocks
+ */
+
+#ifndef __OUTPUTBUFFER_H__
+#define __OUTPUTBUFFER_H__
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+
+class OutputBuffer {
+private:
+    static const size_t defaultCapacity = 1 << 16;
+
+    FILE *file;             // NULL if the output is discarded
+    char *buffer;
+    size_t capacity;
+    size_t used;
+    bool retained;          // grows instead of flushing, see retain()
+
+    OutputBuffer(const OutputBuffer &);
+    OutputBuffer &operator=(const OutputBuffer &);
+
+    // Makes room for at least count more characters
+    void reserve(size_t count) {
+        if (used + count > capacity && retained) {
+            size_t grownCapacity = capacity * 2 > used + count ? capacity * 2 : used + count;
+            char *grown = (char *) realloc(buffer, grownCapacity);
+            if (grown == NULL) {
+                throw std::bad_alloc();
+            }
+            buffer = grown;
+            capacity = grownCapacity;
+        } else if (used + count > capacity) {
+            flush();
+            if (count > capacity) {
+                char *grown = (char *) realloc(buffer, count);
+                if (grown == NULL) {
+                    throw std::bad_alloc();
+                }
+                buffer = grown;
+                capacity = count;
+            }
+        }
+    }
+
+public:
+    // Constructor
+    explicit OutputBuffer(FILE *file, size_t capacity = defaultCapacity)
+            : file(file), capacity(capacity), used(0), retained(false) {
+        buffer = (char *) malloc(capacity);
+        if (buffer == NULL) {
+            throw std::bad_alloc();
+        }
+    }
+
+    // Destructor
+    ~OutputBuffer() {
+        flush();
+        free(buffer);
+    }
+
+    /**
+     * Writes the buffered characters to the file.
+     *
+     * @return False if the file could not be written, True otherwise.
+     */
+    bool flush() {
+        bool written = true;
+        if (file != NULL && used > 0) {
+            written = fwrite(buffer, 1, used, file) == used;
+        }
+        used = 0;
+        return written;
+    }
+
+    /**
+     * Writes the buffered characters and syncs the file to disk.
+     *
+     * @return The length of the file then, -1 if it could not be synced
+     * or has no length (no file, a pipe).
+     */
+    long long sync() {
+        if (file == NULL || !flush() || fflush(file) != 0 || fdatasync(fileno(file)) != 0) {
+            return -1;
+        }
+        return (long long) ftello(file);
+    }
+
+    /**
+     * Keeps everything written in memory until clear() is called,
+     * instead of discarding it; only for buffers without a file.
+     */
+    void retain() {
+        retained = file == NULL;
+    }
+
+    // The characters written since the last flush() or clear()
+    const char *data() const {
+        return buffer;
+    }
+
+    size_t size() const {
+        return used;
+    }
+
+    void clear() {
+        used = 0;
+    }
+
+    void write(const char *text, size_t length) {
+        reserve(length);
+        memcpy(buffer + used, text, length);
+        used += length;
+    }
+
+    void write(const char *text) {
+        write(text, strlen(text));
+    }
+
+    void writeChar(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    /**
+     * Writes a number in decimal, two digits at a time.
+     */
+    void writeInt(long long value) {
+        static const char digitPairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *start = end;
+
+        unsigned long long number = value < 0 ? 0ull - (unsigned long long) value : value;
+        while (number >= 100) {
+            unsigned int pair = (unsigned int) (number % 100) * 2;
+            number /= 100;
+            *--start = digitPairs[pair + 1];
+            *--start = digitPairs[pair];
+        }
+        if (number >= 10) {
+            unsigned int pair = (unsigned int) number * 2;
+            *--start = digitPairs[pair + 1];
+            *--start = digitPairs[pair];
+        } else {
+            *--start = (char) ('0' + number);
+        }
+        if (value < 0) {
+            *--start = '-';
+        }
+
+        write(start, end - start);
+    }
+
+    void writeLine(const char *text) {
+        write(text);
+        writeChar('\n');
+    }
+
+    /**
+     * Writes the same line count times: the line is formatted once, then
+     * copied over the free part of the buffer in doubling blocks.
+     */
+    void writeLines(const char *text, long count) {
+        size_t length = strlen(text) + 1;
+        while (count > 0) {
+            reserve(length);
+            size_t copies = (capacity - used) / length;
+            if ((long) copies > count) {
+                copies = count;
+            }
+
+            char *start = buffer + used;
+            memcpy(start, text, length - 1);
+            start[length - 1] = '\n';
+            size_t written = length;
+            while (written < copies * length) {
+                size_t block = written < copies * length - written ? written : copies * length - written;
+                memcpy(start + written, start, block);
+                written += block;
+            }
+            used += written;
+            count -= copies;
+        }
+    }
+};
+
+#endif // __OUTPUTBUFFER_H__
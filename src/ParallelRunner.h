@@ -0,0 +1,344 @@
+/**
+ * Parallel execution of a command stream
+ *
+ * The stream is cut into epochs at the commands that use the global
+ * history (UNDO, LAST_EXECUTED_COMMAND, CHECKPOINT, ROLLBACK_TO), read
+ * the whole map (QUERY_REGION), fill all the queues (ASSIGN_BATCH) or
+ * report on or save the whole state (STATS, SNAPSHOT), which run alone. Inside an epoch the robots are grouped so that two robots
+ * working on the same cell are in the same group; every group runs in
+ * the original order on one worker, and the groups run concurrently.
+ * The results and the executed commands are then put back in the order
+ * of the stream, so robots.out and the history are the same as for a
+ * sequential run.
+ */
+
+#ifndef __PARALLELRUNNER_H__
+#define __PARALLELRUNNER_H__
+
+#include <algorithm>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "CommandParser.h"
+#include "CommandRunner.h"
+#include "OutputBuffer.h"
+#include "Warehouse.h"
+#include "WorkerPool.h"
+
+// Longest epoch, in commands; bounds the memory for the results
+const int PARALLEL_MAX_EPOCH = 1 << 16;
+
+// Shorter epochs are not worth handing out to the workers
+const int PARALLEL_MIN_EPOCH = 1024;
+
+class ParallelRunner {
+private:
+    // What a worker did for a command, at the position of the command in the epoch
+    struct CommandResult {
+        HistoryRecord executed;
+        bool hasExecuted;       // executed has to be added to the history
+        int worker;
+        size_t offset;          // of the written result, in the worker's buffer
+        size_t length;          // 0 if nothing was written
+    };
+
+    Warehouse &warehouse;
+    const CommandNames &names;
+    WorkerPool pool;
+    std::vector<std::unique_ptr<OutputBuffer> > workerOutput;
+    std::vector<std::unique_ptr<OutputBuffer> > workerDiscarded;
+
+    /**
+        Union-find over the robots, only valid for the robots whose
+        robotEpoch is the current epoch
+    */
+    unsigned int epoch;
+    std::vector<unsigned int> robotEpoch;
+    std::vector<int> parent;
+    std::vector<int> robotGroup;
+    std::vector<int> touchedRobots;
+    std::unordered_map<uint64_t, int> cellOwner;    // a robot working on the cell
+
+    // The positions of the commands of every group, group after group
+    std::vector<int> groupStart;
+    std::vector<int> groupCommands;
+    std::vector<int> groupFill;                     // next free position of every group
+    std::vector<int> groupOrder;                    // largest group first
+    std::vector<int> commandGroup;                  // -1 for commands of no robot
+    std::vector<CommandResult> results;
+
+    long long parallelCommands;
+
+    ParallelRunner(const ParallelRunner &);
+    ParallelRunner &operator=(const ParallelRunner &);
+
+    // The commands that only touch one robot and the cells it works on
+    static bool IsLocal(int opcode) {
+        return opcode != OP_UNDO && opcode != OP_LAST_EXECUTED_COMMAND
+                && opcode != OP_CHECKPOINT && opcode != OP_ROLLBACK_TO
+                && opcode != OP_QUERY_REGION && opcode != OP_ASSIGN_BATCH
+                && opcode != OP_STATS && opcode != OP_SNAPSHOT;
+    }
+
+    static bool HasRobot(const Command &command) {
+        switch (command.opcode) {
+        case OP_ADD_GET_BOX:
+        case OP_ADD_DROP_BOX:
+            return command.robotID >= 0;    // the others go to the pool, in the order of the stream
+        case OP_EXECUTE:
+        case OP_PRINT_COMMANDS:
+        case OP_HOW_MANY_BOXES:
+            return true;
+        case OP_HOW_MUCH_TIME:
+            return command.argument == 1;
+        default:
+            return false;
+        }
+    }
+
+    int find(int robot) {
+        while (parent[robot] != robot) {
+            parent[robot] = parent[parent[robot]];
+            robot = parent[robot];
+        }
+        return robot;
+    }
+
+    void joinCell(int robotID, int x, int y) {
+        uint64_t key = (uint64_t) x * warehouse.GetNumberColumns() + (uint64_t) y;
+        std::pair<std::unordered_map<uint64_t, int>::iterator, bool> inserted =
+                cellOwner.insert(std::make_pair(key, robotID));
+        if (!inserted.second) {
+            parent[find(robotID)] = find(inserted.first->second);
+        }
+    }
+
+    // The first time a robot shows up in the epoch it joins the cell it is about to execute on
+    void touchRobot(int robotID) {
+        if (robotEpoch[robotID] == epoch) {
+            return;
+        }
+        robotEpoch[robotID] = epoch;
+        parent[robotID] = robotID;
+        touchedRobots.push_back(robotID);
+
+        int x, y;
+        if (warehouse.NextCommandCell(robotID, x, y)) {
+            joinCell(robotID, x, y);
+        }
+    }
+
+    /**
+        Splits the epoch into groups of robots that share no cell
+
+        @return The number of groups
+    */
+    int partition(const Command *commands, int numberCommands) {
+        epoch++;
+        touchedRobots.clear();
+        cellOwner.clear();
+
+        for (int i = 0; i < numberCommands; i++) {
+            const Command &command = commands[i];
+            if (!HasRobot(command)) {
+                continue;
+            }
+
+            touchRobot(command.robotID);
+            if (command.opcode == OP_ADD_GET_BOX || command.opcode == OP_ADD_DROP_BOX) {
+                joinCell(command.robotID, command.x, command.y);
+            }
+        }
+
+        // Number the groups by their root robot
+        int numberGroups = 0;
+        for (size_t i = 0; i < touchedRobots.size(); i++) {
+            int root = find(touchedRobots[i]);
+            if (root == touchedRobots[i]) {
+                robotGroup[root] = numberGroups++;
+            }
+        }
+
+        // Counting sort of the commands by group, keeping their order
+        groupStart.assign(numberGroups + 1, 0);
+        commandGroup.resize(numberCommands);
+        for (int i = 0; i < numberCommands; i++) {
+            if (HasRobot(commands[i])) {
+                commandGroup[i] = robotGroup[find(commands[i].robotID)];
+                groupStart[commandGroup[i] + 1]++;
+            } else {
+                commandGroup[i] = -1;
+            }
+        }
+        for (int g = 0; g < numberGroups; g++) {
+            groupStart[g + 1] += groupStart[g];
+        }
+
+        groupCommands.resize(groupStart[numberGroups]);
+        groupFill.assign(groupStart.begin(), groupStart.end() - 1);
+        for (int i = 0; i < numberCommands; i++) {
+            if (commandGroup[i] >= 0) {
+                groupCommands[groupFill[commandGroup[i]]++] = i;
+            }
+        }
+
+        // The largest groups are handed out first, to balance the workers
+        groupOrder.resize(numberGroups);
+        for (int g = 0; g < numberGroups; g++) {
+            groupOrder[g] = g;
+        }
+        std::sort(groupOrder.begin(), groupOrder.end(), [this](int a, int b) {
+            int sizeA = groupStart[a + 1] - groupStart[a];
+            int sizeB = groupStart[b + 1] - groupStart[b];
+            return sizeA != sizeB ? sizeA > sizeB : a < b;
+        });
+
+        return numberGroups;
+    }
+
+    // Runs the commands of one group, in their order, on a worker
+    void runGroup(const Command *commands, int group, int worker) {
+        OutputBuffer &output = *workerOutput[worker];
+        OutputBuffer &discarded = *workerDiscarded[worker];
+
+        for (int i = groupStart[group]; i < groupStart[group + 1]; i++) {
+            const Command &command = commands[groupCommands[i]];
+            CommandResult &result = results[groupCommands[i]];
+            WarehouseStatus status;
+
+            result.hasExecuted = false;
+            result.worker = worker;
+            result.offset = output.size();
+
+            switch (command.opcode) {
+            case OP_ADD_GET_BOX:
+                warehouse.AddGetBox(command.robotID, command.x, command.y,
+                        command.numberBoxes, command.priority);
+                break;
+
+            case OP_ADD_DROP_BOX:
+                warehouse.AddDropBox(command.robotID, command.x, command.y,
+                        command.numberBoxes, command.priority);
+                break;
+
+            case OP_EXECUTE:
+                status = warehouse.ExecuteDetached(command.robotID, result.executed);
+                if (status == STATUS_EXECUTED) {
+                    result.hasExecuted = true;
+                } else {
+                    output.writeLine(StatusMessage(status));
+                }
+                break;
+
+            case OP_PRINT_COMMANDS:
+                warehouse.PrintCommands(command.robotID, discarded);
+                break;
+
+            case OP_HOW_MANY_BOXES:
+                warehouse.HowManyBoxes(command.robotID, output);
+                break;
+
+            case OP_HOW_MUCH_TIME:
+                warehouse.HowMuchTime(command.robotID, output);
+                break;
+            }
+
+            result.length = output.size() - result.offset;
+        }
+    }
+
+    void runEpoch(const Command *commands, int numberCommands, OutputBuffer &output) {
+        int numberGroups = partition(commands, numberCommands);
+        results.resize(numberCommands);
+
+        pool.run(numberGroups, [this, commands](int task, int worker) {
+            runGroup(commands, groupOrder[task], worker);
+        });
+
+        // Everything is written and recorded in the order of the stream
+        for (int i = 0; i < numberCommands; i++) {
+            if (commandGroup[i] < 0) {
+                RunCommand(warehouse, commands[i], names, output, *workerDiscarded[0]);
+                continue;
+            }
+
+            const CommandResult &result = results[i];
+#ifdef WAREHOUSE_STATS
+            warehouse.GetStats().count(commands[i].opcode);
+#endif
+            if (result.length > 0) {
+                output.write(workerOutput[result.worker]->data() + result.offset, result.length);
+            }
+            if (result.hasExecuted) {
+                warehouse.AppendHistory(result.executed);
+            }
+        }
+
+        for (int w = 0; w < pool.size(); w++) {
+            workerOutput[w]->clear();
+        }
+        parallelCommands += numberCommands;
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param names The names of the commands, see RunCommand().
+     * @param numberThreads Threads executing the commands, including the
+     * calling one.
+     */
+    ParallelRunner(Warehouse &warehouse, const CommandNames &names, int numberThreads)
+            : warehouse(warehouse), names(names), pool(numberThreads > 1 ? numberThreads : 1), epoch(0),
+              parallelCommands(0) {
+        for (int w = 0; w < pool.size(); w++) {
+            workerOutput.push_back(std::unique_ptr<OutputBuffer>(new OutputBuffer(NULL)));
+            workerOutput.back()->retain();
+            workerDiscarded.push_back(std::unique_ptr<OutputBuffer>(new OutputBuffer(NULL)));
+        }
+
+        int numberRobots = warehouse.GetNumberRobots();
+        robotEpoch.assign(numberRobots, 0);
+        parent.resize(numberRobots);
+        robotGroup.resize(numberRobots);
+    }
+
+    /**
+     * Runs the commands in order, writing their results to output exactly
+     * as RunCommand() called on each of them would.
+     */
+    void run(const Command *commands, size_t numberCommands, OutputBuffer &output) {
+        size_t i = 0;
+        while (i < numberCommands) {
+            if (!IsLocal(commands[i].opcode)) {
+                RunCommand(warehouse, commands[i], names, output, *workerDiscarded[0]);
+                i++;
+                continue;
+            }
+
+            size_t end = i;
+            while (end < numberCommands && end - i < (size_t) PARALLEL_MAX_EPOCH
+                    && IsLocal(commands[end].opcode)) {
+                end++;
+            }
+
+            if (pool.size() > 1 && end - i >= (size_t) PARALLEL_MIN_EPOCH) {
+                runEpoch(commands + i, (int) (end - i), output);
+            } else {
+                for (size_t j = i; j < end; j++) {
+                    RunCommand(warehouse, commands[j], names, output, *workerDiscarded[0]);
+                }
+            }
+            i = end;
+        }
+    }
+
+    // Number of commands that went through the workers
+    long long getParallelCommands() const {
+        return parallelCommands;
+    }
+};
+
+#endif // __PARALLELRUNNER_H__
@@ -0,0 +1,429 @@
+/**
+ * Shortest paths on the grid of the warehouse
+ * A robot moves between cells that share a side and never enters an
+ * obstacle. A distance is found with A* (Manhattan heuristic); a
+ * destination planned for again and again gets a BFS distance field, the
+ * distances of all the cells to it, kept in an LRU cache, so the next
+ * plans towards it are a single lookup
+ *
+ * A field costs a search of the whole grid, so once the cache is full a
+ * destination only takes the place of the least recently used field
+ * when it was asked for more often than that field; a destination seen
+ * for the first time never does. The counts of the destinations and of
+ * the fields are halved every PATH_AGING_PLANS plans, so a field that
+ * stopped being used is replaced in the end
+ *
+ * The grid is stored with a border of obstacles around it, so the
+ * neighbours of a cell are found without bounds checks or divisions
+ *
+ * The planner keeps a few arrays over the whole grid, about 25 bytes a
+ * cell, and 4 bytes a cell for each field, so it is limited to grids of
+ * PATH_MAX_CELLS cells, border included, and the cache keeps no more
+ * fields than fit in PATH_FIELD_MEMORY bytes
+ */
+
+#ifndef __PATHPLANNER_H__
+#define __PATHPLANNER_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Cells of the largest grid, border included, that can be planned on: 8190 x 8190
+const size_t PATH_MAX_CELLS = (size_t) 1 << 26;
+
+// Bytes the distance fields of the cache may take together; there is always room for one
+const size_t PATH_FIELD_MEMORY = (size_t) 1 << 30;
+
+// Slots of the filter that remembers destinations planned once
+const int PATH_SEEN_SLOTS = 4096;
+
+// Misses before a destination gets a field, which costs a few A* searches
+const int PATH_FIELD_MISSES = 3;
+
+// Plans between two halvings of the counts of the destinations and the fields
+const int PATH_AGING_PLANS = 8 * PATH_SEEN_SLOTS;
+
+class PathPlanner {
+private:
+    struct DistanceField {
+        std::list<size_t>::iterator recent;    // position in recentTargets
+        std::vector<int> distances;         // -1 for unreachable cells
+        int uses;                           // plans for it, the misses before it got the field included
+    };
+
+    // A destination that missed the cache, and how many times
+    struct SeenTarget {
+        size_t target;
+        int misses;
+    };
+
+    // An open cell of A*, ordered by estimate, then by the largest cost
+    struct OpenCell {
+        int estimate;
+        int cost;
+        size_t cell;
+        int x;
+        int y;
+
+        bool operator<(const OpenCell &other) const {
+            if (estimate != other.estimate) {
+                return estimate > other.estimate;
+            }
+            return cost < other.cost;
+        }
+    };
+
+    int numberRows;
+    int numberColumns;
+    size_t width;                           // numberColumns plus the border
+    std::vector<unsigned char> blocked;     // with the border
+    int numberObstacles;
+    /**
+        Connected parts of the grid, labelled on the first plan; two
+        cells with different labels can not be joined by a path
+    */
+    std::vector<int> components;
+
+    size_t maxFields;
+    std::list<size_t> recentTargets;        // most recently used first
+    std::unordered_map<size_t, DistanceField> fields;
+    std::vector<SeenTarget> seenTargets;    // direct mapped, target noCell for an empty slot
+
+    // Scratch of the searches, a cell belongs to the current A* if its stamp matches
+    std::vector<size_t> frontier;
+    std::vector<OpenCell> open;
+    std::vector<unsigned int> stamps;
+    std::vector<int> costs;
+    unsigned int currentStamp;
+
+    int agingPlans;                         // plans until the next halving of the counts
+    long long numberHits;
+    long long numberSearches;
+    long long numberFields;
+
+    std::mutex lock;
+
+    PathPlanner(const PathPlanner &);
+    PathPlanner &operator=(const PathPlanner &);
+
+    static const size_t noCell = (size_t) -1;
+
+    size_t index(int x, int y) const {
+        return (size_t) (x + 1) * width + y + 1;
+    }
+
+    /**
+        Breadth-first search from a cell, labels every cell it reaches
+        with the value of the step at which it is reached, plus base
+
+        @param queue The queue of the search, so the search only
+        writes to what it is given
+    */
+    void breadthFirst(size_t start, std::vector<int> &labels, int base, bool countSteps,
+            std::vector<size_t> &queue) const {
+        queue.clear();
+        labels[start] = base;
+        queue.push_back(start);
+
+        const ptrdiff_t moves[4] = { -(ptrdiff_t) width, (ptrdiff_t) width, -1, 1 };
+        for (size_t head = 0; head < queue.size(); head++) {
+            size_t cell = queue[head];
+            int next = countSteps ? labels[cell] + 1 : base;
+            for (int m = 0; m < 4; m++) {
+                size_t neighbour = cell + moves[m];
+                if (!blocked[neighbour] && labels[neighbour] < 0) {
+                    labels[neighbour] = next;
+                    queue.push_back(neighbour);
+                }
+            }
+        }
+    }
+
+    void labelComponents() {
+        components.assign(blocked.size(), -1);
+        int label = 0;
+        for (size_t cell = 0; cell < blocked.size(); cell++) {
+            if (!blocked[cell] && components[cell] < 0) {
+                breadthFirst(cell, components, label++, false, frontier);
+            }
+        }
+    }
+
+    // A* between two connected cells
+    int search(size_t source, int fromX, int fromY, size_t target, int toX, int toY) {
+        if (stamps.empty()) {
+            stamps.assign(blocked.size(), 0);
+            costs.assign(blocked.size(), 0);
+        }
+        if (++currentStamp == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            currentStamp = 1;
+        }
+
+        open.clear();
+        stamps[source] = currentStamp;
+        costs[source] = 0;
+        OpenCell first = { std::abs(fromX - toX) + std::abs(fromY - toY), 0, source, fromX, fromY };
+        open.push_back(first);
+
+        const ptrdiff_t moves[4] = { -(ptrdiff_t) width, (ptrdiff_t) width, -1, 1 };
+        const int movesX[4] = { -1, 1, 0, 0 };
+        const int movesY[4] = { 0, 0, -1, 1 };
+        while (!open.empty()) {
+            std::pop_heap(open.begin(), open.end());
+            OpenCell current = open.back();
+            open.pop_back();
+            if (current.cell == target) {
+                return current.cost;
+            }
+            if (current.cost > costs[current.cell]) {
+                continue;   // already reached with a smaller cost
+            }
+
+            int cost = current.cost + 1;
+            for (int m = 0; m < 4; m++) {
+                size_t neighbour = current.cell + moves[m];
+                if (blocked[neighbour]
+                        || (stamps[neighbour] == currentStamp && costs[neighbour] <= cost)) {
+                    continue;
+                }
+                stamps[neighbour] = currentStamp;
+                costs[neighbour] = cost;
+
+                OpenCell next = { 0, cost, neighbour, current.x + movesX[m], current.y + movesY[m] };
+                next.estimate = cost + std::abs(next.x - toX) + std::abs(next.y - toY);
+                open.push_back(next);
+                std::push_heap(open.begin(), open.end());
+            }
+        }
+        return -1;
+    }
+
+    // The cached field of a target, NULL if there is none
+    DistanceField *findField(size_t target) {
+        std::unordered_map<size_t, DistanceField>::iterator found = fields.find(target);
+        if (found == fields.end()) {
+            return NULL;
+        }
+        recentTargets.splice(recentTargets.begin(), recentTargets, found->second.recent);
+        found->second.uses++;
+        return &found->second;
+    }
+
+    /**
+        Decides if a destination that missed the cache gets a field
+
+        @param misses The misses of the destination so far
+    */
+    bool admitField(int misses) {
+        if (misses < PATH_FIELD_MISSES) {
+            return false;
+        }
+        if (fields.size() < maxFields) {
+            return true;
+        }
+
+        // On a tie the field stays, so destinations asked for alike do not replace each other
+        return misses > fields[recentTargets.back()].uses;
+    }
+
+    // Halves every count, so the recent plans weigh more than the old ones
+    void ageCounts() {
+        agingPlans = PATH_AGING_PLANS;
+        for (size_t i = 0; i < seenTargets.size(); i++) {
+            seenTargets[i].misses /= 2;
+        }
+        for (std::unordered_map<size_t, DistanceField>::iterator it = fields.begin(); it != fields.end(); ++it) {
+            it->second.uses /= 2;
+        }
+    }
+
+    DistanceField &addField(size_t target, int misses) {
+        // The field that is dropped gives its memory to the new one
+        std::vector<int> distances;
+        if (fields.size() >= maxFields) {
+            distances.swap(fields[recentTargets.back()].distances);
+            fields.erase(recentTargets.back());
+            recentTargets.pop_back();
+        }
+
+        recentTargets.push_front(target);
+        DistanceField &field = fields[target];
+        field.recent = recentTargets.begin();
+        field.uses = misses;
+        field.distances.swap(distances);
+        field.distances.assign(blocked.size(), -1);
+        breadthFirst(target, field.distances, 0, true, frontier);
+        numberFields++;
+        return field;
+    }
+
+public:
+    // The memory of a search of distancesFrom(), kept by the caller between searches
+    struct Scratch {
+        std::vector<int> distances;
+        std::vector<size_t> frontier;
+    };
+
+    /**
+     * Constructor
+     *
+     * @param maxFields Distance fields kept in the cache, at least 1;
+     * fewer if they do not fit in PATH_FIELD_MEMORY.
+     * @throws std::length_error if the grid has more than PATH_MAX_CELLS cells
+     */
+    PathPlanner(int numberRows, int numberColumns, int maxFields)
+            : numberRows(numberRows), numberColumns(numberColumns), width((size_t) numberColumns + 2),
+              numberObstacles(0), currentStamp(0), agingPlans(PATH_AGING_PLANS),
+              numberHits(0), numberSearches(0), numberFields(0) {
+        if (!SupportsGrid(numberRows, numberColumns)) {
+            throw std::length_error("the grid is too large for the path planner");
+        }
+        blocked.assign(((size_t) numberRows + 2) * width, 1);
+        size_t fitting = PATH_FIELD_MEMORY / (blocked.size() * sizeof(int));
+        this->maxFields = std::max<size_t>(1, std::min<size_t>(fitting, maxFields > 1 ? maxFields : 1));
+
+        SeenTarget empty = { noCell, 0 };
+        seenTargets.assign(PATH_SEEN_SLOTS, empty);
+        for (int x = 0; x < numberRows; x++) {
+            std::fill(blocked.begin() + index(x, 0), blocked.begin() + index(x, numberColumns), 0);
+        }
+    }
+
+    // Tells if a grid of this size is within PATH_MAX_CELLS
+    static bool SupportsGrid(int numberRows, int numberColumns) {
+        return ((size_t) numberRows + 2) * ((size_t) numberColumns + 2) <= PATH_MAX_CELLS;
+    }
+
+    /**
+     * Marks a cell as an obstacle; only done while the map is loaded,
+     * before the first plan.
+     */
+    void addObstacle(int x, int y) {
+        unsigned char &cell = blocked[index(x, y)];
+        if (!cell) {
+            cell = 1;
+            numberObstacles++;
+        }
+    }
+
+    bool isObstacle(int x, int y) const {
+        return blocked[index(x, y)] != 0;
+    }
+
+    int getNumberObstacles() const {
+        return numberObstacles;
+    }
+
+    /**
+     * Returns the length of a shortest path between two cells, -1 if one
+     * of them is an obstacle or they are not connected.
+     * Safe to call from several threads.
+     */
+    int distance(int fromX, int fromY, int toX, int toY) {
+        size_t source = index(fromX, fromY);
+        size_t target = index(toX, toY);
+        if (blocked[source] || blocked[target]) {
+            return -1;
+        }
+        if (numberObstacles == 0) {
+            return std::abs(fromX - toX) + std::abs(fromY - toY);
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (components.empty()) {
+            labelComponents();
+        }
+        if (components[source] != components[target]) {
+            return -1;
+        }
+        if (--agingPlans == 0) {
+            ageCounts();
+        }
+
+        // Paths can be walked both ways, so a field of either end will do
+        DistanceField *field = findField(target);
+        if (field != NULL) {
+            numberHits++;
+            return field->distances[source];
+        }
+        field = findField(source);
+        if (field != NULL) {
+            numberHits++;
+            return field->distances[target];
+        }
+
+        SeenTarget &seen = seenTargets[(unsigned int) target * 2654435761u % PATH_SEEN_SLOTS];
+        if (seen.target == target) {
+            seen.misses++;
+        } else {
+            seen.target = target;
+            seen.misses = 1;
+        }
+        if (admitField(seen.misses)) {
+            int misses = seen.misses;
+            seen.misses = 0;
+            return addField(target, misses).distances[source];
+        }
+
+        numberSearches++;
+        return search(source, fromX, fromY, target, toX, toY);
+    }
+
+    /**
+     * Lengths of the shortest paths from one cell to many others, -1 for
+     * the ones that can not be reached; a single BFS of the grid, which
+     * does not go through the cache.
+     * It only reads the grid and writes to the scratch, so it does not
+     * take the lock; safe to call from several threads, each with its
+     * own scratch.
+     */
+    void distancesFrom(int fromX, int fromY, int count, const int *toX, const int *toY,
+            int *distances, Scratch &scratch) const {
+        size_t source = index(fromX, fromY);
+        if (blocked[source] || numberObstacles == 0) {
+            for (int i = 0; i < count; i++) {
+                distances[i] = blocked[source] || blocked[index(toX[i], toY[i])]
+                        ? -1 : std::abs(fromX - toX[i]) + std::abs(fromY - toY[i]);
+            }
+            return;
+        }
+
+        scratch.distances.assign(blocked.size(), -1);
+        breadthFirst(source, scratch.distances, 0, true, scratch.frontier);
+        for (int i = 0; i < count; i++) {
+            distances[i] = scratch.distances[index(toX[i], toY[i])];
+        }
+    }
+
+    // Plans answered from a cached field
+    long long getNumberHits() const {
+        return numberHits;
+    }
+
+    // Plans answered with A*
+    long long getNumberSearches() const {
+        return numberSearches;
+    }
+
+    // Distance fields computed
+    long long getNumberFields() const {
+        return numberFields;
+    }
+
+    size_t memoryUsage() const {
+        return blocked.capacity() + (components.capacity() + fields.size() * blocked.size()
+                + costs.capacity()) * sizeof(int) + frontier.capacity() * sizeof(size_t)
+                + seenTargets.capacity() * sizeof(SeenTarget)
+                + stamps.capacity() * sizeof(unsigned int) + open.capacity() * sizeof(OpenCell);
+    }
+};
+
+#endif // __PATHPLANNER_H__
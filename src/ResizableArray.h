@@ -9,8 +9,60 @@
 
 #include <assert.h>
 #include <iostream>
+#include <new>
+#include <utility>
 
-template <typename T>
+/**
+ * Default resize policy
+ * The capacity is multiplied by the expand factor when the array is full
+ * and halved only when the array is at most a quarter full, so adding and
+ * removing around a capacity boundary never reallocates twice in a row
+ */
+struct HysteresisPolicy {
+    static int grownCapacity(int capacity, int expandFactor) {
+        return capacity * expandFactor;
+    }
+
+    static int shrunkCapacity(int numElements, int capacity, int minCapacity) {
+        int halfCapacity = capacity / 2;
+        if (halfCapacity >= minCapacity && numElements <= capacity / 4) {
+            return halfCapacity;
+        }
+        return capacity;
+    }
+};
+
+/**
+ * The capacity is halved as soon as the array is less than half full
+ * Uses the least memory, but a pattern of adds and removes around the
+ * boundary copies the whole array every time
+ */
+struct EagerShrinkPolicy {
+    static int grownCapacity(int capacity, int expandFactor) {
+        return capacity * expandFactor;
+    }
+
+    static int shrunkCapacity(int numElements, int capacity, int minCapacity) {
+        int halfCapacity = capacity / 2;
+        if (halfCapacity >= minCapacity && halfCapacity > numElements) {
+            return halfCapacity;
+        }
+        return capacity;
+    }
+};
+
+// The capacity only grows, removing elements never reallocates
+struct NeverShrinkPolicy {
+    static int grownCapacity(int capacity, int expandFactor) {
+        return capacity * expandFactor;
+    }
+
+    static int shrunkCapacity(int, int capacity, int) {
+        return capacity;
+    }
+};
+
+template <typename T, typename ResizePolicy = HysteresisPolicy>
 class ResizableArray {
 private:
     int defaultCapacity;
@@ -18,46 +70,89 @@ private:
 
     int numElements;
     int maxCapacity;
-    T *data;
+    T *data;                // only the first numElements slots are constructed
 
-public:
-    // Constructor
-    ResizableArray() {
+    static T *allocate(int capacity) {
+        return static_cast<T *>(::operator new(capacity * sizeof(T)));
+    }
+
+    void destroyAll() {
+        for (int i = 0; i < numElements; i++) {
+            data[i].~T();
+        }
         numElements = 0;
-        maxCapacity = defaultCapacity;
+    }
 
+    void initialize(int initialCapacity, int factor) {
         defaultCapacity = 5;
-        expandFactor = 2;
+        expandFactor = factor >= 2 ? factor : 2;
+
+        numElements = 0;
+        maxCapacity = initialCapacity > 0 ? initialCapacity : defaultCapacity;
 
-        data = new T[maxCapacity];
+        data = allocate(maxCapacity);
     }
 
-    // Another constructor
-    ResizableArray(int initialCapacity) {
-        numElements = 0;
-        maxCapacity = initialCapacity;
+    // Makes room for one more element
+    void ensureRoom() {
+        if (numElements >= maxCapacity) {
+            int newCapacity = ResizePolicy::grownCapacity(maxCapacity, expandFactor);
+            resizeArray(newCapacity > maxCapacity ? newCapacity : defaultCapacity);
+        }
+    }
 
-        defaultCapacity = 5;
-        expandFactor = 2;
+public:
+    // Constructor
+    ResizableArray() {
+        initialize(0, 2);
+    }
 
-        data = new T[maxCapacity];
+    // Another constructor
+    ResizableArray(int initialCapacity) {
+        initialize(initialCapacity, 2);
     }
 
     // Another constructor
     ResizableArray(int initialCapacity, int defaultFactor) {
+        initialize(initialCapacity, defaultFactor);
+    }
+
+    // Copy constructor
+    ResizableArray(const ResizableArray &other) {
+        defaultCapacity = other.defaultCapacity;
+        expandFactor = other.expandFactor;
         numElements = 0;
-        maxCapacity = initialCapacity;
-        expandFactor = defaultFactor;
+        maxCapacity = other.maxCapacity;
+        data = allocate(maxCapacity);
 
-        defaultCapacity = 5;
-        expandFactor = 2;
+        for (int i = 0; i < other.numElements; i++) {
+            new (&data[i]) T(other.data[i]);
+            numElements++;
+        }
+    }
 
-        data = new T[maxCapacity];
+    // Move constructor
+    ResizableArray(ResizableArray &&other)
+            : defaultCapacity(other.defaultCapacity), expandFactor(other.expandFactor),
+              numElements(other.numElements), maxCapacity(other.maxCapacity), data(other.data) {
+        other.numElements = 0;
+        other.maxCapacity = 0;
+        other.data = nullptr;
+    }
+
+    ResizableArray &operator=(ResizableArray other) {
+        std::swap(defaultCapacity, other.defaultCapacity);
+        std::swap(expandFactor, other.expandFactor);
+        std::swap(numElements, other.numElements);
+        std::swap(maxCapacity, other.maxCapacity);
+        std::swap(data, other.data);
+        return *this;
     }
 
     // Destructor
     ~ResizableArray() {
-        delete[] data;
+        destroyAll();
+        ::operator delete(data);
     }
 
     /**
@@ -65,14 +160,30 @@ public:
      *
      * @param element Element to be added at the end of the array.
      */
-    void addLast(T element) {
+    void addLast(const T &element) {
+        ensureRoom();
+
+        new (&data[numElements]) T(element);
+        numElements++;
+    }
+
+    void addLast(T &&element) {
+        ensureRoom();
+
+        new (&data[numElements]) T(std::move(element));
+        numElements++;
+    }
 
-        // check if it will exceed the maximum capacity
-        if(numElements >= maxCapacity) {
-            resizeArray(maxCapacity * expandFactor);
-        } 
+    /**
+     * Constructs an element in place at the end of the array.
+     *
+     * @param args The arguments of the element's constructor.
+     */
+    template <typename... Args>
+    void emplaceLast(Args &&... args) {
+        ensureRoom();
 
-        data[numElements] = element;
+        new (&data[numElements]) T(std::forward<Args>(args)...);
         numElements++;
     }
 
@@ -82,21 +193,21 @@ public:
      * @return Value of the last element stored in the array.
      */
     T removeLast() {
-        T lastElement;
-
         if (isEmpty()) {
             std::cerr << "The list is empty";
-        } else {
-            lastElement = data[numElements - 1];
-            numElements--;
-
-            // Reducing the capacity when the array is less than half full
-            int halfCapacity = maxCapacity / 2;
-            if (halfCapacity >= defaultCapacity && halfCapacity > numElements) {
-                resizeArray(halfCapacity);
-            }
-        
+            return T();
         }
+
+        T lastElement(std::move(data[numElements - 1]));
+        data[numElements - 1].~T();
+        numElements--;
+
+        // Reducing the capacity as decided by the resize policy
+        int newCapacity = ResizePolicy::shrunkCapacity(numElements, maxCapacity, defaultCapacity);
+        if (newCapacity < maxCapacity) {
+            resizeArray(newCapacity);
+        }
+
         return lastElement;
     }
 
@@ -118,26 +229,56 @@ public:
         return numElements;
     }
 
+    /**
+     * Returns the number of elements the array can hold without resizing.
+     */
+    int capacity() {
+        return maxCapacity;
+    }
+
     /**
      * Resize the array to a larger/smaller capacity
-     * 
+     * The elements are moved, not copied, to the new storage
+     *
      */
     void resizeArray(int newCapacity) {
+        assert(newCapacity >= numElements);
+
         // Create a new array with the updated capacity
-        T *newData = new T[newCapacity];
+        T *newData = allocate(newCapacity > 0 ? newCapacity : 1);
 
-        // Copy elements from the old array to the new array
-        for(int i = 0; i < numElements; i++) {
-            newData[i] = data[i];
+        // Move elements from the old array to the new array
+        for (int i = 0; i < numElements; i++) {
+            new (&newData[i]) T(std::move(data[i]));
+            data[i].~T();
         }
 
         // Update maxCapacity and data pointer
-        maxCapacity = newCapacity;
-        delete[] data;
+        maxCapacity = newCapacity > 0 ? newCapacity : 1;
+        ::operator delete(data);
         data = newData;
 
     }
 
+    /**
+     * Makes sure the array can hold at least the given number of
+     * elements without resizing.
+     */
+    void reserve(int capacity) {
+        if (capacity > maxCapacity) {
+            resizeArray(capacity);
+        }
+    }
+
+    /**
+     * Reduces the capacity to the number of elements.
+     */
+    void shrinkToFit() {
+        if (maxCapacity > numElements) {
+            resizeArray(numElements);
+        }
+    }
+
     /**
      * Returns the last element of the array without removing it.
      * Peek implementation
@@ -156,13 +297,13 @@ public:
         return data;
     }
 
-    template <typename U>
+    template <typename U, typename P>
     friend std::ostream& operator<<(std::ostream& os,
-            const ResizableArray<U>& ra);
+            ResizableArray<U, P>& ra);
 };
 
-template <typename T>
-std::ostream& operator<<(std::ostream& os, ResizableArray<T>& ra) {
+template <typename T, typename ResizePolicy>
+std::ostream& operator<<(std::ostream& os, ResizableArray<T, ResizePolicy>& ra) {
     os << "[ ";
     for (int i = 0; i < ra.size(); i++) {
         os << (ra.getData())[i] << " ";
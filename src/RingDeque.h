@@ -0,0 +1,210 @@
+/**
+ * Deque implementation via a circular buffer
+ * Elements can be added and deleted from the beginning and from the end
+ * of the queue in amortized O(1) and any element can be read in O(1)
+ * Offers the same interface as DoublyLinkedList, so they can replace
+ * each other
+ */
+
+#ifndef __RINGDEQUE_H__
+#define __RINGDEQUE_H__
+
+#include <iostream>
+#include <utility>
+
+template <typename T>
+class RingDeque {
+private:
+    static const int defaultCapacity = 8;
+
+    T *data;
+    int maxCapacity;        // always 0 or a power of two
+    int first;              // the index of the first element in data
+    int numElements;
+
+    int slot(int pos) const {
+        return (first + pos) & (maxCapacity - 1);
+    }
+
+    /**
+     * Moves the elements to a buffer twice as large, the first element
+     * of the queue ending up at index 0.
+     */
+    void grow() {
+        int newCapacity = (maxCapacity == 0) ? defaultCapacity : maxCapacity * 2;
+        T *newData = new T[newCapacity];
+
+        for (int i = 0; i < numElements; i++) {
+            newData[i] = std::move(data[slot(i)]);
+        }
+
+        delete[] data;
+        data = newData;
+        maxCapacity = newCapacity;
+        first = 0;
+    }
+
+public:
+    // Constructor
+    RingDeque() : data(nullptr), maxCapacity(0), first(0), numElements(0) {}
+
+    // Copy constructor
+    RingDeque(const RingDeque &other)
+            : data(nullptr), maxCapacity(other.maxCapacity), first(0), numElements(other.numElements) {
+        if (maxCapacity > 0) {
+            data = new T[maxCapacity];
+            for (int i = 0; i < numElements; i++) {
+                data[i] = other.data[other.slot(i)];
+            }
+        }
+    }
+
+    // Move constructor
+    RingDeque(RingDeque &&other)
+            : data(other.data), maxCapacity(other.maxCapacity), first(other.first),
+              numElements(other.numElements) {
+        other.data = nullptr;
+        other.maxCapacity = 0;
+        other.first = 0;
+        other.numElements = 0;
+    }
+
+    RingDeque &operator=(RingDeque other) {
+        std::swap(data, other.data);
+        std::swap(maxCapacity, other.maxCapacity);
+        std::swap(first, other.first);
+        std::swap(numElements, other.numElements);
+        return *this;
+    }
+
+    // Destructor
+    ~RingDeque() {
+        delete[] data;
+    }
+
+    /**
+     * Adds an element at the end of the queue.
+     *
+     * @param element Element to be added at the end of the queue.
+     */
+    void addLast(const T &element) {
+        if (numElements == maxCapacity) {
+            grow();
+        }
+
+        data[slot(numElements)] = element;
+        numElements++;
+    }
+
+    /**
+     * Adds an element at the beginning of the queue.
+     *
+     * @param element Element to be added at the beginning of the queue.
+     */
+    void addFirst(const T &element) {
+        if (numElements == maxCapacity) {
+            grow();
+        }
+
+        first = (first - 1) & (maxCapacity - 1);
+        data[first] = element;
+        numElements++;
+    }
+
+    /**
+     * Removes the last element of the queue.
+     *
+     * @return Value of the last element of the queue.
+     */
+    T removeLast() {
+        T dataRemoved = T();
+
+        if (isEmpty()) {
+            std::cerr << "The list is empty";
+        } else {
+            dataRemoved = std::move(data[slot(numElements - 1)]);
+            numElements--;
+        }
+        return dataRemoved;
+    }
+
+    /**
+     * Removes the first element of the queue.
+     *
+     * @return Value of the first element of the queue.
+     */
+    T removeFirst() {
+        T removedData = T();
+
+        if (isEmpty()) {
+            std::cerr << "The list is empty";
+        } else {
+            removedData = std::move(data[first]);
+            first = slot(1);
+            numElements--;
+        }
+        return removedData;
+    }
+
+    /**
+     * Returns the pos'th element of the queue, counting from the beginning.
+     */
+    T &get(int pos) {
+        return data[slot(pos)];
+    }
+
+    T &getFirst() {
+        return data[first];
+    }
+
+    T &getLast() {
+        return data[slot(numElements - 1)];
+    }
+
+    /**
+     * Check if the queue contains any elements.
+     *
+     * @return True if the queue contains no elements, False otherwise.
+     */
+    bool isEmpty() {
+        return (numElements == 0);
+    }
+
+    /**
+     * Get the number of elements in the queue.
+     *
+     * @return The number of elements stored in the queue.
+     */
+    int size() {
+        return numElements;
+    }
+
+    /**
+     * Get the number of elements the queue can hold without growing.
+     */
+    int capacity() {
+        return maxCapacity;
+    }
+
+    template <typename U>
+    friend std::ostream& operator<<(std::ostream& os, RingDeque<U>& queue);
+};
+
+template <typename T>
+std::ostream& operator<<(std::ostream& os, RingDeque<T>& queue) {
+    if (queue.size() > 0) {
+        os << "[ ";
+        for (int i = 0; i < queue.size() - 1; i++) {
+            os << queue.get(i) << " <-> ";
+        }
+
+        os << queue.getLast();
+        os << " ]";
+    } else {
+        os << "[]";
+    }
+
+    return os;
+}
+
+#endif // __RINGDEQUE_H__
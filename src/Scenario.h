@@ -0,0 +1,509 @@
+/**
+ * One warehouse scenario: an input file, in text or as a binary trace,
+ * executed on a new Warehouse, with the results written to an output file
+ * Used by the command line driver and by the batch mode
+ */
+
+#ifndef __SCENARIO_H__
+#define __SCENARIO_H__
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+#include "CommandLog.h"
+#include "CommandParser.h"
+#include "CommandRunner.h"
+#include "CommandTrace.h"
+#include "OutputBuffer.h"
+#include "ParallelRunner.h"
+#include "Snapshot.h"
+#include "Warehouse.h"
+
+// How the input file is read
+enum InputFormat { INPUT_TEXT, INPUT_TRACE, INPUT_AUTO };
+
+enum ScenarioStatus {
+    SCENARIO_DONE,
+    SCENARIO_NO_INPUT,
+    SCENARIO_NO_TRACE,
+    SCENARIO_NO_OUTPUT,
+    SCENARIO_TOO_LARGE,
+    SCENARIO_TOO_LARGE_TO_PLAN,
+    SCENARIO_OVER_MEMORY_LIMIT,
+    SCENARIO_NO_SNAPSHOT,
+    SCENARIO_NO_LOG,
+    SCENARIO_NO_RECOVERED_OUTPUT,
+    SCENARIO_NO_SOCKET,
+    SCENARIO_FAILED
+};
+
+// The message printed for a status
+inline const char *ScenarioStatusMessage(ScenarioStatus status) {
+    switch (status) {
+    case SCENARIO_NO_INPUT:
+        return "The input file could not be opened.";
+    case SCENARIO_NO_TRACE:
+        return "The trace file could not be opened.";
+    case SCENARIO_NO_OUTPUT:
+        return "The output file could not be opened.";
+    case SCENARIO_TOO_LARGE:
+        return "The warehouse is too large.";
+    case SCENARIO_TOO_LARGE_TO_PLAN:
+        return "The warehouse is too large for --path-planning.";
+    case SCENARIO_OVER_MEMORY_LIMIT:
+        return "The warehouse went over its memory limit.";
+    case SCENARIO_NO_SNAPSHOT:
+        return "The snapshot could not be restored.";
+    case SCENARIO_NO_LOG:
+        return "The command log could not be used.";
+    case SCENARIO_NO_RECOVERED_OUTPUT:
+        return "The output written before the snapshot is missing.";
+    case SCENARIO_NO_SOCKET:
+        return "The server socket could not be opened.";
+    case SCENARIO_FAILED:
+        return "The scenario could not be run.";
+    default:
+        return "Done.";
+    }
+}
+
+// Tells if a warehouse of this size can be built with these options
+inline ScenarioStatus CheckDimensions(int numberRobots, int numberRows, int numberColumns,
+        const WarehouseOptions &options) {
+    if (!Warehouse::SupportsDimensions(numberRobots, numberRows, numberColumns)) {
+        return SCENARIO_TOO_LARGE;
+    }
+    if (options.pathPlanning && !PathPlanner::SupportsGrid(numberRows, numberColumns)) {
+        return SCENARIO_TOO_LARGE_TO_PLAN;
+    }
+    return SCENARIO_DONE;
+}
+
+// The memory limit is checked every SCENARIO_MEMORY_CHECK commands
+const int SCENARIO_MEMORY_CHECK = 1 << 16;
+
+struct ScenarioSettings {
+    WarehouseOptions warehouse;
+    InputFormat format;
+    int numberThreads;          // see ParallelRunner, 1 runs sequentially
+    size_t memoryLimit;         // bytes the warehouse may use, 0 for no limit
+    bool countLines;            // fills ScenarioResult::numberLines
+    /**
+        A snapshot the warehouse starts from, NULL to read the map from
+        the input; with one, a text input only holds commands
+    */
+    const char *restorePath;
+    bool verifySnapshot;        // checks the map of the snapshot against its checksum
+    /**
+        The command log of a text input (see CommandLog.h), NULL for none
+        With recoverLog, the run goes on from where the log stops: the
+        state comes from the snapshot, if any, and the log after it, and
+        the commands of the input the log already holds are skipped; the
+        input is then the whole robots.in, map included
+    */
+    const char *logPath;
+    bool recoverLog;
+    size_t logGroupSize;        // records committed together, at most
+    int logWindowMilliseconds;  // longest a record waits for its commit
+
+    ScenarioSettings() : format(INPUT_TEXT), numberThreads(1), memoryLimit(0), countLines(false),
+            restorePath(NULL), verifySnapshot(true), logPath(NULL), recoverLog(false),
+            logGroupSize(4096), logWindowMilliseconds(10) {}
+};
+
+struct ScenarioResult {
+    long long numberCommands;
+    long numberLines;           // of a text input, if asked for
+    double seconds;
+    size_t peakMemory;          // highest Warehouse::MemoryUsage() seen
+    size_t regionIndexMemory;   // part of it used by the region index
+    // With path planning: obstacles, plans answered by a distance field, plans searched with A*
+    int numberObstacles;
+    long long pathHits;
+    long long pathSearches;
+#ifdef WAREHOUSE_STATS
+    WarehouseStats stats;       // of the warehouse, at the end of the run
+#endif
+
+    ScenarioResult() : numberCommands(0), numberLines(0), seconds(0), peakMemory(0),
+            regionIndexMemory(0), numberObstacles(0), pathHits(0), pathSearches(0) {}
+};
+
+// Number of lines of the input, used for the throughput report
+inline long CountLines(const char *data, size_t size) {
+    long lines = 0;
+    const char *end = data + size;
+    const char *newline;
+
+    while ((newline = (const char *) memchr(data, '\n', end - data)) != NULL) {
+        lines++;
+        data = newline + 1;
+    }
+    if (data != end) {
+        lines++;
+    }
+    return lines;
+}
+
+/**
+    Samples the memory of the warehouse
+
+    @return False if it is over the limit of the settings
+*/
+inline bool CheckMemory(Warehouse &warehouse, const ScenarioSettings &settings, ScenarioResult &result) {
+    size_t usage = warehouse.MemoryUsage();
+    if (usage > result.peakMemory) {
+        result.peakMemory = usage;
+    }
+    result.regionIndexMemory = warehouse.RegionIndexMemory();
+    if (warehouse.GetPathPlanner() != NULL) {
+        result.numberObstacles = warehouse.GetPathPlanner()->getNumberObstacles();
+        result.pathHits = warehouse.GetPathPlanner()->getNumberHits();
+        result.pathSearches = warehouse.GetPathPlanner()->getNumberSearches();
+    }
+    return settings.memoryLimit == 0 || usage <= settings.memoryLimit;
+}
+
+/**
+    Logs the commands from first on, up to the end or to the first
+    SNAPSHOT included, so the log holds everything the snapshot does
+
+    @return The end of the commands logged
+*/
+inline size_t LogCommands(CommandLog &log, const Command *commands, size_t first, size_t end) {
+    while (first < end) {
+        log.append(commands[first]);
+        if (commands[first++].opcode == OP_SNAPSHOT) {
+            break;
+        }
+    }
+    return first;
+}
+
+/**
+    Executes the commands, in blocks of SCENARIO_MEMORY_CHECK so the
+    memory limit is checked between them; with a log, every command is
+    logged before it runs
+*/
+inline ScenarioStatus RunCommands(Warehouse &warehouse, const Command *commands, size_t numberCommands,
+        const CommandNames &names, const ScenarioSettings &settings, ParallelRunner *runner,
+        CommandLog *log, OutputBuffer &output, OutputBuffer &discarded, ScenarioResult &result) {
+    for (size_t start = 0; start < numberCommands; start += SCENARIO_MEMORY_CHECK) {
+        size_t end = start + SCENARIO_MEMORY_CHECK < numberCommands ? start + SCENARIO_MEMORY_CHECK : numberCommands;
+        if (runner != NULL) {
+            for (size_t first = start, last; first < end; first = last) {
+                last = log != NULL ? LogCommands(*log, commands, first, end) : end;
+                runner->run(commands + first, last - first, output);
+            }
+        } else {
+            for (size_t i = start; i < end; i++) {
+                if (log != NULL) {
+                    log->append(commands[i]);
+                }
+                RunCommand(warehouse, commands[i], names, output, discarded);
+            }
+        }
+
+        result.numberCommands += end - start;
+        if (settings.memoryLimit > 0 && !CheckMemory(warehouse, settings, result)) {
+            return SCENARIO_OVER_MEMORY_LIMIT;
+        }
+    }
+    return SCENARIO_DONE;
+}
+
+// Executes a binary trace straight from the mapped records
+inline ScenarioStatus RunTrace(const TraceReader &trace, FILE *outputFile,
+        const ScenarioSettings &settings, ScenarioResult &result) {
+    ScenarioStatus dimensionsStatus = CheckDimensions(trace.numberRobots(), trace.numberRows(),
+            trace.numberColumns(), settings.warehouse);
+    if (dimensionsStatus != SCENARIO_DONE) {
+        return dimensionsStatus;
+    }
+
+    OutputBuffer output(outputFile, 1 << 20);
+    OutputBuffer discarded(NULL);
+    Warehouse warehouse(trace.numberRobots(), trace.numberRows(), trace.numberColumns(),
+            settings.warehouse);
+    warehouse.LoadMap(trace.map());
+
+    std::unique_ptr<ParallelRunner> runner;
+    if (settings.numberThreads > 1) {
+        runner.reset(new ParallelRunner(warehouse, trace.getNames(), settings.numberThreads));
+    }
+    ScenarioStatus status = RunCommands(warehouse, trace.commands(), trace.numberCommands(),
+            trace.getNames(), settings, runner.get(), NULL, output, discarded, result);
+
+    CheckMemory(warehouse, settings, result);
+#ifdef WAREHOUSE_STATS
+    result.stats = warehouse.GetStats();
+#endif
+    output.flush();
+    return status;
+}
+
+/**
+    Brings a run that stopped back to where its log stops: robots.out is
+    cut to what was written before the snapshot, or emptied without one,
+    and the commands of the input from there to the last one logged run
+    again with their output, each logged one checked against its record.
+    The state is the same as replaying the records, and the output lines
+    of the commands that are not logged are written again as well. A
+    SNAPSHOT among them is not taken again
+
+    @param firstRecord The first record of the log after the snapshot
+    @param sequence The position of the first command after the
+    snapshot, set to the position of the first command not logged
+    @param outputBytes What robots.out held when the snapshot was taken
+*/
+inline ScenarioStatus RecoverLoggedCommands(Warehouse &warehouse, CommandScanner &scanner,
+        const LogReader &recovered, uint64_t firstRecord, uint64_t &sequence, long long outputBytes,
+        FILE *outputFile, OutputBuffer &output, OutputBuffer &discarded, ScenarioResult &result) {
+    const std::vector<LogRecord> &records = recovered.getRecords();
+    if (firstRecord > records.size()) {
+        return SCENARIO_NO_LOG;
+    }
+    if (outputBytes < 0 || fseeko(outputFile, 0, SEEK_END) != 0 || ftello(outputFile) < outputBytes
+            || ftruncate(fileno(outputFile), outputBytes) != 0 || fseeko(outputFile, outputBytes, SEEK_SET) != 0) {
+        return SCENARIO_NO_RECOVERED_OUTPUT;
+    }
+
+    Command command;
+    for (uint64_t i = sequence; i > 0 && scanner.nextCommand(command); i--) {
+    }
+    uint64_t end = firstRecord < records.size() ? records.back().sequence + 1 : sequence;
+    for (size_t next = firstRecord; sequence < end; sequence++) {
+        if (!scanner.nextCommand(command)) {
+            return SCENARIO_NO_LOG;
+        }
+        if (IsLoggedCommand(command.opcode)) {
+            if (next == records.size() || records[next].sequence != sequence
+                    || !SameLoggedCommand(records[next].command, command)) {
+                return SCENARIO_NO_LOG;     // the log is not of this input
+            }
+            next++;
+        }
+        if (command.opcode != OP_SNAPSHOT) {
+            RunCommand(warehouse, command, scanner.getNames(), output, discarded);
+        }
+        result.numberCommands++;
+    }
+    return SCENARIO_DONE;
+}
+
+// Parses and executes a robots.in file, or only its commands on a restored snapshot
+inline ScenarioStatus RunText(const MappedFile &inputFile, FILE *outputFile,
+        const ScenarioSettings &settings, ScenarioResult &result) {
+    CommandScanner scanner(inputFile.data(), inputFile.size());
+    int numberRobots = 0;
+    int numberRows = 0;
+    int numberColumns = 0;
+    int value = 0;              // store the values for every cell of map
+    WarehouseOptions options = settings.warehouse;
+
+    LogReader recovered;
+    if (settings.recoverLog && (settings.logPath == NULL || !recovered.open(settings.logPath))) {
+        return SCENARIO_NO_LOG;
+    }
+
+    // Read the first three elements from file: N ROW COL, unless the input only holds commands
+    if ((settings.restorePath == NULL || settings.recoverLog)
+            && scanner.nextInt(numberRobots) && scanner.nextInt(numberRows)) {
+        scanner.nextInt(numberColumns);
+    }
+
+    SnapshotReader snapshot;
+    uint64_t firstRecord = 0;   // the first record of the log that is not in the snapshot
+    uint64_t firstSequence = 0; // the first command of the input that is not in the snapshot
+    long long outputBytes = 0;  // of robots.out, written for the commands before firstSequence
+    if (settings.restorePath != NULL) {
+        std::vector<std::string> checkpointNames;
+        if (!snapshot.open(settings.restorePath, settings.verifySnapshot)
+                || !snapshot.readNames(checkpointNames)
+                || (settings.recoverLog && snapshot.getHeader().logID != recovered.getLogID())) {
+            return SCENARIO_NO_SNAPSHOT;
+        }
+        firstRecord = snapshot.getHeader().logRecords;
+        firstSequence = snapshot.getHeader().logSequence;
+        outputBytes = snapshot.getHeader().outputBytes;
+
+        // The map of the input is not needed, the snapshot has it
+        if (settings.recoverLog) {
+            for (long long i = (long long) numberRows * numberColumns; i > 0 && scanner.nextInt(value); i--) {
+            }
+        }
+
+        // The checkpoints keep the IDs they had when the snapshot was taken
+        scanner.addCheckpointNames(checkpointNames);
+        numberRobots = snapshot.getHeader().numberRobots;
+        numberRows = snapshot.getHeader().numberRows;
+        numberColumns = snapshot.getHeader().numberColumns;
+        options.priorityLevels = snapshot.getHeader().priorityLevels;
+    }
+
+    ScenarioStatus dimensionsStatus = CheckDimensions(numberRobots, numberRows, numberColumns, options);
+    if (dimensionsStatus != SCENARIO_DONE) {
+        return dimensionsStatus;
+    }
+
+    OutputBuffer output(outputFile, 1 << 20);
+    OutputBuffer discarded(NULL);
+
+    // Warehouse initialization with given data from the file
+    Warehouse warehouse(numberRobots, numberRows, numberColumns, options);
+
+    if (settings.restorePath != NULL) {
+        if (!warehouse.RestoreSnapshot(snapshot)) {
+            return SCENARIO_NO_SNAPSHOT;
+        }
+        snapshot.close();
+    } else {
+        // Read all the values for the map, one row at a time
+        std::vector<int> row(numberColumns > 0 ? numberColumns : 0);
+        for (int i = 0; i < numberRows; i++) {
+            for (int j = 0; j < numberColumns; j++) {
+                scanner.nextInt(value);
+                row[j] = value;
+            }
+            warehouse.LoadMapRow(i, row.data());
+        }
+        warehouse.FinishLoading();
+    }
+
+    Command command;
+    memset(&command, 0, sizeof(command));
+
+    std::unique_ptr<CommandLog> log;
+    if (settings.logPath != NULL) {
+        log.reset(new CommandLog(settings.logGroupSize, settings.logWindowMilliseconds));
+        if (settings.recoverLog) {
+            uint64_t nextSequence = firstSequence;
+            ScenarioStatus recoveredStatus = RecoverLoggedCommands(warehouse, scanner, recovered, firstRecord,
+                    nextSequence, outputBytes, outputFile, output, discarded, result);
+            if (recoveredStatus != SCENARIO_DONE) {
+                return recoveredStatus;
+            }
+            if (!log->reopen(settings.logPath, recovered, nextSequence)) {
+                return SCENARIO_NO_LOG;
+            }
+        } else if (!log->create(settings.logPath)) {
+            return SCENARIO_NO_LOG;
+        }
+        warehouse.AttachLog(log.get());
+    }
+
+    // Read the rest of the file - the commands and parameters
+    ScenarioStatus status = SCENARIO_DONE;
+
+    if (settings.numberThreads > 1 || settings.memoryLimit > 0) {
+        // Parsed in batches, so the runner can look ahead for independent commands
+        std::unique_ptr<ParallelRunner> runner;
+        if (settings.numberThreads > 1) {
+            runner.reset(new ParallelRunner(warehouse, scanner.getNames(), settings.numberThreads));
+        }
+        std::vector<Command> batch;
+        batch.reserve(PARALLEL_MAX_EPOCH);
+
+        bool more = true;
+        while (more && status == SCENARIO_DONE) {
+            while ((more = scanner.nextCommand(command))) {
+                batch.push_back(command);
+                if (batch.size() == (size_t) PARALLEL_MAX_EPOCH) {
+                    break;
+                }
+            }
+            status = RunCommands(warehouse, batch.data(), batch.size(), scanner.getNames(), settings,
+                    runner.get(), log.get(), output, discarded, result);
+            batch.clear();
+        }
+    } else if (log) {
+        while (scanner.nextCommand(command)) {
+            log->append(command);
+            RunCommand(warehouse, command, scanner.getNames(), output, discarded);
+            result.numberCommands++;
+        }
+    } else {
+        while (scanner.nextCommand(command)) {
+            RunCommand(warehouse, command, scanner.getNames(), output, discarded);
+            result.numberCommands++;
+        }
+    }
+
+    if (log && !log->close() && status == SCENARIO_DONE) {
+        status = SCENARIO_NO_LOG;
+    }
+    warehouse.AttachLog(NULL);
+
+    CheckMemory(warehouse, settings, result);
+#ifdef WAREHOUSE_STATS
+    result.stats = warehouse.GetStats();
+#endif
+    output.flush();
+    return status;
+}
+
+/**
+ * Runs one scenario on a new warehouse.
+ *
+ * @param inputPath A robots.in file or a binary trace, see settings.format.
+ * @param outputPath Where the results are written.
+ * @param result Filled with the counts and timings of the run.
+ */
+inline ScenarioStatus RunScenario(const char *inputPath, const char *outputPath,
+        const ScenarioSettings &settings, ScenarioResult &result) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    result = ScenarioResult();
+
+    MappedFile inputFile;
+    TraceReader trace;
+    bool isTrace = settings.format == INPUT_TRACE;
+    if (!isTrace) {
+        if (!inputFile.open(inputPath)) {
+            return SCENARIO_NO_INPUT;
+        }
+        isTrace = settings.format == INPUT_AUTO && inputFile.size() >= sizeof(TRACE_MAGIC)
+                && memcmp(inputFile.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0;
+    }
+    if (isTrace) {
+        inputFile.close();
+        if (!trace.open(inputPath)) {
+            return SCENARIO_NO_TRACE;
+        }
+    }
+
+    // A recovered run keeps what robots.out held before the snapshot, see RecoverLoggedCommands()
+    FILE *outputFile;
+    if (settings.recoverLog && !isTrace) {
+        int fd = open(outputPath, O_WRONLY | O_CREAT, 0644);
+        outputFile = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (fd >= 0 && outputFile == NULL) {
+            close(fd);
+        }
+    } else {
+        outputFile = fopen(outputPath, "w");
+    }
+    if (outputFile == NULL) {
+        return SCENARIO_NO_OUTPUT;
+    }
+
+    ScenarioStatus status;
+    if (isTrace) {
+        status = RunTrace(trace, outputFile, settings, result);
+    } else {
+        status = RunText(inputFile, outputFile, settings, result);
+        if (settings.countLines) {
+            result.numberLines = CountLines(inputFile.data(), inputFile.size());
+        }
+    }
+    fclose(outputFile);
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return status;
+}
+
+#endif // __SCENARIO_H__
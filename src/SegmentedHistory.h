@@ -0,0 +1,321 @@
+/**
+ * Stack implementation via fixed-size chunks
+ * Elements can be added or deleted only from the end of the stack
+ * Chunks are never relocated, and when more than a given number of them
+ * are in memory the oldest ones are spilled to a memory-mapped file
+ * The last element is always in memory
+ */
+
+#ifndef __SEGMENTEDHISTORY_H__
+#define __SEGMENTEDHISTORY_H__
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <type_traits>
+#include <unistd.h>
+
+#include "ResizableArray.h"
+
+template <typename T>
+class SegmentedHistory {
+private:
+    static_assert(std::is_trivially_copyable<T>::value,
+            "spilled elements are stored as raw bytes");
+
+    int chunkShift;
+    long chunkSize;
+    long numElements;
+
+    /**
+        The chunks, oldest first; NULL for the ones spilled to the file
+        The chunks in memory are always the newest ones, starting at
+        index firstResident
+    */
+    ResizableArray<T *> chunks;
+    int firstResident;
+    int residentChunks;
+    int maxResidentChunks;      // 0 if chunks are never spilled
+    T *spareChunk;              // kept to avoid reallocating at a boundary
+
+    std::string spillDirectory;
+    int spillFd;
+    off_t spillFileSize;
+    long spilledChunks;
+
+    SegmentedHistory(const SegmentedHistory &);
+    SegmentedHistory &operator=(const SegmentedHistory &);
+
+    size_t chunkBytes() const {
+        return chunkSize * sizeof(T);
+    }
+
+    T *allocateChunk() {
+        T *chunk = spareChunk;
+        spareChunk = NULL;
+        if (chunk == NULL) {
+            chunk = (T *) malloc(chunkBytes());
+            if (chunk == NULL) {
+                throw std::bad_alloc();
+            }
+        }
+        return chunk;
+    }
+
+    void releaseChunk(T *chunk) {
+        if (spareChunk == NULL) {
+            spareChunk = chunk;
+        } else {
+            free(chunk);
+        }
+    }
+
+    // Opens the spill file, removed from the directory right away
+    bool openSpillFile() {
+        std::string pattern = spillDirectory + "/history-XXXXXX";
+        char *path = strdup(pattern.c_str());
+        spillFd = mkstemp(path);
+        if (spillFd >= 0) {
+            unlink(path);
+        }
+        free(path);
+        return spillFd >= 0;
+    }
+
+    /**
+        Maps the region of the spill file holding the given chunk
+
+        @param offsetInMapping Set to the position of the chunk in the mapping
+    */
+    char *mapChunk(int index, int protection, size_t &mappedLength, size_t &offsetInMapping) {
+        off_t offset = (off_t) index * chunkBytes();
+        off_t pageSize = sysconf(_SC_PAGESIZE);
+        off_t alignedOffset = offset / pageSize * pageSize;
+
+        offsetInMapping = offset - alignedOffset;
+        mappedLength = offsetInMapping + chunkBytes();
+        void *address = mmap(NULL, mappedLength, protection, MAP_SHARED, spillFd, alignedOffset);
+        return address == MAP_FAILED ? NULL : (char *) address;
+    }
+
+    /**
+        Writes the oldest chunk in memory to the spill file and frees it
+        If the file can not be written, spilling is turned off
+    */
+    void spillOldest() {
+        int index = firstResident;
+        bool spilled = false;
+
+        if (spillFd >= 0 || openSpillFile()) {
+            off_t end = (off_t) (index + 1) * chunkBytes();
+            if (end > spillFileSize && ftruncate(spillFd, end) == 0) {
+                spillFileSize = end;
+            }
+
+            size_t length, offset;
+            char *region;
+            if (end <= spillFileSize
+                    && (region = mapChunk(index, PROT_READ | PROT_WRITE, length, offset)) != NULL) {
+                memcpy(region + offset, chunks.getData()[index], chunkBytes());
+                munmap(region, length);
+                spilled = true;
+            }
+        }
+
+        if (!spilled) {
+            std::cerr << "The history could not be spilled to " << spillDirectory
+                    << ", keeping it in memory\n";
+            maxResidentChunks = 0;
+            return;
+        }
+
+        releaseChunk(chunks.getData()[index]);
+        chunks.getData()[index] = NULL;
+        firstResident++;
+        residentChunks--;
+        spilledChunks++;
+    }
+
+    // Brings back the newest spilled chunk
+    void reloadChunk(int index) {
+        T *chunk = allocateChunk();
+        size_t length, offset;
+        char *region = mapChunk(index, PROT_READ, length, offset);
+        if (region == NULL) {
+            throw std::runtime_error("the spilled history could not be read");
+        }
+        memcpy(chunk, region + offset, chunkBytes());
+        munmap(region, length);
+
+        chunks.getData()[index] = chunk;
+        firstResident = index;
+        residentChunks++;
+    }
+
+    T &at(long pos) {
+        return chunks.getData()[pos >> chunkShift][pos & (chunkSize - 1)];
+    }
+
+    // Makes room for one more element
+    void ensureRoom() {
+        if (numElements == (long) chunks.size() * chunkSize) {
+            if (maxResidentChunks > 0 && residentChunks >= maxResidentChunks) {
+                spillOldest();
+            }
+            chunks.addLast(allocateChunk());
+            residentChunks++;
+        }
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param chunkBits Each chunk holds 2^chunkBits elements.
+     * @param maxResidentChunks Chunks kept in memory, 0 for no limit.
+     * @param spillDirectory Where the spill file is created.
+     */
+    SegmentedHistory(int chunkBits = 16, int maxResidentChunks = 0, const char *spillDirectory = "/tmp")
+            : chunkShift(chunkBits), chunkSize(1L << chunkBits), numElements(0),
+              firstResident(0), residentChunks(0), spareChunk(NULL),
+              spillDirectory(spillDirectory), spillFd(-1), spillFileSize(0), spilledChunks(0) {
+        // The chunk holding the last element and the one after it must fit
+        this->maxResidentChunks = (maxResidentChunks > 0 && maxResidentChunks < 2) ? 2 : maxResidentChunks;
+    }
+
+    // Destructor
+    ~SegmentedHistory() {
+        for (int i = 0; i < chunks.size(); i++) {
+            free(chunks.getData()[i]);
+        }
+        free(spareChunk);
+        if (spillFd >= 0) {
+            close(spillFd);
+        }
+    }
+
+    /**
+     * Adds the specified element at the end of the stack.
+     */
+    void addLast(const T &element) {
+        ensureRoom();
+        at(numElements) = element;
+        numElements++;
+    }
+
+    /**
+     * Adds count elements at the end of the stack, a chunk at a time.
+     */
+    void addAll(const T *elements, long count) {
+        while (count > 0) {
+            ensureRoom();
+            long offset = numElements & (chunkSize - 1);
+            long copied = chunkSize - offset < count ? chunkSize - offset : count;
+            memcpy(&at(numElements), elements, copied * sizeof(T));
+            numElements += copied;
+            elements += copied;
+            count -= copied;
+        }
+    }
+
+    /**
+     * Calls visit(elements, count) on the whole stack in order, one chunk
+     * at a time; spilled chunks are mapped back only for the call.
+     *
+     * @return False if a spilled chunk could not be read.
+     */
+    template <typename Visitor>
+    bool forEachChunk(Visitor visit) {
+        for (int i = 0; (long) i * chunkSize < numElements; i++) {
+            long count = numElements - (long) i * chunkSize < chunkSize
+                    ? numElements - (long) i * chunkSize : chunkSize;
+            if (chunks.getData()[i] != NULL) {
+                visit((const T *) chunks.getData()[i], count);
+                continue;
+            }
+
+            size_t length, offset;
+            char *region = mapChunk(i, PROT_READ, length, offset);
+            if (region == NULL) {
+                return false;
+            }
+            visit((const T *) (region + offset), count);
+            munmap(region, length);
+        }
+        return true;
+    }
+
+    /**
+     * Constructs an element at the end of the stack.
+     */
+    template <typename... Args>
+    void emplaceLast(Args &&... args) {
+        ensureRoom();
+        new (&at(numElements)) T(std::forward<Args>(args)...);
+        numElements++;
+    }
+
+    /**
+     * Removes and returns the last element of the stack.
+     */
+    T removeLast() {
+        if (isEmpty()) {
+            std::cerr << "The list is empty";
+            return T();
+        }
+
+        numElements--;
+        T lastElement = at(numElements);
+
+        /*
+        Keep at most one empty chunk after the one holding the last
+        element, so going back and forth over a boundary does not
+        allocate or spill every time
+        */
+        long lastChunk = numElements == 0 ? -1 : (numElements - 1) >> chunkShift;
+        while (chunks.size() - 1 > lastChunk + 1) {
+            releaseChunk(chunks.removeLast());
+            residentChunks--;
+        }
+
+        if (lastChunk >= 0 && chunks.getData()[lastChunk] == NULL) {
+            reloadChunk((int) lastChunk);
+        }
+
+        return lastElement;
+    }
+
+    /**
+     * Returns the last element of the stack without removing it.
+     */
+    T &getLast() {
+        if (isEmpty()) {
+            std::cerr << "The list is empty";
+        }
+        return at(numElements - 1);
+    }
+
+    bool isEmpty() {
+        return (numElements == 0);
+    }
+
+    long size() {
+        return numElements;
+    }
+
+    // Number of chunks in memory and number of times a chunk was spilled
+    int getResidentChunks() {
+        return residentChunks;
+    }
+
+    long getSpilledChunks() {
+        return spilledChunks;
+    }
+};
+
+#endif // __SEGMENTEDHISTORY_H__
@@ -0,0 +1,606 @@
+/**
+ * Server mode: one warehouse kept in memory behind a Unix domain socket
+ * A client sends requests, each a batch of commands in the text form of
+ * robots.in or as Command records, and gets back the lines robots.out
+ * would get for them, PRINT_COMMANDS and LAST_EXECUTED_COMMAND included.
+ * Requests may be pipelined, the responses come back in the same order.
+ * One thread runs an epoll loop over every connection, each with its own
+ * input and output buffer
+ *
+ * On the socket (native byte order):
+ *   request:  ServerRequestHeader, then size bytes of commands
+ *   response: ServerResponseHeader, then size bytes of results
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <signal.h>
+#include <stdint.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CommandParser.h"
+#include "CommandRunner.h"
+#include "Scenario.h"
+
+// How the commands of a request are written
+enum ServerFormat { SERVER_TEXT, SERVER_BINARY };
+
+// The status of a response
+enum ServerReply {
+    SERVER_OK,
+    SERVER_BAD_REQUEST,     // unknown format or size, nothing ran
+    SERVER_BAD_COMMAND,     // a command refers to what the warehouse does not have, nothing ran
+    SERVER_FAILED           // the commands ran, then the server stopped (memory limit)
+};
+
+struct ServerRequestHeader {
+    uint32_t format;            // ServerFormat
+    uint32_t size;              // bytes of commands after the header: lines, or Command records
+    uint64_t requestID;         // given back in the response
+};
+
+struct ServerResponseHeader {
+    uint32_t status;            // ServerReply
+    uint32_t size;              // bytes of results after the header
+    uint64_t requestID;
+};
+
+static_assert(sizeof(ServerRequestHeader) == 16, "ServerRequestHeader must stay 16 bytes");
+static_assert(sizeof(ServerResponseHeader) == 16, "ServerResponseHeader must stay 16 bytes");
+
+struct ServerSettings {
+    size_t maxRequestSize;      // bytes of commands in a request, a larger one closes the connection
+    size_t maxPendingOutput;    // bytes of responses a client may leave unread before its requests wait
+    int maxConnections;
+    int maxUndo;                // commands one UNDO may ask for, every one that fails is a line of the response
+
+    ServerSettings() : maxRequestSize(16 << 20), maxPendingOutput(4 << 20), maxConnections(1024),
+            maxUndo(1 << 20) {}
+};
+
+struct ServerStats {
+    long long numberConnections;
+    long long numberRequests;
+    long long rejectedRequests; // answered with SERVER_BAD_REQUEST or SERVER_BAD_COMMAND
+
+    ServerStats() : numberConnections(0), numberRequests(0), rejectedRequests(0) {}
+};
+
+// Set by SIGINT and SIGTERM, the server stops at the next round of its loop
+inline volatile sig_atomic_t &ServerStopFlag() {
+    static volatile sig_atomic_t stop = 0;
+    return stop;
+}
+
+inline void StopServer(int) {
+    ServerStopFlag() = 1;
+}
+
+/**
+ * One client: the bytes received and not handled yet, and the responses
+ * not sent yet
+ */
+struct ServerConnection {
+    int fd;
+    std::vector<char> input;
+    size_t inputStart;          // first byte not handled
+    size_t inputEnd;            // end of the bytes received
+    std::vector<char> output;
+    size_t outputStart;         // first byte not sent
+    uint32_t events;            // registered with epoll
+    bool closing;               // nothing more is read, closed once the responses are sent
+    bool queued;
+    Command command;            // the parameters text commands carry from one to the next
+
+    explicit ServerConnection(int fd)
+            : fd(fd), input(1 << 16), inputStart(0), inputEnd(0), outputStart(0), events(EPOLLIN),
+              closing(false), queued(false) {
+        memset(&command, 0, sizeof(command));
+    }
+
+    size_t pendingOutput() const {
+        return output.size() - outputStart;
+    }
+};
+
+class WarehouseServer {
+private:
+    static const int maxEvents = 64;
+
+    Warehouse &warehouse;
+    CommandScanner &scanner;    // parses the text requests of every client, so they share the checkpoint names
+    const ScenarioSettings &settings;
+    const ServerSettings &server;
+    ScenarioResult &result;
+    ServerStats &stats;
+
+    std::string socketPath;
+    int listener;
+    int epollFd;
+    std::vector<std::unique_ptr<ServerConnection> > connections;   // by file descriptor
+    int numberConnections;
+    std::vector<int> queue;     // connections with requests to handle or responses to send
+    std::vector<Command> commands;
+    OutputBuffer results;
+    ScenarioStatus status;
+
+    void enqueue(ServerConnection &connection) {
+        if (!connection.queued) {
+            connection.queued = true;
+            queue.push_back(connection.fd);
+        }
+    }
+
+    void drop(ServerConnection &connection) {
+        int fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+        close(fd);
+        connections[fd].reset();
+        numberConnections--;
+    }
+
+    void acceptAll() {
+        int fd;
+        while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            if (numberConnections >= server.maxConnections) {
+                close(fd);
+                continue;
+            }
+            if ((size_t) fd >= connections.size()) {
+                connections.resize(fd + 1);
+            }
+            connections[fd].reset(new ServerConnection(fd));
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                close(fd);
+                connections[fd].reset();
+                continue;
+            }
+            numberConnections++;
+            stats.numberConnections++;
+        }
+    }
+
+    // Reads what the client sent, the buffer growing to hold the whole request it is in
+    void receive(ServerConnection &connection) {
+        if (connection.inputStart == connection.inputEnd) {
+            connection.inputStart = connection.inputEnd = 0;
+            if (connection.input.size() > (1 << 16)) {
+                std::vector<char>(1 << 16).swap(connection.input);
+            }
+        } else if (connection.inputStart > 0) {
+            memmove(connection.input.data(), connection.input.data() + connection.inputStart,
+                    connection.inputEnd - connection.inputStart);
+            connection.inputEnd -= connection.inputStart;
+            connection.inputStart = 0;
+        }
+
+        if (connection.inputEnd >= sizeof(ServerRequestHeader)) {
+            ServerRequestHeader header;
+            memcpy(&header, connection.input.data(), sizeof(header));
+            size_t needed = sizeof(header) + header.size;
+            if (header.size <= server.maxRequestSize && needed > connection.input.size()) {
+                connection.input.resize(needed);
+            }
+        }
+        if (connection.inputEnd == connection.input.size()) {
+            return;
+        }
+
+        ssize_t count;
+        do {
+            count = read(connection.fd, connection.input.data() + connection.inputEnd,
+                    connection.input.size() - connection.inputEnd);
+        } while (count < 0 && errno == EINTR);
+        if (count > 0) {
+            connection.inputEnd += count;
+        } else if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            connection.closing = true;
+        }
+    }
+
+    void respond(ServerConnection &connection, ServerReply reply, uint64_t requestID,
+            const char *data, size_t size) {
+        ServerResponseHeader header = { (uint32_t) reply, (uint32_t) size, requestID };
+        connection.output.insert(connection.output.end(), (const char *) &header,
+                (const char *) &header + sizeof(header));
+        connection.output.insert(connection.output.end(), data, data + size);
+    }
+
+    /**
+     * Whether a command only refers to robots, cells and names the
+     * warehouse has; Warehouse trusts its input, the clients are not.
+     */
+    bool accepts(const Command &command) {
+        int numberRobots = warehouse.GetNumberRobots();
+        const CommandNames &names = scanner.getNames();
+
+        switch (command.opcode) {
+        case OP_ADD_GET_BOX:
+        case OP_ADD_DROP_BOX:
+            // Without a robot, the command waits for ASSIGN_BATCH
+            return command.robotID < numberRobots && command.x >= 0 && command.x < warehouse.GetNumberRows()
+                    && command.y >= 0 && command.y < warehouse.GetNumberColumns();
+
+        case OP_EXECUTE:
+        case OP_PRINT_COMMANDS:
+        case OP_HOW_MANY_BOXES:
+            return command.robotID >= 0 && command.robotID < numberRobots;
+
+        case OP_HOW_MUCH_TIME:
+            return command.argument != 1 || (command.robotID >= 0 && command.robotID < numberRobots);
+
+        case OP_UNDO:
+            return command.argument <= server.maxUndo;
+
+        case OP_CHECKPOINT:
+        case OP_ROLLBACK_TO:
+            return command.argument >= 0 && command.argument < (int) names.checkpoints.size();
+
+        default:
+            return command.opcode <= OP_INVALID;
+        }
+    }
+
+    // Runs the commands of one request and queues its response
+    void run(ServerConnection &connection, const ServerRequestHeader &header, const char *data) {
+        stats.numberRequests++;
+        commands.clear();
+        if (header.format == SERVER_TEXT) {
+            scanner.reset(data, header.size);
+            while (scanner.nextCommand(connection.command)) {
+                commands.push_back(connection.command);
+            }
+        } else if (header.format == SERVER_BINARY && header.size % sizeof(Command) == 0) {
+            commands.resize(header.size / sizeof(Command));
+            if (header.size > 0) {
+                memcpy(commands.data(), data, header.size);
+            }
+        } else {
+            stats.rejectedRequests++;
+            respond(connection, SERVER_BAD_REQUEST, header.requestID, NULL, 0);
+            return;
+        }
+
+        results.clear();
+        for (size_t i = 0; i < commands.size(); i++) {
+            if (!accepts(commands[i])) {
+                stats.rejectedRequests++;
+                results.write("Command ");
+                results.writeInt((long long) i + 1);
+                results.writeLine(" of the request can not be run.");
+                respond(connection, SERVER_BAD_COMMAND, header.requestID, results.data(), results.size());
+                return;
+            }
+        }
+
+        status = RunCommands(warehouse, commands.data(), commands.size(), scanner.getNames(), settings,
+                NULL, NULL, results, results, result);
+        respond(connection, status == SCENARIO_DONE ? SERVER_OK : SERVER_FAILED, header.requestID,
+                results.data(), results.size());
+    }
+
+    // Handles the whole requests received, as long as the client reads the responses
+    void handle(ServerConnection &connection) {
+        while (status == SCENARIO_DONE && connection.pendingOutput() < server.maxPendingOutput
+                && connection.inputEnd - connection.inputStart >= sizeof(ServerRequestHeader)) {
+            ServerRequestHeader header;
+            memcpy(&header, connection.input.data() + connection.inputStart, sizeof(header));
+            if (header.size > server.maxRequestSize) {
+                stats.rejectedRequests++;
+                respond(connection, SERVER_BAD_REQUEST, header.requestID, NULL, 0);
+                connection.inputStart = connection.inputEnd;
+                connection.closing = true;
+                break;
+            }
+            if (connection.inputEnd - connection.inputStart < sizeof(header) + header.size) {
+                break;
+            }
+
+            const char *data = connection.input.data() + connection.inputStart + sizeof(header);
+            connection.inputStart += sizeof(header) + header.size;
+            run(connection, header, data);
+        }
+    }
+
+    // Sends what the socket takes of the responses
+    bool send(ServerConnection &connection) {
+        while (connection.pendingOutput() > 0) {
+            ssize_t count = ::send(connection.fd, connection.output.data() + connection.outputStart,
+                    connection.pendingOutput(), MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            connection.outputStart += count;
+        }
+        connection.output.clear();
+        connection.outputStart = 0;
+        return true;
+    }
+
+    /**
+     * Waits for the requests while the client keeps up with the responses,
+     * and for the socket while responses are left; closes the connection
+     * once it has nothing more to do.
+     */
+    void update(ServerConnection &connection) {
+        if (connection.outputStart > (1 << 20)) {
+            connection.output.erase(connection.output.begin(), connection.output.begin() + connection.outputStart);
+            connection.outputStart = 0;
+        }
+
+        uint32_t events = 0;
+        if (!connection.closing && connection.pendingOutput() < server.maxPendingOutput) {
+            events |= EPOLLIN;
+        }
+        if (connection.pendingOutput() > 0) {
+            events |= EPOLLOUT;
+        }
+        if (events == 0) {
+            drop(connection);
+            return;
+        }
+        if (events != connection.events) {
+            struct epoll_event event;
+            event.events = events;
+            event.data.fd = connection.fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+            connection.events = events;
+        }
+
+        // Requests left waiting for the responses, now that they are sent
+        if ((events & EPOLLIN) && connection.inputEnd - connection.inputStart >= sizeof(ServerRequestHeader)) {
+            ServerRequestHeader header;
+            memcpy(&header, connection.input.data() + connection.inputStart, sizeof(header));
+            if (connection.inputEnd - connection.inputStart >= sizeof(header) + header.size) {
+                enqueue(connection);
+            }
+        }
+    }
+
+public:
+    // Constructor
+    WarehouseServer(Warehouse &warehouse, CommandScanner &scanner, const ScenarioSettings &settings,
+            const ServerSettings &server, ScenarioResult &result, ServerStats &stats)
+            : warehouse(warehouse), scanner(scanner), settings(settings), server(server), result(result),
+              stats(stats), listener(-1), epollFd(-1), numberConnections(0), results(NULL),
+              status(SCENARIO_DONE) {
+        results.retain();
+    }
+
+    // Destructor
+    ~WarehouseServer() {
+        for (size_t fd = 0; fd < connections.size(); fd++) {
+            if (connections[fd]) {
+                close((int) fd);
+            }
+        }
+        if (epollFd >= 0) {
+            close(epollFd);
+        }
+        if (listener >= 0) {
+            close(listener);
+            unlink(socketPath.c_str());
+        }
+    }
+
+    /**
+     * Binds the socket, replacing a socket file left by an earlier server.
+     *
+     * @return False if the socket could not be opened.
+     */
+    bool listen(const char *path) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            return false;
+        }
+        strcpy(address.sun_path, path);
+
+        struct stat info;
+        if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+            unlink(path);
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+        if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+            close(fd);
+            return false;
+        }
+        listener = fd;
+        socketPath = path;
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = listener;
+        return ::listen(listener, SOMAXCONN) == 0 && epollFd >= 0
+                && epoll_ctl(epollFd, EPOLL_CTL_ADD, listener, &event) == 0;
+    }
+
+    /**
+     * Serves the clients until StopServer() is called or a request goes
+     * over the memory limit.
+     *
+     * @param waitMask The signals blocked while waiting, the others are
+     * blocked the rest of the time, so StopServer() is only seen there.
+     */
+    ScenarioStatus run(const sigset_t &waitMask) {
+        struct epoll_event events[maxEvents];
+        std::vector<int> handled;
+
+        while (status == SCENARIO_DONE && !ServerStopFlag()) {
+            int count = epoll_pwait(epollFd, events, maxEvents, queue.empty() ? -1 : 0, &waitMask);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                return SCENARIO_FAILED;
+            }
+
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listener) {
+                    acceptAll();
+                    continue;
+                }
+                ServerConnection *connection = connections[fd].get();
+                if (connection == NULL) {
+                    continue;
+                }
+                if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !connection->closing) {
+                    receive(*connection);
+                }
+                enqueue(*connection);
+            }
+
+            // Every connection answers what it received, then takes new requests in the next round
+            handled.swap(queue);
+            for (size_t i = 0; i < handled.size(); i++) {
+                ServerConnection *connection = connections[handled[i]].get();
+                if (connection == NULL) {
+                    continue;
+                }
+                connection->queued = false;
+                handle(*connection);
+                if (send(*connection)) {
+                    update(*connection);
+                } else {
+                    drop(*connection);
+                }
+            }
+            handled.clear();
+        }
+        return status;
+    }
+};
+
+/**
+ * Loads a warehouse, from the map of robots.in or from a snapshot, and
+ * serves it on a Unix domain socket until SIGINT or SIGTERM; the commands
+ * of robots.in after the map are not run.
+ */
+inline ScenarioStatus RunServer(const char *inputPath, const char *socketPath, const ScenarioSettings &settings,
+        const ServerSettings &server, ScenarioResult &result, ServerStats &stats) {
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    result = ScenarioResult();
+    stats = ServerStats();
+
+    MappedFile inputFile;
+    CommandScanner scanner(NULL, 0);
+    int numberRobots = 0;
+    int numberRows = 0;
+    int numberColumns = 0;
+    int value = 0;
+    WarehouseOptions options = settings.warehouse;
+
+    SnapshotReader snapshot;
+    if (settings.restorePath != NULL) {
+        std::vector<std::string> checkpointNames;
+        if (!snapshot.open(settings.restorePath, settings.verifySnapshot)
+                || !snapshot.readNames(checkpointNames)) {
+            return SCENARIO_NO_SNAPSHOT;
+        }
+        scanner.addCheckpointNames(checkpointNames);
+        numberRobots = snapshot.getHeader().numberRobots;
+        numberRows = snapshot.getHeader().numberRows;
+        numberColumns = snapshot.getHeader().numberColumns;
+        options.priorityLevels = snapshot.getHeader().priorityLevels;
+    } else {
+        if (!inputFile.open(inputPath)) {
+            return SCENARIO_NO_INPUT;
+        }
+        scanner.reset(inputFile.data(), inputFile.size());
+        if (scanner.nextInt(numberRobots) && scanner.nextInt(numberRows)) {
+            scanner.nextInt(numberColumns);
+        }
+    }
+
+    ScenarioStatus dimensionsStatus = CheckDimensions(numberRobots, numberRows, numberColumns, options);
+    if (dimensionsStatus != SCENARIO_DONE) {
+        return dimensionsStatus;
+    }
+
+    Warehouse warehouse(numberRobots, numberRows, numberColumns, options);
+    if (settings.restorePath != NULL) {
+        if (!warehouse.RestoreSnapshot(snapshot)) {
+            return SCENARIO_NO_SNAPSHOT;
+        }
+        snapshot.close();
+    } else {
+        std::vector<int> row(numberColumns > 0 ? numberColumns : 0);
+        for (int i = 0; i < numberRows; i++) {
+            for (int j = 0; j < numberColumns; j++) {
+                scanner.nextInt(value);
+                row[j] = value;
+            }
+            warehouse.LoadMapRow(i, row.data());
+        }
+        warehouse.FinishLoading();
+        inputFile.close();
+    }
+
+    ScenarioStatus status;
+    {
+        WarehouseServer instance(warehouse, scanner, settings, server, result, stats);
+        if (!instance.listen(socketPath)) {
+            return SCENARIO_NO_SOCKET;
+        }
+
+        // SIGINT and SIGTERM only get in while the loop waits, so no request is cut in two
+        sigset_t stopSignals;
+        sigset_t previousMask;
+        sigemptyset(&stopSignals);
+        sigaddset(&stopSignals, SIGINT);
+        sigaddset(&stopSignals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask);
+        sigset_t waitMask = previousMask;
+        sigdelset(&waitMask, SIGINT);
+        sigdelset(&waitMask, SIGTERM);
+
+        struct sigaction stop;
+        struct sigaction previousInterrupt;
+        struct sigaction previousTerminate;
+        memset(&stop, 0, sizeof(stop));
+        stop.sa_handler = StopServer;
+        sigemptyset(&stop.sa_mask);
+        ServerStopFlag() = 0;
+        sigaction(SIGINT, &stop, &previousInterrupt);
+        sigaction(SIGTERM, &stop, &previousTerminate);
+
+        status = instance.run(waitMask);
+
+        sigaction(SIGINT, &previousInterrupt, NULL);
+        sigaction(SIGTERM, &previousTerminate, NULL);
+        pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+    }
+
+    CheckMemory(warehouse, settings, result);
+#ifdef WAREHOUSE_STATS
+    result.stats = warehouse.GetStats();
+#endif
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return status;
+}
+
+#endif // __SERVER_H__
@@ -0,0 +1,401 @@
+/**
+ * Binary snapshot of the whole state of a warehouse
+ * A header with the dimensions and a table of sections, then the
+ * sections, each starting on a page boundary: the map (rows padded to
+ * the stride of the warehouse, so it can be mapped as it is), the robots,
+ * their queues, the history, the checkpoints, the pending tasks and the
+ * checkpoint names of the stream, so a restored run gives them the same IDs
+ * A snapshot taken while logging also names the point of the command log
+ * it was taken at, so recovery only replays the log after it
+ * Every section and the header have a checksum
+ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CommandRecord.h"
+
+const char SNAPSHOT_MAGIC[4] = { 'R', 'B', 'S', 'N' };
+const uint32_t SNAPSHOT_VERSION = 4;
+
+// Sections start on multiples of this, a page on every usual system
+const uint64_t SNAPSHOT_ALIGNMENT = 4096;
+
+enum SnapshotSectionID {
+    SECTION_MAP,
+    SECTION_ROBOTS,
+    SECTION_QUEUES,
+    SECTION_HISTORY,
+    SECTION_CHECKPOINTS,
+    SECTION_PENDING,
+    SECTION_NAMES,              // an uint32 length and the characters of every name
+    SNAPSHOT_SECTIONS
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t numberRobots;
+    int32_t numberRows;
+    int32_t numberColumns;
+    int32_t priorityLevels;
+    uint32_t coordinateBits;        // WAREHOUSE_COORDINATE_BITS of the writer
+    uint32_t rowStride;
+    uint64_t numberCheckpoints;     // then checkpointStack entries, in SECTION_CHECKPOINTS
+    uint64_t checkpointStackSize;
+    uint64_t logID;                 // of the command log of the run, 0 without one (see CommandLog.h)
+    uint64_t logRecords;            // records of that log the snapshot already holds
+    uint64_t logSequence;           // position in the logged stream of the command after the SNAPSHOT
+    int64_t outputBytes;            // length of the output once the commands before were written, -1 if unknown
+    SnapshotSection sections[SNAPSHOT_SECTIONS];
+    uint64_t checksum;              // of the bytes above
+};
+
+// One robot of SECTION_ROBOTS, its commands follow those of the previous robots in SECTION_QUEUES
+struct SnapshotRobot {
+    int32_t numberBoxes;
+    int32_t positionX;
+    int32_t positionY;
+    int32_t numberCommands;
+    int64_t time;
+};
+
+// A queued command with its level, or a pending task with its priority
+struct SnapshotCommand {
+    int32_t level;
+    QueuedCommand command;
+};
+
+struct SnapshotCheckpoint {
+    int32_t checkpointID;
+    uint32_t serial;
+    int64_t depth;
+};
+
+static_assert(sizeof(SnapshotHeader) == 256, "SnapshotHeader must stay 256 bytes");
+static_assert(sizeof(SnapshotRobot) == 24, "SnapshotRobot must stay 24 bytes");
+static_assert(sizeof(SnapshotCommand) == 16, "SnapshotCommand must stay 16 bytes");
+
+/**
+ * FNV-1a over 64-bit words, fed in pieces of any length
+ * About one multiplication per 8 bytes, so checking a large map costs
+ * little more than reading it
+ */
+class SnapshotChecksum {
+private:
+    uint64_t hash;
+    uint64_t pending;           // the bytes of an incomplete word
+    int pendingBytes;
+
+    void mix(uint64_t word) {
+        hash = (hash ^ word) * 0x100000001B3ull;
+    }
+
+public:
+    SnapshotChecksum() : hash(0xCBF29CE484222325ull), pending(0), pendingBytes(0) {}
+
+    void update(const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char *) data;
+        while (size > 0) {
+            if (pendingBytes == 0 && size >= 8) {
+                for (; size >= 8; size -= 8, bytes += 8) {
+                    uint64_t word;
+                    memcpy(&word, bytes, 8);
+                    mix(word);
+                }
+                continue;
+            }
+
+            pending |= (uint64_t) *bytes++ << (8 * pendingBytes);
+            size--;
+            if (++pendingBytes == 8) {
+                mix(pending);
+                pending = 0;
+                pendingBytes = 0;
+            }
+        }
+    }
+
+    uint64_t value() const {
+        uint64_t last = hash;
+        if (pendingBytes > 0) {
+            last = (last ^ pending ^ ((uint64_t) pendingBytes << 56)) * 0x100000001B3ull;
+        }
+        return last;
+    }
+
+    static uint64_t of(const void *data, size_t size) {
+        SnapshotChecksum checksum;
+        checksum.update(data, size);
+        return checksum.value();
+    }
+};
+
+/**
+ * Writes the sections one after the other, keeping their offsets,
+ * sizes and checksums for the header written at the end
+ */
+class SnapshotWriter {
+private:
+    FILE *file;
+    uint64_t position;
+    bool failed;
+    int current;
+    SnapshotChecksum checksum;
+    SnapshotHeader header;
+
+    SnapshotWriter(const SnapshotWriter &);
+    SnapshotWriter &operator=(const SnapshotWriter &);
+
+    void pad() {
+        static const char zeros[256] = { 0 };
+        while (position % SNAPSHOT_ALIGNMENT != 0) {
+            size_t length = SNAPSHOT_ALIGNMENT - position % SNAPSHOT_ALIGNMENT;
+            length = length < sizeof(zeros) ? length : sizeof(zeros);
+            rawWrite(zeros, length);
+        }
+    }
+
+    void rawWrite(const void *data, size_t size) {
+        if (!failed && size > 0 && fwrite(data, 1, size, file) != size) {
+            failed = true;
+        }
+        position += size;
+    }
+
+public:
+    SnapshotWriter() : file(NULL), position(0), failed(false), current(-1) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.coordinateBits = WAREHOUSE_COORDINATE_BITS;
+    }
+
+    ~SnapshotWriter() {
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+
+    bool open(const char *path) {
+        file = fopen(path, "wb");
+        if (file == NULL) {
+            return false;
+        }
+        // Room for the header, written last
+        rawWrite(&header, sizeof(header));
+        return !failed;
+    }
+
+    // The dimensions and counts of the header, filled in by the warehouse
+    SnapshotHeader &getHeader() {
+        return header;
+    }
+
+    void beginSection(SnapshotSectionID section) {
+        pad();
+        current = section;
+        checksum = SnapshotChecksum();
+        header.sections[section].offset = position;
+    }
+
+    void write(const void *data, size_t size) {
+        checksum.update(data, size);
+        rawWrite(data, size);
+    }
+
+    void writeName(const std::string &name) {
+        uint32_t length = (uint32_t) name.size();
+        write(&length, sizeof(length));
+        write(name.data(), length);
+    }
+
+    void endSection() {
+        header.sections[current].size = position - header.sections[current].offset;
+        header.sections[current].checksum = checksum.value();
+    }
+
+    /**
+     * Writes the header and closes the file.
+     *
+     * @return False if anything could not be written.
+     */
+    bool finish() {
+        header.checksum = SnapshotChecksum::of(&header, offsetof(SnapshotHeader, checksum));
+        if (!failed && (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1)) {
+            failed = true;
+        }
+        if (fclose(file) != 0) {
+            failed = true;
+        }
+        file = NULL;
+        return !failed;
+    }
+};
+
+/**
+ * Memory mapped snapshot, checked when it is opened
+ * The sections are read in place; the map can also be mapped on its own,
+ * privately, so the warehouse can use and change it without a copy
+ */
+class SnapshotReader {
+private:
+    int fd;
+    const char *contents;
+    size_t length;
+    const SnapshotHeader *header;
+
+    SnapshotReader(const SnapshotReader &);
+    SnapshotReader &operator=(const SnapshotReader &);
+
+    bool sectionFits(int section) const {
+        const SnapshotSection &s = header->sections[section];
+        return s.offset % SNAPSHOT_ALIGNMENT == 0 && s.offset <= length && s.size <= length - s.offset;
+    }
+
+    bool sectionMatches(int section) const {
+        const SnapshotSection &s = header->sections[section];
+        return SnapshotChecksum::of(contents + s.offset, s.size) == s.checksum;
+    }
+
+public:
+    SnapshotReader() : fd(-1), contents(NULL), length(0), header(NULL) {}
+
+    ~SnapshotReader() {
+        close();
+    }
+
+    /**
+     * Maps a snapshot and checks its header and its sections.
+     *
+     * @param verifyMap Also checks the map against its checksum, which
+     * reads all of it; without it only the pages that are used get read.
+     * @return True if the snapshot is valid, False otherwise.
+     */
+    bool open(const char *path, bool verifyMap = true) {
+        close();
+        fd = ::open(path, O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(SnapshotHeader)) {
+            close();
+            return false;
+        }
+
+        void *address = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            close();
+            return false;
+        }
+        contents = (const char *) address;
+        length = info.st_size;
+        header = (const SnapshotHeader *) contents;
+
+        bool valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+                && header->version == SNAPSHOT_VERSION
+                && header->checksum == SnapshotChecksum::of(header, offsetof(SnapshotHeader, checksum))
+                && header->coordinateBits == WAREHOUSE_COORDINATE_BITS
+                && header->numberRobots >= 0 && header->numberRows >= 0 && header->numberColumns >= 0
+                && header->rowStride >= (uint32_t) header->numberColumns
+                && sectionSize(SECTION_MAP) == (uint64_t) header->numberRows * header->rowStride * sizeof(int32_t)
+                && sectionSize(SECTION_ROBOTS) == (uint64_t) header->numberRobots * sizeof(SnapshotRobot)
+                && sectionSize(SECTION_QUEUES) % sizeof(SnapshotCommand) == 0
+                && sectionSize(SECTION_HISTORY) % sizeof(HistoryRecord) == 0
+                && sectionSize(SECTION_CHECKPOINTS) == (header->numberCheckpoints + header->checkpointStackSize)
+                        * sizeof(SnapshotCheckpoint)
+                && sectionSize(SECTION_PENDING) % sizeof(SnapshotCommand) == 0;
+        for (int section = 0; valid && section < SNAPSHOT_SECTIONS; section++) {
+            valid = sectionFits(section) && ((section == SECTION_MAP && !verifyMap) || sectionMatches(section));
+        }
+
+        if (!valid) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (contents != NULL) {
+            munmap((void *) contents, length);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+        contents = NULL;
+        length = 0;
+        header = NULL;
+    }
+
+    /**
+     * Maps the map section on its own, copy on write; the caller owns the
+     * mapping and unmaps it with munmap(address, sectionSize(SECTION_MAP)).
+     *
+     * @return NULL if it could not be mapped.
+     */
+    int *mapCells() const {
+        if (sectionSize(SECTION_MAP) == 0) {
+            return NULL;
+        }
+        void *address = mmap(NULL, sectionSize(SECTION_MAP), PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                fd, header->sections[SECTION_MAP].offset);
+        return address == MAP_FAILED ? NULL : (int *) address;
+    }
+
+    /**
+     * Reads the names of SECTION_NAMES.
+     *
+     * @return False if the section is malformed.
+     */
+    bool readNames(std::vector<std::string> &names) const {
+        const char *position = (const char *) sectionData(SECTION_NAMES);
+        const char *end = position + sectionSize(SECTION_NAMES);
+        names.clear();
+        while (position != end) {
+            uint32_t length;
+            if ((size_t) (end - position) < sizeof(length)) {
+                return false;
+            }
+            memcpy(&length, position, sizeof(length));
+            position += sizeof(length);
+            if ((size_t) (end - position) < length) {
+                return false;
+            }
+            names.push_back(std::string(position, length));
+            position += length;
+        }
+        return true;
+    }
+
+    // Getters & Setters
+    const SnapshotHeader &getHeader() const {
+        return *header;
+    }
+
+    uint64_t sectionSize(SnapshotSectionID section) const {
+        return header->sections[section].size;
+    }
+
+    const void *sectionData(SnapshotSectionID section) const {
+        return contents + header->sections[section].offset;
+    }
+};
+
+#endif // __SNAPSHOT_H__
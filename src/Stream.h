@@ -0,0 +1,378 @@
+/**
+ * Streaming mode: robots.in read from a pipe, a FIFO or stdin as it
+ * arrives, and the results flushed as they are produced
+ * The input goes through one fixed buffer and the commands are run a
+ * batch at a time, so the memory does not grow with the stream. The
+ * results are flushed after a number of commands, after a delay, and
+ * every time the input has nothing more for now
+ */
+
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CommandLog.h"
+#include "CommandParser.h"
+#include "Scenario.h"
+
+struct StreamSettings {
+    size_t bufferSize;          // bytes of input buffered, the longest line that is kept whole
+    long flushCommands;         // commands run before the results are flushed
+    int flushMilliseconds;      // longest a result waits for the flush, while the input keeps coming
+
+    StreamSettings() : bufferSize(1 << 16), flushCommands(256), flushMilliseconds(10) {}
+};
+
+/**
+ * Histogram of latencies with 8 buckets for every power of two of
+ * nanoseconds, so a percentile is known to within 12.5%
+ */
+class LatencyHistogram {
+private:
+    static const int subBuckets = 8;
+    static const int numberBuckets = 64 * subBuckets;
+
+    long long counts[numberBuckets];
+    long long total;
+    uint64_t maximum;
+
+    static int bucketOf(uint64_t nanoseconds) {
+        if (nanoseconds < (uint64_t) subBuckets) {
+            return (int) nanoseconds;
+        }
+        int power = 63 - __builtin_clzll(nanoseconds);
+        int fraction = (int) (nanoseconds >> (power - 3)) & (subBuckets - 1);
+        return (power - 2) * subBuckets + fraction;
+    }
+
+    // Highest latency of a bucket
+    static uint64_t upperBound(int bucket) {
+        if (bucket < subBuckets) {
+            return bucket;
+        }
+        int power = bucket / subBuckets + 2;
+        uint64_t fraction = bucket % subBuckets;
+        return ((subBuckets + fraction + 1) << (power - 3)) - 1;
+    }
+
+public:
+    LatencyHistogram() : total(0), maximum(0) {
+        memset(counts, 0, sizeof(counts));
+    }
+
+    void add(uint64_t nanoseconds, long long count = 1) {
+        counts[bucketOf(nanoseconds)] += count;
+        total += count;
+        if (nanoseconds > maximum) {
+            maximum = nanoseconds;
+        }
+    }
+
+    // Latency under which the given fraction of the samples stay
+    uint64_t percentile(double fraction) const {
+        long long rank = (long long) (fraction * total);
+        long long seen = 0;
+        for (int b = 0; b < numberBuckets; b++) {
+            seen += counts[b];
+            if (seen > rank) {
+                return upperBound(b) < maximum ? upperBound(b) : maximum;
+            }
+        }
+        return maximum;
+    }
+
+    long long getTotal() const {
+        return total;
+    }
+
+    uint64_t getMaximum() const {
+        return maximum;
+    }
+};
+
+/**
+ * Fixed buffer over a file descriptor that may only have part of the
+ * stream yet; remembers when every read arrived
+ */
+class StreamInput {
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_t start;               // first byte not consumed
+    size_t end;                 // end of the bytes read
+    uint64_t consumedOffset;    // offset in the stream of start
+    bool finished;              // the end of the stream was read
+
+    // The offset in the stream after each read still in the buffer, and when it arrived
+    std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point> > reads;
+
+    static bool isSpace(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+public:
+    StreamInput(int fd, size_t bufferSize)
+            : fd(fd), buffer(bufferSize > 0 ? bufferSize : 1), start(0), end(0), consumedOffset(0),
+              finished(false) {}
+
+    /**
+     * Reads what the stream has, waiting for it if it has nothing yet.
+     *
+     * @return False at the end of the stream, or if it can not be read.
+     */
+    bool fill() {
+        if (finished) {
+            return false;
+        }
+        if (start > 0) {
+            memmove(buffer.data(), buffer.data() + start, end - start);
+            end -= start;
+            start = 0;
+        }
+        if (end == buffer.size()) {
+            return true;
+        }
+
+        ssize_t count;
+        do {
+            count = read(fd, buffer.data() + end, buffer.size() - end);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) {
+            finished = true;
+            return false;
+        }
+        end += count;
+        reads.push_back(std::make_pair(consumedOffset + end, std::chrono::steady_clock::now()));
+        return true;
+    }
+
+    // Whether a read would return at once
+    bool ready() const {
+        if (finished) {
+            return true;
+        }
+        struct pollfd request = { fd, POLLIN, 0 };
+        return poll(&request, 1, 0) > 0;
+    }
+
+    /**
+     * The bytes buffered up to the end of the last whole token, or of the
+     * last whole line with lines; everything once the stream has ended,
+     * and everything as well if the buffer is full of one token.
+     */
+    void complete(bool lines, const char *&data, size_t &size) const {
+        size_t last = end;
+        if (!finished) {
+            while (last > start && (lines ? buffer[last - 1] != '\n' : !isSpace(buffer[last - 1]))) {
+                last--;
+            }
+            if (last == start && lines && end - start == buffer.size()) {
+                complete(false, data, size);
+                return;
+            }
+            if (last == start && end - start == buffer.size()) {
+                last = end;
+            }
+        }
+        data = buffer.data() + start;
+        size = last - start;
+    }
+
+    void consume(const char *position) {
+        size_t count = position - (buffer.data() + start);
+        start += count;
+        consumedOffset += count;
+        while (reads.size() > 1 && reads.front().first <= consumedOffset) {
+            reads.pop_front();
+        }
+    }
+
+    /**
+     * When the byte before the given one arrived; every byte before it
+     * is consumed or will not be asked for again.
+     */
+    std::chrono::steady_clock::time_point arrivalOf(const char *position) {
+        uint64_t offset = consumedOffset + (position - (buffer.data() + start));
+        while (reads.size() > 1 && reads.front().first < offset) {
+            reads.pop_front();
+        }
+        return reads.front().second;
+    }
+
+    bool isFinished() const {
+        return finished && start == end;
+    }
+};
+
+/**
+ * Runs a stream on a new warehouse, the map first unless it restores a
+ * snapshot, then the commands a batch at a time.
+ *
+ * @param latencies Gets, for every command, the time from the arrival of
+ * its line to the flush of the results that followed it.
+ */
+inline ScenarioStatus RunStream(int inputFd, FILE *outputFile, const ScenarioSettings &settings,
+        const StreamSettings &stream, ScenarioResult &result, LatencyHistogram &latencies) {
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    result = ScenarioResult();
+
+    StreamInput input(inputFd, stream.bufferSize);
+    CommandScanner scanner(NULL, 0);
+    const char *data;
+    size_t size;
+
+    /*
+    Reads the numbers before the commands, N ROW COL and the map, a whole
+    token at a time; a malformed one stops them all, as in RunText
+    */
+    int value = 0;
+    bool malformed = false;
+    auto readInts = [&](int *values, long long count) -> long long {
+        long long numberRead = 0;
+        while (numberRead < count && !malformed) {
+            input.complete(false, data, size);
+            scanner.reset(data, size);
+            while (numberRead < count && scanner.nextInt(value)) {
+                values[numberRead++] = value;
+            }
+            malformed = numberRead < count && scanner.getPosition() != data + size;
+            input.consume(scanner.getPosition());
+            if (numberRead < count && !malformed && !input.fill() && input.isFinished()) {
+                break;
+            }
+        }
+        return numberRead;
+    };
+
+    int dimensions[3] = { 0, 0, 0 };
+    WarehouseOptions options = settings.warehouse;
+    SnapshotReader snapshot;
+    if (settings.restorePath != NULL) {
+        std::vector<std::string> checkpointNames;
+        if (!snapshot.open(settings.restorePath, settings.verifySnapshot)
+                || !snapshot.readNames(checkpointNames)) {
+            return SCENARIO_NO_SNAPSHOT;
+        }
+        scanner.addCheckpointNames(checkpointNames);
+        dimensions[0] = snapshot.getHeader().numberRobots;
+        dimensions[1] = snapshot.getHeader().numberRows;
+        dimensions[2] = snapshot.getHeader().numberColumns;
+        options.priorityLevels = snapshot.getHeader().priorityLevels;
+    } else if (readInts(dimensions, 3) < 3) {
+        dimensions[2] = 0;
+    }
+    int numberRows = dimensions[1];
+    int numberColumns = dimensions[2];
+    ScenarioStatus dimensionsStatus = CheckDimensions(dimensions[0], numberRows, numberColumns, options);
+    if (dimensionsStatus != SCENARIO_DONE) {
+        return dimensionsStatus;
+    }
+
+    OutputBuffer output(outputFile, 1 << 16);
+    OutputBuffer discarded(NULL);
+    Warehouse warehouse(dimensions[0], numberRows, numberColumns, options);
+    if (settings.restorePath != NULL) {
+        if (!warehouse.RestoreSnapshot(snapshot)) {
+            return SCENARIO_NO_SNAPSHOT;
+        }
+        snapshot.close();
+    } else {
+        // One row at a time, the values that are missing keep the last one read
+        std::vector<int> row(numberColumns > 0 ? numberColumns : 0);
+        for (int i = 0; i < numberRows; i++) {
+            for (long long j = readInts(row.data(), numberColumns); j < numberColumns; j++) {
+                row[j] = value;
+            }
+            warehouse.LoadMapRow(i, row.data());
+        }
+        warehouse.FinishLoading();
+    }
+
+    std::unique_ptr<CommandLog> log;
+    if (settings.logPath != NULL) {
+        log.reset(new CommandLog(settings.logGroupSize, settings.logWindowMilliseconds));
+        if (!log->create(settings.logPath)) {
+            return SCENARIO_NO_LOG;
+        }
+        warehouse.AttachLog(log.get());
+    }
+    std::unique_ptr<ParallelRunner> runner;
+    if (settings.numberThreads > 1) {
+        runner.reset(new ParallelRunner(warehouse, scanner.getNames(), settings.numberThreads));
+    }
+
+    // The commands run since the last flush, with the arrival of each one
+    long maxBatch = stream.flushCommands > 0 ? stream.flushCommands : 1;
+    std::vector<Command> batch;
+    batch.reserve(maxBatch);
+    std::vector<std::chrono::steady_clock::time_point> unflushed;
+    unflushed.reserve(maxBatch);
+    std::chrono::steady_clock::duration maxDelay = std::chrono::milliseconds(stream.flushMilliseconds);
+
+    Command command;
+    memset(&command, 0, sizeof(command));
+    ScenarioStatus status = SCENARIO_DONE;
+    while (status == SCENARIO_DONE) {
+        input.complete(true, data, size);
+        scanner.reset(data, size);
+        while ((long) (unflushed.size() + batch.size()) < maxBatch && scanner.nextCommand(command)) {
+            batch.push_back(command);
+            unflushed.push_back(input.arrivalOf(scanner.getPosition()));
+        }
+        input.consume(scanner.getPosition());
+
+        if (!batch.empty()) {
+            status = RunCommands(warehouse, batch.data(), batch.size(), scanner.getNames(), settings,
+                    runner.get(), log.get(), output, discarded, result);
+            batch.clear();
+        }
+
+        // Flushed when enough commands ran, when the oldest waited long enough, or before waiting for more
+        bool idle = !input.ready();
+        if (!unflushed.empty() && ((long) unflushed.size() >= maxBatch || idle || input.isFinished()
+                || std::chrono::steady_clock::now() - unflushed.front() >= maxDelay)) {
+            output.flush();
+            fflush(outputFile);
+            std::chrono::steady_clock::time_point flushed = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < unflushed.size(); i++) {
+                latencies.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        flushed - unflushed[i]).count());
+            }
+            unflushed.clear();
+        }
+        if (idle && log && log->hasPending()) {
+            log->commit();
+        }
+
+        input.complete(true, data, size);
+        if (size == 0 && !input.fill() && input.isFinished()) {
+            break;
+        }
+    }
+
+    if (log && !log->close() && status == SCENARIO_DONE) {
+        status = SCENARIO_NO_LOG;
+    }
+    warehouse.AttachLog(NULL);
+
+    CheckMemory(warehouse, settings, result);
+#ifdef WAREHOUSE_STATS
+    result.stats = warehouse.GetStats();
+#endif
+    output.flush();
+    fflush(outputFile);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return status;
+}
+
+#endif // __STREAM_H__
@@ -0,0 +1,67 @@
+/**
+ * A fixed set of spin locks shared by many keys
+ * A key always maps to the same lock, so two threads only wait for each
+ * other when their keys fall on the same stripe
+ */
+
+#ifndef __STRIPEDLOCK_H__
+#define __STRIPEDLOCK_H__
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+class StripedLock {
+private:
+    // One lock per cache line, so neighbouring stripes do not slow each other down
+    struct Stripe {
+        std::atomic_flag locked;
+        char padding[64 - sizeof(std::atomic_flag)];
+    };
+
+    int stripeBits;
+    Stripe *stripes;
+
+    StripedLock(const StripedLock &);
+    StripedLock &operator=(const StripedLock &);
+
+    // Fibonacci hashing, neighbouring keys land on different stripes
+    Stripe &stripeFor(uint64_t key) {
+        return stripes[(key * 0x9E3779B97F4A7C15ull) >> (64 - stripeBits)];
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param stripeBits There are 2^stripeBits locks.
+     */
+    explicit StripedLock(int stripeBits = 10) : stripeBits(stripeBits) {
+        stripes = new Stripe[1 << stripeBits];
+        for (int i = 0; i < (1 << stripeBits); i++) {
+            stripes[i].locked.clear();
+        }
+    }
+
+    // Destructor
+    ~StripedLock() {
+        delete[] stripes;
+    }
+
+    void lock(uint64_t key) {
+        Stripe &stripe = stripeFor(key);
+        while (stripe.locked.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock(uint64_t key) {
+        stripeFor(key).locked.clear(std::memory_order_release);
+    }
+
+    int size() const {
+        return 1 << stripeBits;
+    }
+};
+
+#endif // __STRIPEDLOCK_H__
@@ -0,0 +1,306 @@
+/**
+ * Assignment of pending tasks to robots
+ *
+ * A robot can take any number of tasks. Giving a task to a robot costs
+ * the travel from the robot to the task, plus queueWeight for every
+ * command the robot already has to do before it, so the k-th new task
+ * of a robot with q queued commands costs travel + queueWeight * (q + k).
+ * OptimalAssignment finds the assignment with the smallest total cost;
+ * GreedyAssignment gives every task in turn to the robot that is the
+ * cheapest at that moment, and is only kept as a baseline
+ *
+ * Both take travel(robot, task), the travel cost, -1 if the robot can
+ * not reach the task; such a task is left unassigned (-1)
+ */
+
+#ifndef __TASKASSIGNMENT_H__
+#define __TASKASSIGNMENT_H__
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Largest number of heap entries (tasks * robots) of one TaskAssigner
+const long ASSIGN_MAX_ENTRIES = 1L << 24;
+
+// Tasks in one part of OptimalAssignment
+inline int AssignPartSize(int numberRobots) {
+    return (int) std::max(1L, ASSIGN_MAX_ENTRIES / std::max(1L, (long) numberRobots));
+}
+
+/**
+ * Min-cost assignment with shortest augmenting paths, as in the Hungarian
+ * algorithm: the tasks are added one at a time, and every new task
+ * follows the cheapest path from it to a free place, which may move
+ * tasks that are already assigned from one robot to another
+ *
+ * The path only goes through robots: moving from robot u to robot v
+ * costs the cheapest change of travel of a task of u moved to v, and
+ * ending at robot v costs its next queue cost. Every pair (u, v) keeps a
+ * heap of the tasks of u by that change, entries of tasks that left u
+ * being dropped when they reach the top. The heaps of u are only made
+ * once a path goes through u, and a task that reaches u only joins them
+ * then, so robots that end paths without passing tasks on, most of them
+ * in a large batch, never have any. Dijkstra runs on costs made
+ * non-negative by the potentials of the robots, and stops as soon as the
+ * end of the path is known, so a task that simply goes to its cheapest
+ * robot costs O(robots)
+ */
+template <typename Travel>
+class TaskAssigner {
+private:
+    typedef std::pair<int, int> Move;       // (change of travel, task)
+
+    int numberRobots;
+    long long queueWeight;
+    Travel &travel;
+    const long long infinite;
+
+    std::vector<long long> queueCost;       // of the next task of every robot
+    std::vector<int> robotOf;
+    std::vector<std::vector<std::vector<Move> > > moves;  // min-heap of the pair (u, v) at [u][v], none until u is explored with tasks
+    std::vector<std::vector<int> > arrived; // tasks placed on u that are not in its heaps yet
+    std::vector<long long> potential;       // of every robot, then of the end of the paths
+    std::vector<int> travelTo;              // of the task being added
+
+    // Scratch of Dijkstra
+    std::vector<long long> distance;
+    std::vector<int> previous;              // -1 if reached straight from the task
+    std::vector<int> movedTask;             // task moved to the robot on the path
+    std::vector<char> done;
+
+    // The cheapest move of a task from u to v, false if u has none; u was explored
+    bool cheapestMove(int u, int v, Move &move) {
+        std::vector<Move> &heap = moves[u][v];
+        while (!heap.empty() && robotOf[heap[0].second] != u) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Move>());
+            heap.pop_back();
+        }
+        if (heap.empty()) {
+            return false;
+        }
+        move = heap[0];
+        return true;
+    }
+
+    // The task is now done by robot u
+    void place(int task, int u) {
+        robotOf[task] = u;
+        arrived[u].push_back(task);
+    }
+
+    // Puts the tasks that reached u since a path last went through it in its heaps
+    void explore(int u) {
+        if (arrived[u].empty()) {
+            return;
+        }
+        if (moves[u].empty()) {
+            moves[u].resize(numberRobots);
+        }
+        for (size_t i = 0; i < arrived[u].size(); i++) {
+            int task = arrived[u][i];
+            if (robotOf[task] != u) {
+                continue;   // it went on to another robot
+            }
+            int from = travel(u, task);
+            for (int v = 0; v < numberRobots; v++) {
+                int to = v == u ? -1 : travel(v, task);
+                if (to >= 0) {
+                    std::vector<Move> &heap = moves[u][v];
+                    heap.push_back(Move(to - from, task));
+                    std::push_heap(heap.begin(), heap.end(), std::greater<Move>());
+                }
+            }
+        }
+        arrived[u].clear();
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param queueLengths The commands every robot has queued.
+     */
+    TaskAssigner(int numberTasks, const std::vector<int> &queueLengths, int queueWeight,
+            Travel &travel)
+            : numberRobots((int) queueLengths.size()), queueWeight(queueWeight), travel(travel),
+              infinite(std::numeric_limits<long long>::max() / 4),
+              robotOf(numberTasks, -1), moves(numberRobots), arrived(numberRobots),
+              potential(numberRobots + 1, 0), travelTo(numberRobots),
+              distance(numberRobots + 1), previous(numberRobots), movedTask(numberRobots),
+              done(numberRobots) {
+        for (int r = 0; r < numberRobots; r++) {
+            queueCost.push_back(this->queueWeight * queueLengths[r]);
+        }
+    }
+
+    /**
+     * Adds a task, the assignment of the tasks added so far stays optimal.
+     *
+     * @return False if no robot can reach the task.
+     */
+    bool add(int task) {
+        const int end = numberRobots;
+
+        // The task can go straight to any robot that reaches it
+        long long source = -infinite;
+        for (int r = 0; r < numberRobots; r++) {
+            travelTo[r] = travel(r, task);
+            if (travelTo[r] >= 0) {
+                source = std::max(source, potential[r] - travelTo[r]);
+            }
+        }
+        if (source == -infinite) {
+            return false;
+        }
+        for (int r = 0; r < numberRobots; r++) {
+            distance[r] = travelTo[r] >= 0 ? travelTo[r] + source - potential[r] : infinite;
+            previous[r] = -1;
+            done[r] = 0;
+        }
+        distance[end] = infinite;
+        int last = -1;
+
+        while (true) {
+            int u = -1;
+            for (int r = 0; r < numberRobots; r++) {
+                if (!done[r] && (u < 0 || distance[r] < distance[u])) {
+                    u = r;
+                }
+            }
+            if (u < 0 || distance[u] >= distance[end]) {
+                break;
+            }
+            done[u] = 1;
+
+            long long ending = distance[u] + queueCost[u] + potential[u] - potential[end];
+            if (ending < distance[end]) {
+                distance[end] = ending;
+                last = u;
+            }
+
+            explore(u);
+            if (moves[u].empty()) {
+                continue;   // u holds no task to pass on
+            }
+            for (int v = 0; v < numberRobots; v++) {
+                Move move;
+                if (done[v] || !cheapestMove(u, v, move)) {
+                    continue;
+                }
+                long long through = distance[u] + move.first + potential[u] - potential[v];
+                if (through < distance[v]) {
+                    distance[v] = through;
+                    previous[v] = u;
+                    movedTask[v] = move.second;
+                }
+            }
+        }
+
+        // Robots farther than the end of the path keep their costs non-negative with its length
+        for (int r = 0; r < numberRobots; r++) {
+            potential[r] += std::min(distance[r], distance[end]);
+        }
+        potential[end] += distance[end];
+
+        // Walk the path back, every robot on it passes a task to the next one
+        queueCost[last] += queueWeight;
+        int v = last;
+        while (previous[v] >= 0) {
+            place(movedTask[v], v);
+            v = previous[v];
+        }
+        place(task, v);
+        return true;
+    }
+
+    // The robot of a task, -1 if it was not added
+    int robot(int task) const {
+        return robotOf[task];
+    }
+};
+
+/**
+ * Optimal assignment, see TaskAssigner. A batch with more than
+ * ASSIGN_MAX_ENTRIES tasks * robots is assigned in consecutive parts,
+ * each part optimal given the ones before it.
+ *
+ * @param queueLengths The commands every robot has queued.
+ */
+template <typename Travel>
+void OptimalAssignment(int numberTasks, const std::vector<int> &queueLengths, int queueWeight,
+        Travel travel, std::vector<int> &assigned) {
+    assigned.assign(numberTasks, -1);
+    if (queueLengths.empty()) {
+        return;
+    }
+
+    int partSize = AssignPartSize((int) queueLengths.size());
+    std::vector<int> lengths(queueLengths);
+    for (int first = 0; first < numberTasks; first += partSize) {
+        int count = std::min(partSize, numberTasks - first);
+        auto partTravel = [&travel, first](int robot, int task) {
+            return travel(robot, first + task);
+        };
+
+        TaskAssigner<decltype(partTravel)> assigner(count, lengths, queueWeight, partTravel);
+        for (int task = 0; task < count; task++) {
+            assigner.add(task);
+        }
+        for (int task = 0; task < count; task++) {
+            assigned[first + task] = assigner.robot(task);
+            if (assigned[first + task] >= 0) {
+                lengths[assigned[first + task]]++;
+            }
+        }
+    }
+}
+
+/**
+ * Every task in turn goes to the robot that is the cheapest for it.
+ */
+template <typename Travel>
+void GreedyAssignment(int numberTasks, const std::vector<int> &queueLengths, int queueWeight,
+        Travel travel, std::vector<int> &assigned) {
+    std::vector<long long> load(queueLengths.begin(), queueLengths.end());
+    assigned.assign(numberTasks, -1);
+
+    for (int task = 0; task < numberTasks; task++) {
+        long long best = 0;
+        for (int robot = 0; robot < (int) load.size(); robot++) {
+            int cost = travel(robot, task);
+            if (cost < 0) {
+                continue;
+            }
+            long long value = cost + queueWeight * load[robot];
+            if (assigned[task] < 0 || value < best) {
+                best = value;
+                assigned[task] = robot;
+            }
+        }
+        if (assigned[task] >= 0) {
+            load[assigned[task]]++;
+        }
+    }
+}
+
+/**
+ * Total cost of an assignment, travel plus the queue cost of every task.
+ */
+template <typename Travel>
+long long AssignmentCost(const std::vector<int> &assigned, const std::vector<int> &queueLengths,
+        int queueWeight, Travel travel) {
+    std::vector<long long> load(queueLengths.begin(), queueLengths.end());
+    long long cost = 0;
+    for (size_t task = 0; task < assigned.size(); task++) {
+        int robot = assigned[task];
+        if (robot >= 0) {
+            cost += travel(robot, (int) task) + queueWeight * load[robot]++;
+        }
+    }
+    return cost;
+}
+
+#endif // __TASKASSIGNMENT_H__
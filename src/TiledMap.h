@@ -0,0 +1,223 @@
+/**
+ * Sparse map of the warehouse, in fixed-size square tiles
+ * Every tile starts as one shared tile of zeros and only gets its own
+ * cells the first time one of them is set to something other than 0,
+ * so a map with boxes in few places only holds the tiles around them.
+ * A read is two loads, the tile from the directory then the cell
+ *
+ * On 8192 x 8192 maps (bench/map_bench), boxes in clusters over 1% of
+ * the cells took 4% of the memory of the dense map, with faster random
+ * reads since the tiles in use stay in the cache; over 10%, a third of
+ * it, with reads of about 15 ns instead of 12. Boxes spread evenly put
+ * one in almost every tile, so MAP_AUTO makes a mostly used map dense
+ */
+
+#ifndef __TILEDMAP_H__
+#define __TILEDMAP_H__
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <memory>
+#include <new>
+#include <vector>
+
+// A tile holds 2^MAP_TILE_BITS x 2^MAP_TILE_BITS cells
+const int MAP_TILE_BITS = 6;
+
+class TiledMap {
+private:
+    static const int tileSide = 1 << MAP_TILE_BITS;
+    static const int tileMask = tileSide - 1;
+    static const size_t tileCells = (size_t) tileSide * tileSide;
+
+    int numberRows;
+    int numberColumns;
+    int tileRows;
+    int tileColumns;
+    /**
+        The tile of every block of cells, row by row; the blocks never
+        set hold the zero tile. Atomic so ExecuteConcurrent() can give
+        a block its tile while other threads read the map
+    */
+    std::unique_ptr<std::atomic<int *>[]> tiles;
+    std::vector<int> zeroTile;
+    std::atomic<size_t> numberTiles;    // tiles with their own cells
+
+    TiledMap(const TiledMap &);
+    TiledMap &operator=(const TiledMap &);
+
+    std::atomic<int *> &tileOf(int x, int y) const {
+        return tiles[(size_t) (x >> MAP_TILE_BITS) * tileColumns + (y >> MAP_TILE_BITS)];
+    }
+
+    // The tile of a block with its own cells, given to it the first time
+    int *writableTile(std::atomic<int *> &slot) {
+        int *tile = slot.load(std::memory_order_acquire);
+        if (tile != zeroTile.data()) {
+            return tile;
+        }
+
+        int *created = (int *) calloc(tileCells, sizeof(int));
+        if (created == NULL) {
+            throw std::bad_alloc();
+        }
+        // Another thread may have given the block a tile meanwhile, that one is kept
+        if (slot.compare_exchange_strong(tile, created, std::memory_order_acq_rel)) {
+            numberTiles++;
+            return created;
+        }
+        free(created);
+        return tile;
+    }
+
+public:
+    // Constructor
+    TiledMap(int numberRows, int numberColumns)
+            : numberRows(numberRows), numberColumns(numberColumns),
+              tileRows((numberRows + tileMask) >> MAP_TILE_BITS),
+              tileColumns((numberColumns + tileMask) >> MAP_TILE_BITS),
+              zeroTile(tileCells, 0), numberTiles(0) {
+        size_t numberBlocks = (size_t) tileRows * tileColumns;
+        tiles.reset(new std::atomic<int *>[numberBlocks > 0 ? numberBlocks : 1]);
+        for (size_t i = 0; i < numberBlocks; i++) {
+            tiles[i].store(zeroTile.data(), std::memory_order_relaxed);
+        }
+    }
+
+    // Destructor
+    ~TiledMap() {
+        for (size_t i = 0; i < (size_t) tileRows * tileColumns; i++) {
+            int *tile = tiles[i].load(std::memory_order_relaxed);
+            if (tile != zeroTile.data()) {
+                free(tile);
+            }
+        }
+    }
+
+    int get(int x, int y) const {
+        const int *tile = tileOf(x, y).load(std::memory_order_acquire);
+        return tile[(x & tileMask) << MAP_TILE_BITS | (y & tileMask)];
+    }
+
+    /**
+     * Sets a cell, giving its block a tile unless a 0 goes to the zero tile.
+     * Threads may set cells of the same block, as long as not the same cell.
+     */
+    void set(int x, int y, int value) {
+        std::atomic<int *> &slot = tileOf(x, y);
+        if (value == 0 && slot.load(std::memory_order_acquire) == zeroTile.data()) {
+            return;
+        }
+        writableTile(slot)[(x & tileMask) << MAP_TILE_BITS | (y & tileMask)] = value;
+    }
+
+    /**
+     * Fills a whole row, the blocks it only has zeros for keeping the
+     * zero tile.
+     *
+     * @param values numberColumns values for the cells of the row
+     */
+    void loadRow(int x, const int *values) {
+        int offset = (x & tileMask) << MAP_TILE_BITS;
+        for (int first = 0; first < numberColumns; first += tileSide) {
+            int count = numberColumns - first < tileSide ? numberColumns - first : tileSide;
+            std::atomic<int *> &slot = tileOf(x, first);
+            bool empty = slot.load(std::memory_order_relaxed) == zeroTile.data();
+            for (int y = 0; empty && y < count; y++) {
+                empty = values[first + y] == 0;
+            }
+            if (!empty) {
+                memcpy(writableTile(slot) + offset, values + first, count * sizeof(int));
+            }
+        }
+    }
+
+    // Copies a whole row into numberColumns values
+    void copyRow(int x, int *values) const {
+        int offset = (x & tileMask) << MAP_TILE_BITS;
+        for (int first = 0; first < numberColumns; first += tileSide) {
+            int count = numberColumns - first < tileSide ? numberColumns - first : tileSide;
+            memcpy(values + first, tileOf(x, first).load(std::memory_order_acquire) + offset,
+                    count * sizeof(int));
+        }
+    }
+
+    /**
+     * Moves the map to a dense block, band of tiles by band of tiles,
+     * freeing the tiles of a band once its rows are copied, so the cells
+     * are never held twice. The map is left empty
+     *
+     * @param rowStride ints from the start of a row of the block to the next
+     */
+    void moveTo(int *map, size_t rowStride) {
+        const size_t trimBytes = (size_t) 64 << 20;
+        size_t freedBytes = 0;
+        for (int i = 0; i < tileRows; i++) {
+            int firstRow = i << MAP_TILE_BITS;
+            int endRow = numberRows - firstRow < tileSide ? numberRows : firstRow + tileSide;
+            for (int x = firstRow; x < endRow; x++) {
+                copyRow(x, map + x * rowStride);
+            }
+
+            for (int j = 0; j < tileColumns; j++) {
+                std::atomic<int *> &slot = tiles[(size_t) i * tileColumns + j];
+                int *tile = slot.load(std::memory_order_relaxed);
+                if (tile != zeroTile.data()) {
+                    slot.store(zeroTile.data(), std::memory_order_relaxed);
+                    free(tile);
+                    numberTiles--;
+                    freedBytes += tileCells * sizeof(int);
+                }
+            }
+            // The allocator keeps freed tiles in the middle of its heap, they go back to the system here
+            if (freedBytes >= trimBytes) {
+                malloc_trim(0);
+                freedBytes = 0;
+            }
+        }
+    }
+
+    /**
+     * Calls visit(firstRow, firstColumn, cells) for every tile with its own
+     * cells; the cells are row by row, 2^MAP_TILE_BITS of them per row,
+     * and the ones past the edges of the map are always 0.
+     */
+    template <typename Visitor>
+    void forEachTile(Visitor visit) {
+        for (int i = 0; i < tileRows; i++) {
+            for (int j = 0; j < tileColumns; j++) {
+                int *tile = tiles[(size_t) i * tileColumns + j].load(std::memory_order_acquire);
+                if (tile != zeroTile.data()) {
+                    visit(i << MAP_TILE_BITS, j << MAP_TILE_BITS, tile);
+                }
+            }
+        }
+    }
+
+    // Number of cells of a tile in a row
+    static int getTileSide() {
+        return tileSide;
+    }
+
+    // Getters & Setters
+    size_t getNumberTiles() const {
+        return numberTiles.load(std::memory_order_relaxed);
+    }
+
+    size_t getNumberBlocks() const {
+        return (size_t) tileRows * tileColumns;
+    }
+
+    int getTileColumns() const {
+        return tileColumns;
+    }
+
+    // Bytes of the tiles, the directory and the zero tile
+    size_t memoryUsage() const {
+        return (getNumberTiles() + 1) * tileCells * sizeof(int) + getNumberBlocks() * sizeof(std::atomic<int *>);
+    }
+};
+
+#endif // __TILEDMAP_H__
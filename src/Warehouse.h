@@ -1,31 +1,241 @@
 #ifndef __WAREHOUSE_H__
 #define __WAREHOUSE_H__
 
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <vector>
-#include <tuple> 
-#include <string>
 #include <cassert>
-
-#include "DoublyLinkedList.h"
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "BucketQueue.h"
+#include "CommandLog.h"
+#include "CommandRecord.h"
+#include "ConcurrentHistory.h"
+#include "FenwickTree2D.h"
+#include "OutputBuffer.h"
+#include "PathPlanner.h"
 #include "ResizableArray.h"
+#include "RingDeque.h"
+#include "SegmentedHistory.h"
+#include "Snapshot.h"
+#include "StripedLock.h"
+#include "TaskAssignment.h"
+#include "TiledMap.h"
+#include "WarehouseStats.h"
+
+// Outcome of the commands that change the warehouse
+enum WarehouseStatus {
+    STATUS_EXECUTED, STATUS_NO_COMMAND, STATUS_NO_HISTORY, STATUS_NO_CHECKPOINT, STATUS_UNREACHABLE,
+    STATUS_NO_SNAPSHOT
+};
+
+// The message written for a status
+inline const char *StatusMessage(WarehouseStatus status) {
+    switch (status) {
+    case STATUS_NO_COMMAND:
+        return "EXECUTE: No command to execute";
+    case STATUS_NO_HISTORY:
+        return "UNDO: No History";
+    case STATUS_NO_CHECKPOINT:
+        return "ROLLBACK_TO: No checkpoint";
+    case STATUS_UNREACHABLE:
+        return "EXECUTE: Unreachable cell";
+    case STATUS_NO_SNAPSHOT:
+        return "SNAPSHOT: The snapshot could not be written";
+    default:
+        return "Executed";
+    }
+}
+
+// Rows of the map start on a cache line boundary (in number of cells)
+const int MAP_ROW_ALIGNMENT = 16;
+
+// Each chunk of the history holds 2^HISTORY_CHUNK_BITS commands
+const int HISTORY_CHUNK_BITS = 16;
+
+// A named depth of the history that ROLLBACK_TO can go back to
+struct Checkpoint {
+    int checkpointID;
+    long depth;
+    unsigned int serial;    // tells the current setting from older ones
+
+    Checkpoint() : checkpointID(0), depth(-1), serial(0) {}
+};
+
+/**
+ * Cost of executing a command, in units of time:
+ * timePerCommand + timePerBox * boxes moved + timePerCell * the distance
+ * from the cell of the robot's previous command (0 disables travel); the
+ * distance is the length of the planned path with path planning, the
+ * Manhattan distance without
+ */
+struct TimeModel {
+    int timePerCommand;
+    int timePerBox;
+    int timePerCell;
+
+    TimeModel() : timePerCommand(1), timePerBox(1), timePerCell(0) {}
+};
+
+// How the map is stored, see WarehouseOptions::mapLayout
+enum MapLayout { MAP_AUTO, MAP_DENSE, MAP_TILED };
+
+// Settings of a warehouse that do not come from the input file
+struct WarehouseOptions {
+    /**
+        Chunks of the history kept in memory, the older ones are spilled
+        to a file in historySpillDirectory; 0 keeps everything in memory
+    */
+    int historyResidentChunks;
+    std::string historySpillDirectory;
+    TimeModel timeModel;
+    bool regionIndex;           // keep a FenwickTree2D for QUERY_REGION
+    /**
+        Levels of the command queues, 0 for the original two priorities
+        (1 appends, anything else goes to the front); see Enqueue()
+    */
+    int priorityLevels;
+    /**
+        Plan the travel of the robots around obstacles (the cells that are
+        negative in the loaded map), keeping up to pathCacheFields
+        distance fields; see PathPlanner
+    */
+    bool pathPlanning;
+    int pathCacheFields;
+    /**
+        What ASSIGN_BATCH charges for every command a robot has to do
+        before a task, in cells of travel; see AssignBatch()
+    */
+    int queueWeight;
+    /**
+        The map is one dense block, or tiles given only to the parts of
+        the map that are not empty (see TiledMap); with MAP_AUTO, a map
+        of autoTiledBytes or more is loaded into tiles and made dense as
+        soon as the rows loaded so far use more than half of their tiles
+    */
+    MapLayout mapLayout;
+    size_t autoTiledBytes;
 
-enum CommandType { GET, DROP };   
+    WarehouseOptions()
+            : historyResidentChunks(0), historySpillDirectory("/tmp"), regionIndex(false),
+              priorityLevels(0), pathPlanning(false), pathCacheFields(64), queueWeight(1),
+              mapLayout(MAP_AUTO), autoTiledBytes((size_t) 256 << 20) {}
+};
+
+// A GET or DROP command given to no robot, waiting for ASSIGN_BATCH
+struct PendingTask {
+    QueuedCommand command;
+    int priority;
+
+    PendingTask(const QueuedCommand &command, int priority) : command(command), priority(priority) {}
+};
+
+// Marks a robot whose row of BatchTravel is not found yet
+const size_t BATCH_NO_ROW = (size_t) -1;
+
+/**
+    The travel ASSIGN_BATCH charges from the end of every robot's queue
+    to every pending task, found when the assignment asks for it
+    Without obstacles it is the Manhattan distance. With them, the first
+    distance asked from a cell in a part of the batch (AssignPartSize)
+    runs one BFS from that cell to the tasks of the part, shared by the
+    robots whose queues end there; robots the assignment never asks about
+    cost no search, the rows kept hold at most ASSIGN_MAX_ENTRIES
+    distances, and the searches do not take the lock of the planner
+*/
+class BatchTravel {
+private:
+    PathPlanner *planner;                   // NULL without path planning
+    const std::vector<int> &endX;           // -1 for a robot that has not moved yet
+    const std::vector<int> &endY;
+    const std::vector<int> &taskX;
+    const std::vector<int> &taskY;
+    int partSize;
+    int first;                              // first task of the part the rows are for
+    int count;                              // tasks in that part
+    std::vector<size_t> rowOf;              // where the row of every robot starts, BATCH_NO_ROW before it is found
+    std::unordered_map<long long, size_t> rowFrom;  // where the row of a cell starts
+    std::vector<int> rows;
+    PathPlanner::Scratch scratch;
+
+    void startPart(int task) {
+        first = task - task % partSize;
+        count = std::min(partSize, (int) taskX.size() - first);
+        std::fill(rowOf.begin(), rowOf.end(), BATCH_NO_ROW);
+        rowFrom.clear();
+        rows.clear();
+    }
+
+    // The row of a robot with an end, a BFS the first time its cell is asked about
+    size_t row(int robot) {
+        if (rowOf[robot] != BATCH_NO_ROW) {
+            return rowOf[robot];
+        }
+        long long cell = (long long) endX[robot] << 32 | endY[robot];
+        std::unordered_map<long long, size_t>::iterator found = rowFrom.find(cell);
+        if (found != rowFrom.end()) {
+            return rowOf[robot] = found->second;
+        }
+
+        size_t start = rows.size();
+        rows.resize(start + count);
+        planner->distancesFrom(endX[robot], endY[robot], count, &taskX[first], &taskY[first],
+                &rows[start], scratch);
+        rowFrom[cell] = start;
+        return rowOf[robot] = start;
+    }
+
+public:
+    BatchTravel(PathPlanner *planner, const std::vector<int> &endX, const std::vector<int> &endY,
+            const std::vector<int> &taskX, const std::vector<int> &taskY)
+            : planner(planner), endX(endX), endY(endY), taskX(taskX), taskY(taskY),
+              partSize(AssignPartSize((int) endX.size())), first(0), count(0), rowOf(endX.size(), BATCH_NO_ROW) {}
+
+    // The travel of a robot to a task, -1 if it can not get there
+    int operator()(int robot, int task) {
+        if (endX[robot] < 0) {
+            return planner != NULL && planner->isObstacle(taskX[task], taskY[task]) ? -1 : 0;
+        }
+        if (planner == NULL || planner->getNumberObstacles() == 0) {
+            return std::abs(taskX[task] - endX[robot]) + std::abs(taskY[task] - endY[robot]);
+        }
+        if (task < first || task >= first + count) {
+            startPart(task);
+        }
+        return rows[row(robot) + (task - first)];
+    }
+};
 
 struct Robot {
     int ID;
     int numberBoxes;
+    /**
+        The time spent on the executed commands and the cell of the last
+        one (-1 before the first), kept up to date by Execute and Undo
+    */
+    long long time;
+    int positionX;
+    int positionY;
     /**
         The command queue for a specific robot 
         Contains only "GET" and "DROP" types of commands
         
-        The tuple contains the informations about the command: 
+        The packed record contains the informations about the command: 
         CommandType, x, y, numberBoxes
+
+        One circular buffer per priority level, level 0 being executed
+        first; with the original two priorities there is a single level
     */
-    DoublyLinkedList<std::tuple<CommandType, int, int, int>> commandsQueue;
+    BucketQueue<QueuedCommand> commandsQueue;
 
-    Robot() : numberBoxes(0), commandsQueue() {}
+    Robot() : numberBoxes(0), time(0), positionX(-1), positionY(-1), commandsQueue() {}
 };
 
 class Warehouse {
@@ -33,120 +243,287 @@ private:
     int numberRobots;
     int numberRows;
     int numberColumns;
-    int **map;              // the map of the warehouse
+    /**
+        The map of the warehouse, stored row by row in one contiguous
+        buffer; every row is padded to a multiple of MAP_ROW_ALIGNMENT
+        NULL when the map is tiled instead
+    */
+    int *map;
+    size_t rowStride;
+    // Bytes of the map when it is a mapping of a snapshot, 0 when it was allocated
+    size_t mappedMapBytes;
+    // The sparse map, NULL when the map is dense
+    std::unique_ptr<TiledMap> tiles;
+    // MAP_AUTO: the tiled map is made dense while it loads, or by FinishLoading(), if most of it is used
+    bool chooseLayout;
     std::vector<struct Robot> robots;
+    TimeModel timeModel;
+    int priorityLevels;
+
+    /**
+        Optional index of the sums of the map, follows every change of a
+        cell made through StoreCell()
+    */
+    bool hasRegionIndex;
+    FenwickTree2D regionIndex;
+    // Only with path planning, knows the obstacles
+    std::unique_ptr<PathPlanner> planner;
+    // The commands added without a robot, in the order they came
+    std::vector<PendingTask> pendingTasks;
+    int queueWeight;
     /**
         The stack with the history of executed commands
         Contains the history of commands given by robots, only GET and DROP type
         
-        The tuple contains the informations about the command: 
+        The record contains the informations about the command: 
         robotID, CommandType, x, y, numberBoxes
+
+        Stored in fixed-size chunks, the old ones can be spilled to disk
     */
-    ResizableArray<std::tuple<int, CommandType, int, int, int>> commandsHistory;
-    
+    SegmentedHistory<HistoryRecord> commandsHistory;
 
-public:
-    Warehouse(int numberRobots, int numberRows, int numberColumns) {
-        this->numberRobots = numberRobots;
-        this->numberRows = numberRows;
-        this->numberColumns = numberColumns;
+    /**
+        The checkpoints, indexed by ID, and a stack with all of them in the
+        order they were set; depth is -1 for checkpoints that are not valid
+    */
+    std::vector<Checkpoint> checkpoints;
+    std::vector<Checkpoint> checkpointStack;
 
-        // Instantiate commandsHistory stack
-        commandsHistory = ResizableArray<std::tuple<int, CommandType, int, int, int>>();
+    /**
+        Used by ExecuteConcurrent(): the locks of the cells, and the log
+        of the commands executed since the last CommitConcurrentHistory()
+    */
+    StripedLock cellLocks;
+    ConcurrentHistory<HistoryRecord> concurrentHistory;
 
-        // Initializing vector of robots and setting their IDs and numberBoxes
-        robots.resize(numberRobots);     
-        for (int i = 0 ; i < numberRobots; i++) {
-            robots[i].ID = i;
+#ifdef WAREHOUSE_STATS
+    WarehouseStats stats;
+#endif
+
+    // The command log of the run, committed before every snapshot; NULL without one
+    CommandLog *log;
+
+    // The map and the queues are owned by one warehouse only
+    Warehouse(const Warehouse &);
+    Warehouse &operator=(const Warehouse &);
+
+    // Accessor for a cell of the map
+    int cell(int x, int y) {
+        return tiles ? tiles->get(x, y) : map[x * rowStride + y];
+    }
+
+    void setCell(int x, int y, int value) {
+        if (tiles) {
+            tiles->set(x, y, value);
+        } else {
+            map[x * rowStride + y] = value;
         }
+    }
 
-        // Dynamic allocation for map
-        map = new int*[numberRows];
-        for (int i = 0; i < numberRows; i++) {
-            map[i] = new int[numberColumns];
+    /**
+        Moves a tiled map to one dense block; the tiles are freed as their
+        rows are copied, so the map is not held twice
+    */
+    void MakeDense() {
+        void *block = NULL;
+        size_t mapBytes = (size_t) numberRows * rowStride * sizeof(int);
+        if (posix_memalign(&block, MAP_ROW_ALIGNMENT * sizeof(int), mapBytes > 0 ? mapBytes : 1) != 0) {
+            throw std::bad_alloc();
         }
+        map = (int *) block;
+        tiles->moveTo(map, rowStride);
+        tiles.reset();
     }
 
-    ~Warehouse() {
-        // Freeing dynamically allocated memory for map
-        for (int i = 0; i < numberRows; i++) {
-            delete[] map[i];
+    /**
+        The only way the map is changed once it is loaded, so the region
+        index sees every change
+
+        @param sharedMap Other threads may be changing other cells
+    */
+    void StoreCell(int x, int y, int value, bool sharedMap) {
+        if (hasRegionIndex) {
+            int mapCell = cell(x, y);
+            if (value != mapCell && sharedMap) {
+                regionIndex.addShared(x, y, (long long) value - mapCell);
+            } else if (value != mapCell) {
+                regionIndex.add(x, y, (long long) value - mapCell);
+            }
         }
-        delete[] map;
+        setCell(x, y, value);
     }
 
-    // Setter function for a specific element of the map
-    void SetMapValue(int x, int y, int value) {
-        map[x][y] = value;
+    /**
+        The number of cells between two cells, -1 if there is no path;
+        0 from a robot that has not been anywhere yet (fromX -1)
+    */
+    int GridDistance(int fromX, int fromY, int x, int y) {
+        if (planner) {
+            if (fromX < 0) {
+                return planner->isObstacle(x, y) ? -1 : 0;
+            }
+            return planner->distance(fromX, fromY, x, y);
+        }
+        if (fromX < 0) {
+            return 0;
+        }
+        return std::abs(x - fromX) + std::abs(y - fromY);
     }
 
-    // Getter function for a specific element of the map
-    int GetMapValue(int x, int y) {
-        return map[x][y];
+    /**
+        The number of cells a robot travels to reach the cell of a command,
+        -1 if it can not get there; 0 for its first command, and whenever
+        travel costs nothing and there are no obstacles to check
+    */
+    int TravelDistance(const HistoryRecord &executed) {
+        if (!planner && timeModel.timePerCell == 0) {
+            return 0;
+        }
+        return GridDistance(executed.originX(), executed.originY(),
+                executed.command().x(), executed.command().y());
     }
 
     /**
-    * AddGetBox() and AddDropBox() functions
-    *
-    * Depending on the priority of the command, it will be added to the 
-    * beginning or end of the commands queue of the robot with the given ID
+        The cell a robot will be on once its queue is done: the cell of the
+        last command it would execute, otherwise its current cell
     */
-    void AddGetBox(int robotID, int x, int y, int numberBoxes, int priority) {
-        auto commandTuple = std::make_tuple(CommandType::GET, x, y, numberBoxes);
-        if (priority == 1) {
-            robots[robotID].commandsQueue.addLast(commandTuple);
-        } else {
-            robots[robotID].commandsQueue.addFirst(commandTuple);
+    void QueueEnd(int robotID, int &x, int &y) {
+        BucketQueue<QueuedCommand> &queue = robots[robotID].commandsQueue;
+        x = robots[robotID].positionX;
+        y = robots[robotID].positionY;
+        for (int level = queue.firstLevel(); level >= 0; level = queue.nextLevel(level)) {
+            RingDeque<QueuedCommand> &bucket = queue.bucket(level);
+            if (bucket.size() > 0) {
+                x = bucket.get(bucket.size() - 1).x();
+                y = bucket.get(bucket.size() - 1).y();
+            }
         }
     }
 
-    void AddDropBox(int robotID, int x, int y, int numberBoxes, int priority) {
-        auto commandTuple = std::make_tuple(CommandType::DROP, x, y, numberBoxes);
+    // The time an executed command took, as charged to its robot
+    long long CommandTime(const HistoryRecord &executed, int travel) {
+        return timeModel.timePerCommand
+                + (long long) timeModel.timePerBox * executed.command().numberBoxes()
+                + (long long) timeModel.timePerCell * travel;
+    }
 
-        if (priority ==  1) {
-            robots[robotID].commandsQueue.addLast(commandTuple);
+    /**
+        Puts a command taken out of the history back in the robot's
+        command queue and performs the reverse operation
+    */
+    void RevertCommand(const HistoryRecord &lastCommand) {
+        int robotID = lastCommand.robotID();
+        CommandType commandType = lastCommand.command().type();
+        int x = lastCommand.command().x();
+        int y = lastCommand.command().y();
+        int numberBoxes = lastCommand.command().numberBoxes();
+
+        int mapCell = cell(x, y);
+
+        // The command goes back to the front of the most urgent level, so it is the next one executed
+        robots[robotID].commandsQueue.addFirst(0, lastCommand.command());
+#ifdef WAREHOUSE_STATS
+        stats.noteQueueDepth(robotID, robots[robotID].commandsQueue.size());
+#endif
+
+        // The robot gets back the time and the position it had before
+        robots[robotID].time -= CommandTime(lastCommand, TravelDistance(lastCommand));
+        robots[robotID].positionX = lastCommand.originX();
+        robots[robotID].positionY = lastCommand.originY();
+
+        /**
+            UNDO execution
+            Perform the reverse operation of the extracted one
+        */
+
+        //Case 1: for DROP type command - execute GET
+        if (commandType == CommandType::DROP) {
+            /* 
+            if the number of boxes to be taken is greater than the
+            number of boxes in the cell -> will take all existing boxes
+            */
+            if (numberBoxes >= mapCell) {
+
+                numberBoxes = mapCell;
+                robots[robotID].numberBoxes += mapCell;
+                mapCell = 0;
+
+
+            } else {
+                // else the robot will take the given number of boxes
+                robots[robotID].numberBoxes += numberBoxes;
+                mapCell -= numberBoxes;
+
+            }
+
+        // Case 2: for GET type command - execute DROP
         } else {
-            robots[robotID].commandsQueue.addFirst(commandTuple);
+            /* 
+            if the number of boxes to be dropped is greater than the 
+            number of boxes of the robot -> will drop all its boxes
+            */
+            if (robots[robotID].numberBoxes <= numberBoxes) {
+
+                numberBoxes = robots[robotID].numberBoxes;
+                mapCell = robots[robotID].numberBoxes;
+                robots[robotID].numberBoxes = 0;
+
+            } else {
+                // else the robot will drop the given number of boxes
+                mapCell += numberBoxes;
+                robots[robotID].numberBoxes -= numberBoxes;
+
+            }
         }
+
+        StoreCell(x, y, mapCell, false);
     }
 
     /**
-        Executes the first command from the queue of a robot with the given ID
-    */
-    std::string Execute(int robotID) {
-        std::string outputString;
+        Executes the first command from the queue of a robot, without
+        adding it to the history
 
+        @param sharedMap Other threads may be changing other cells
+    */
+    WarehouseStatus ExecuteCommand(int robotID, HistoryRecord &executed, bool sharedMap) {
         // If there is no command in the queue for execution
         if (robots[robotID].commandsQueue.isEmpty()) {
-            outputString = "EXECUTE: No command to execute";
+            return STATUS_NO_COMMAND;
 
         } else {
             // take the first command from the queue of the robot with the given ID
-            auto commandNode = robots[robotID].commandsQueue.getHead();
-            auto commandTuple = commandNode->data; // Accessing the tuple from the node
-            auto currentType = std::get<0>(commandTuple);
-            int x = std::get<1>(commandTuple);
-            int y = std::get<2>(commandTuple);
-            int firstNumberBoxes = std::get<3>(commandTuple);
+            QueuedCommand command = robots[robotID].commandsQueue.getFirst();
+            CommandType currentType = command.type();
+            int x = command.x();
+            int y = command.y();
+            int firstNumberBoxes = command.numberBoxes();
             int currentNumberBoxes = firstNumberBoxes; // Added value in the commands stack
 
+            // The robot has to get to the cell first, the command waits if it can not
+            int travel = TravelDistance(HistoryRecord(robotID, command,
+                    robots[robotID].positionX, robots[robotID].positionY));
+            if (travel < 0) {
+                return STATUS_UNREACHABLE;
+            }
+            int mapCell = cell(x, y);
+
             // Case 1: GET type command
             if (currentType == CommandType::GET) {
                 /* 
                 if the number of boxes to be taken is greater than the
                 number of boxes in the cell -> will take all existing boxes
                 */
-                if (firstNumberBoxes >= map[x][y]) {
+                if (firstNumberBoxes >= mapCell) {
 
-                    currentNumberBoxes = map[x][y];
-                    robots[robotID].numberBoxes += map[x][y];
-                    map[x][y] = 0;
+                    currentNumberBoxes = mapCell;
+                    robots[robotID].numberBoxes += mapCell;
+                    mapCell = 0;
 
 
                 } else {
                     // else the robot will take the given number of boxes
                     robots[robotID].numberBoxes += firstNumberBoxes;
-                    map[x][y] -= firstNumberBoxes;
+                    mapCell -= firstNumberBoxes;
 
                 }
 
@@ -159,206 +536,930 @@ public:
                 if (robots[robotID].numberBoxes <= firstNumberBoxes) {
 
                     currentNumberBoxes = robots[robotID].numberBoxes;
-                    map[x][y] = robots[robotID].numberBoxes;
+                    mapCell = robots[robotID].numberBoxes;
                     robots[robotID].numberBoxes = 0;
 
                 } else {
                     // else the robot will drop the given number of boxes
-                    map[x][y] += firstNumberBoxes;
+                    mapCell += firstNumberBoxes;
                     robots[robotID].numberBoxes -= firstNumberBoxes;
 
                 }
             }
-            // The executed command is added to the history stack
-            std::tuple<int, CommandType, int, int, int> commandTupleStack = std::make_tuple(robotID, currentType, x, y, currentNumberBoxes);
-            commandsHistory.addLast(commandTupleStack);
+            StoreCell(x, y, mapCell, sharedMap);
+
+            executed = HistoryRecord(robotID, QueuedCommand(currentType, x, y, currentNumberBoxes),
+                    robots[robotID].positionX, robots[robotID].positionY);
+
+            // The robot is charged for the command and ends up on its cell
+            robots[robotID].time += CommandTime(executed, travel);
+            robots[robotID].positionX = x;
+            robots[robotID].positionY = y;
+
+            return STATUS_EXECUTED;
+        }
+    }
+
+    /**
+        Checkpoints that are above the top of the history no longer
+        describe a state the history can go back to
+    */
+    void DropInvalidCheckpoints() {
+        long depth = commandsHistory.size();
+        while (!checkpointStack.empty() && checkpointStack.back().depth > depth) {
+            const Checkpoint &top = checkpointStack.back();
+            if (checkpoints[top.checkpointID].serial == top.serial) {
+                checkpoints[top.checkpointID].depth = -1;
+            }
+            checkpointStack.pop_back();
+        }
+    }
+
+public:
+    Warehouse(int numberRobots, int numberRows, int numberColumns,
+            const WarehouseOptions &options = WarehouseOptions())
+            : commandsHistory(HISTORY_CHUNK_BITS, options.historyResidentChunks,
+                    options.historySpillDirectory.c_str()) {
+        if (!SupportsDimensions(numberRobots, numberRows, numberColumns)) {
+            throw std::length_error("the warehouse is too large for WAREHOUSE_COORDINATE_BITS");
+        }
+
+        this->numberRobots = numberRobots;
+        this->numberRows = numberRows;
+        this->numberColumns = numberColumns;
+        this->timeModel = options.timeModel;
+        this->hasRegionIndex = options.regionIndex;
+        this->priorityLevels = options.priorityLevels;
+        this->queueWeight = options.queueWeight;
+        if (options.pathPlanning) {
+            planner.reset(new PathPlanner(numberRows, numberColumns, options.pathCacheFields));
+        }
+        if (priorityLevels < 0 || priorityLevels > BucketQueue<QueuedCommand>::maxLevels) {
+            throw std::invalid_argument("the number of priority levels is out of range");
+        }
+
+        // Initializing vector of robots and setting their IDs and numberBoxes
+        robots.resize(numberRobots);     
+        for (int i = 0 ; i < numberRobots; i++) {
+            robots[i].ID = i;
+            if (priorityLevels > 0) {
+                robots[i].commandsQueue.setNumberLevels(priorityLevels);
+            }
+        }
+#ifdef WAREHOUSE_STATS
+        stats = WarehouseStats(numberRobots);
+#endif
+
+        // Dynamic allocation for map, a single cache aligned block, or the tiles for a large one
+        rowStride = (numberColumns + MAP_ROW_ALIGNMENT - 1) / MAP_ROW_ALIGNMENT * MAP_ROW_ALIGNMENT;
+        size_t mapBytes = (size_t) numberRows * rowStride * sizeof(int);
+        chooseLayout = options.mapLayout == MAP_AUTO && mapBytes >= options.autoTiledBytes;
+        map = NULL;
+        if (options.mapLayout == MAP_TILED || chooseLayout) {
+            tiles.reset(new TiledMap(numberRows, numberColumns));
+        } else {
+            void *block = NULL;
+            if (posix_memalign(&block, MAP_ROW_ALIGNMENT * sizeof(int), mapBytes > 0 ? mapBytes : 1) != 0) {
+                throw std::bad_alloc();
+            }
+            map = (int *) block;
+        }
+        mappedMapBytes = 0;
+        log = NULL;
+    }
+
+    ~Warehouse() {
+        // Freeing dynamically allocated memory for map
+        if (mappedMapBytes > 0) {
+            munmap(map, mappedMapBytes);
+        } else {
+            free(map);
+        }
+    }
+
+    // The coordinates and the robot IDs must fit in the packed command records
+    static bool SupportsDimensions(int numberRobots, int numberRows, int numberColumns) {
+        return numberRobots - 1 <= HistoryRecord::maxRobotID
+                && numberRows - 1 <= QueuedCommand::maxCoordinate
+                && numberColumns - 1 <= QueuedCommand::maxCoordinate;
+    }
+
+    // Setter function for a specific element of the map
+    void SetMapValue(int x, int y, int value) {
+        StoreCell(x, y, value, false);
+    }
+
+    // Getter function for a specific element of the map
+    int GetMapValue(int x, int y) {
+        return cell(x, y);
+    }
+
+    /**
+        Fills a whole row of the map in one pass
+        FinishLoading() has to be called once all the rows are loaded
+        
+        @param values numberColumns values for the cells of the row
+    */
+    void LoadMapRow(int x, const int *values) {
+        if (tiles) {
+            tiles->loadRow(x, values);
+            // MAP_AUTO: once the bands of tiles loaded so far are mostly used, the rest is loaded dense
+            int side = TiledMap::getTileSide();
+            if (chooseLayout && ((x + 1) % side == 0 || x + 1 == numberRows)
+                    && tiles->getNumberTiles() * 2 > (size_t) (x / side + 1) * tiles->getTileColumns()) {
+                MakeDense();
+                chooseLayout = false;
+            }
+        } else {
+            memcpy(map + x * rowStride, values, numberColumns * sizeof(int));
+        }
+    }
+
+    /**
+        Fills the whole map in one pass
+        
+        @param values numberRows * numberColumns values, row by row
+    */
+    void LoadMap(const int *values) {
+        if (!tiles && rowStride == (size_t) numberColumns) {
+            memcpy(map, values, (size_t) numberRows * numberColumns * sizeof(int));
+        } else {
+            for (int i = 0; i < numberRows; i++) {
+                LoadMapRow(i, values + (size_t) i * numberColumns);
+            }
+        }
+        FinishLoading();
+    }
+
+    /**
+        Prepares what depends on the whole map, once it is loaded: with
+        MAP_AUTO a tiled map that is mostly used becomes dense, with path
+        planning the negative cells become obstacles holding no boxes,
+        then the region index is built
+    */
+    void FinishLoading() {
+        if (chooseLayout && tiles->getNumberTiles() * 2 > tiles->getNumberBlocks()) {
+            MakeDense();
+        }
+        chooseLayout = false;
+
+        if (planner && tiles) {
+            // The zero tile has no obstacles
+            int side = TiledMap::getTileSide();
+            tiles->forEachTile([this, side](int firstRow, int firstColumn, int *cells) {
+                for (int i = 0; i < side * side; i++) {
+                    if (cells[i] < 0) {
+                        planner->addObstacle(firstRow + i / side, firstColumn + i % side);
+                        cells[i] = 0;
+                    }
+                }
+            });
+        } else if (planner) {
+            for (int x = 0; x < numberRows; x++) {
+                for (int y = 0; y < numberColumns; y++) {
+                    if (cell(x, y) < 0) {
+                        planner->addObstacle(x, y);
+                        setCell(x, y, 0);
+                    }
+                }
+            }
+        }
+        BuildRegionIndex();
+    }
+
+    // Builds the region index, if there is one, from the whole map in one pass
+    void BuildRegionIndex() {
+        if (hasRegionIndex && tiles) {
+            // An empty tree, every row read from the same row of zeros, then the cells of the tiles
+            std::vector<int> zeros(numberColumns > 0 ? numberColumns : 1, 0);
+            regionIndex.build(zeros.data(), numberRows, numberColumns, 0);
+            int side = TiledMap::getTileSide();
+            tiles->forEachTile([this, side](int firstRow, int firstColumn, int *cells) {
+                for (int i = 0; i < side * side; i++) {
+                    if (cells[i] != 0) {
+                        regionIndex.add(firstRow + i / side, firstColumn + i % side, cells[i]);
+                    }
+                }
+            });
+        } else if (hasRegionIndex) {
+            regionIndex.build(map, numberRows, numberColumns, rowStride);
+        }
+    }
+
+    // Bytes used by the region index, 0 without one
+    size_t RegionIndexMemory() {
+        return hasRegionIndex ? regionIndex.memoryUsage() : 0;
+    }
+
+    // The path planner, NULL without path planning
+    PathPlanner *GetPathPlanner() {
+        return planner.get();
+    }
+
+    // The log the commands are written to, so snapshots know where they are in it
+    void AttachLog(CommandLog *log) {
+        this->log = log;
+    }
+
+    /**
+    * Adds a command to the queue of a robot
+    *
+    * With the original two priorities, a command with priority 1 is added
+    * at the end of the queue and any other one at the beginning
+    * With priority levels, the priority is the level (clamped to the
+    * levels there are, 0 being the most urgent) and the command is added
+    * after the others of its level
+    * A robotID of -1 leaves the command in the pool of ASSIGN_BATCH
+    */
+    void Enqueue(int robotID, const QueuedCommand &command, int priority) {
+        if (robotID < 0) {
+            pendingTasks.push_back(PendingTask(command, priority));
+            return;
+        }
+
+        BucketQueue<QueuedCommand> &queue = robots[robotID].commandsQueue;
+        if (priorityLevels == 0) {
+            if (priority == 1) {
+                queue.addLast(0, command);
+            } else {
+                queue.addFirst(0, command);
+            }
+        } else {
+            int level = std::min(std::max(priority, 0), priorityLevels - 1);
+            queue.addLast(level, command);
+        }
+#ifdef WAREHOUSE_STATS
+        stats.noteQueueDepth(robotID, queue.size());
+#endif
+    }
+
+    /**
+    * AddGetBox() and AddDropBox() functions
+    *
+    * Depending on the priority of the command, it will be added to the 
+    * commands queue of the robot with the given ID; see Enqueue()
+    */
+    void AddGetBox(int robotID, int x, int y, int numberBoxes, int priority) {
+        Enqueue(robotID, QueuedCommand(CommandType::GET, x, y, numberBoxes), priority);
+    }
+
+    void AddDropBox(int robotID, int x, int y, int numberBoxes, int priority) {
+        Enqueue(robotID, QueuedCommand(CommandType::DROP, x, y, numberBoxes), priority);
+    }
+
+    /**
+        * Gives the pending tasks to the robots, minimizing the travel from
+        * where every robot will be once its queue is done plus queueWeight
+        * per command queued before each task (see OptimalAssignment)
+        * The tasks go to the queues with their own priority, in the order
+        * they were added; a task no robot can reach stays pending
+        *
+        * @param output The buffer the line is formatted into
+        *
+    */
+    void AssignBatch(OutputBuffer &output) {
+        int numberTasks = (int) pendingTasks.size();
+        std::vector<int> taskX(numberTasks), taskY(numberTasks);
+        for (int task = 0; task < numberTasks; task++) {
+            taskX[task] = pendingTasks[task].command.x();
+            taskY[task] = pendingTasks[task].command.y();
+        }
+
+        std::vector<int> queueLengths(numberRobots), endX(numberRobots), endY(numberRobots);
+        for (int i = 0; i < numberRobots; i++) {
+            queueLengths[i] = robots[i].commandsQueue.size();
+            QueueEnd(i, endX[i], endY[i]);
+        }
+
+        BatchTravel travel(planner.get(), endX, endY, taskX, taskY);
+        std::vector<int> assigned;
+        OptimalAssignment(numberTasks, queueLengths, queueWeight, [&travel](int robot, int task) {
+            return travel(robot, task);
+        }, assigned);
+
+        size_t kept = 0;
+        int numberAssigned = 0;
+        for (size_t i = 0; i < pendingTasks.size(); i++) {
+            if (assigned[i] >= 0) {
+                Enqueue(assigned[i], pendingTasks[i].command, pendingTasks[i].priority);
+                numberAssigned++;
+            } else {
+                pendingTasks[kept++] = pendingTasks[i];
+            }
+        }
+        pendingTasks.erase(pendingTasks.begin() + kept, pendingTasks.end());
+
+        output.write("ASSIGN_BATCH: ");
+        output.writeInt(numberAssigned);
+        output.writeChar('\n');
+    }
+
+    // Tasks waiting for ASSIGN_BATCH
+    int GetNumberPendingTasks() {
+        return (int) pendingTasks.size();
+    }
+
+    /**
+        Executes the first command from the queue of a robot with the given ID
+    */
+    WarehouseStatus Execute(int robotID) {
+        HistoryRecord executed;
+        WarehouseStatus status = ExecuteCommand(robotID, executed, false);
+
+        // The executed command is added to the history stack
+        if (status == STATUS_EXECUTED) {
+            commandsHistory.addLast(executed);
+#ifdef WAREHOUSE_STATS
+            stats.noteHistorySize(commandsHistory.size());
+#endif
+        }
+        return status;
+    }
+
+    /**
+        * Executes the first command from the queue of a robot without
+        * adding it to the history; it only touches the robot and the
+        * cell of the command, so robots working on different cells can
+        * run it concurrently
+        *
+        * @param executed Set to the record Execute() would add to the
+        * history, to be passed to AppendHistory() in the original order
+    */
+    WarehouseStatus ExecuteDetached(int robotID, HistoryRecord &executed) {
+        return ExecuteCommand(robotID, executed, true);
+    }
+
+    // Adds a record returned by ExecuteDetached() to the history
+    void AppendHistory(const HistoryRecord &executed) {
+        commandsHistory.addLast(executed);
+#ifdef WAREHOUSE_STATS
+        stats.noteHistorySize(commandsHistory.size());
+#endif
+    }
+
+    /**
+        * Executes the first command of a robot while other threads execute
+        * the commands of other robots; a robot must only be driven by one
+        * thread at a time
+        *
+        * The cell is locked while it is updated and while the command gets
+        * its sequence number, so the commands on a cell are numbered in the
+        * order they changed it. The commands wait in a separate log until
+        * CommitConcurrentHistory() is called, which has to happen before
+        * anything else reads or changes the history
+    */
+    WarehouseStatus ExecuteConcurrent(int robotID) {
+        int x, y;
+        if (!NextCommandCell(robotID, x, y)) {
+            return STATUS_NO_COMMAND;
+        }
+
+        uint64_t key = (uint64_t) x * numberColumns + y;
+        HistoryRecord executed;
+
+        cellLocks.lock(key);
+        WarehouseStatus status = ExecuteDetached(robotID, executed);
+        // A command that did not run (an unreachable cell) has nothing to undo
+        if (status == STATUS_EXECUTED) {
+            concurrentHistory.append(executed);
+        }
+        cellLocks.unlock(key);
+
+        return status;
+    }
+
+    /**
+        * Moves the commands run by ExecuteConcurrent() to the history, in
+        * the order of their sequence numbers; no thread may be executing
+    */
+    void CommitConcurrentHistory() {
+        long numberCommands = concurrentHistory.size();
+        for (long i = 0; i < numberCommands; i++) {
+            commandsHistory.addLast(concurrentHistory.get(i));
+        }
+        concurrentHistory.clear();
+#ifdef WAREHOUSE_STATS
+        stats.noteHistorySize(commandsHistory.size());
+#endif
+    }
+
+    /**
+        * Finds the cell the next EXECUTE of a robot would work on
+        * An executed command stays at the front of the queue, so only
+        * commands added later can replace it: with a priority other than
+        * 1, to a more urgent level or to an empty queue
+        *
+        * @return False if the queue of the robot is empty
+    */
+    bool NextCommandCell(int robotID, int &x, int &y) {
+        if (robots[robotID].commandsQueue.isEmpty()) {
+            return false;
+        }
+
+        QueuedCommand command = robots[robotID].commandsQueue.getFirst();
+        x = command.x();
+        y = command.y();
+        return true;
+    }
 
-            outputString = "Executed";
+    // Getters & Setters
+    int GetNumberRobots() {
+        return numberRobots;
+    }
+
+    int GetNumberRows() {
+        return numberRows;
+    }
+
+    int GetNumberColumns() {
+        return numberColumns;
+    }
+
+    bool IsMapTiled() {
+        return tiles != NULL;
+    }
+
+#ifdef WAREHOUSE_STATS
+    WarehouseStats &GetStats() {
+        return stats;
+    }
+#endif
+
+    /**
+        * Bytes held by the map, the command queues and the part of the
+        * history kept in memory; walks all the robots
+    */
+    size_t MemoryUsage() {
+        size_t bytes = tiles ? tiles->memoryUsage() : (size_t) numberRows * rowStride * sizeof(int);
+        for (int i = 0; i < numberRobots; i++) {
+            bytes += sizeof(Robot) + (size_t) robots[i].commandsQueue.capacity() * sizeof(QueuedCommand);
         }
-        return outputString;
+        bytes += pendingTasks.capacity() * sizeof(PendingTask);
+        bytes += RegionIndexMemory();
+        if (planner) {
+            bytes += planner->memoryUsage();
+        }
+        bytes += (size_t) commandsHistory.getResidentChunks() * ((size_t) 1 << HISTORY_CHUNK_BITS)
+                * sizeof(HistoryRecord);
+        return bytes;
     }
 
     /**
         * Print the commands from the queue of the given robot
         *
-        * @param outputString Constructs the string to be displayed
+        * @param output The buffer the line is formatted into
         * 
     */
-    std::string PrintCommands(int robotID) {
-        std::string outputString;
-        outputString += "PRINT_COMMANDS: ";
-
+    void PrintCommands(int robotID, OutputBuffer &output) {
         // Case 1 - if there are no commands in the robot's queue
         if (robots[robotID].commandsQueue.isEmpty()) {
-            outputString =  "No command found";
+            output.write("No command found");
 
         // Case 2 - else print the commands
         } else {
-            outputString += std::to_string(robotID) + ": ";
-
-            // displays the first (size - 1) commands
-            for (int i = 0; i < robots[robotID].commandsQueue.size() - 1; i++) {
-                auto currentNode = robots[robotID].commandsQueue.goToPos(i);
-                auto currentTuple = currentNode->data; // Accessing the tuple from the node
-
-                auto currentType = std::get<0>(currentTuple);
-                int x = std::get<1>(currentTuple);
-                int y = std::get<2>(currentTuple);
-                int numberBoxes = std::get<3>(currentTuple);
-
-                outputString += std::to_string(currentType) + " ";
-                outputString += std::to_string(x) + " ";
-                outputString += std::to_string(y) + " ";
-                outputString += std::to_string(numberBoxes) + "; ";
+            output.write("PRINT_COMMANDS: ");
+            output.writeInt(robotID);
+            output.write(": ");
+
+            // displays the commands in the order they would be executed, level by level
+            BucketQueue<QueuedCommand> &queue = robots[robotID].commandsQueue;
+            bool first = true;
+            for (int level = queue.firstLevel(); level >= 0; level = queue.nextLevel(level)) {
+                RingDeque<QueuedCommand> &bucket = queue.bucket(level);
+                for (int i = 0; i < bucket.size(); i++) {
+                    QueuedCommand command = bucket.get(i);
+
+                    CommandType currentType = command.type();
+                    int x = command.x();
+                    int y = command.y();
+                    int numberBoxes = command.numberBoxes();
+
+                    if (!first) {
+                        output.write("; ");
+                    }
+                    first = false;
+                    output.writeInt(currentType);
+                    output.writeChar(' ');
+                    output.writeInt(x);
+                    output.writeChar(' ');
+                    output.writeInt(y);
+                    output.writeChar(' ');
+                    output.writeInt(numberBoxes);
+                }
             }
-            // displays the last command 
-            int size = robots[robotID].commandsQueue.size();
-            auto currentNode = robots[robotID].commandsQueue.goToPos(size - 1);
-            auto currentTuple = currentNode->data; // Accessing the tuple from the node
-
-            auto currentType = std::get<0>(currentTuple);
-            int x = std::get<1>(currentTuple);
-            int y = std::get<2>(currentTuple);
-            int numberBoxes = std::get<3>(currentTuple);
-
-            outputString += std::to_string(currentType) + " ";
-            outputString += std::to_string(x) + " ";
-            outputString += std::to_string(y) + " ";
-            outputString += std::to_string(numberBoxes);
         }
 
-        return outputString;
+        output.writeChar('\n');
     }
 
     /**
         * Print the last added command in the stack of commands history
         *
-        * @param outputString Constructs the string to be displayed
+        * @param output The buffer the line is formatted into
         * 
     */
-    std::string LastExecutedCommand() {
-        std::string outputString;
-        outputString += "LAST_EXECUTED_COMMAND: ";
+    void LastExecutedCommand(OutputBuffer &output) {
+        output.write("LAST_EXECUTED_COMMAND: ");
 
         // Case 1 - if there are no commands in the stack history
         if (commandsHistory.isEmpty()) {
-            outputString += "No command was executed";
+            output.write("No command was executed");
 
         // Case 2 - else print the last executed command     
         } else {
-            auto lastCommand = commandsHistory.getLast();
-            int robotID = std::get<0>(lastCommand);
-            CommandType commandType = std::get<1>(lastCommand);
-            int x = std::get<2>(lastCommand);
-            int y = std::get<3>(lastCommand);
-            int numberBoxes = std::get<4>(lastCommand);
-
-            outputString += std::to_string(robotID) + ": ";
-            outputString += std::to_string(commandType) + " ";
-            outputString += std::to_string(x) + " ";
-            outputString += std::to_string(y) + " ";
-            outputString += std::to_string(numberBoxes);
+            HistoryRecord lastCommand = commandsHistory.getLast();
+            int robotID = lastCommand.robotID();
+            CommandType commandType = lastCommand.command().type();
+            int x = lastCommand.command().x();
+            int y = lastCommand.command().y();
+            int numberBoxes = lastCommand.command().numberBoxes();
+
+            output.writeInt(robotID);
+            output.write(": ");
+            output.writeInt(commandType);
+            output.writeChar(' ');
+            output.writeInt(x);
+            output.writeChar(' ');
+            output.writeInt(y);
+            output.writeChar(' ');
+            output.writeInt(numberBoxes);
         }
 
-        return outputString;
+        output.writeChar('\n');
     }
 
     /**
         * Remove the last executed command from the stack history
         * Put command back in the robot's command queue
         * Perform the reverse operation for the command found
-        *
-        * @param outputString Constructs the string to be displayed
         * 
     */
-    std::string Undo() {
-        std::string outputString;
-
+    WarehouseStatus Undo() {
         // Case 1 - if there are no commands in the stack history
         if (commandsHistory.isEmpty()) {
-            outputString += "UNDO: No History";
+            return STATUS_NO_HISTORY;
 
         // Case 2 - else execute UNDO implementation 
         } else {
-            // Take the atributes from the last command in stack history
-            auto lastCommand = commandsHistory.getLast();
-            int robotID = std::get<0>(lastCommand);
-            CommandType commandType = std::get<1>(lastCommand);
-            int x = std::get<2>(lastCommand);
-            int y = std::get<3>(lastCommand);
-            int numberBoxes = std::get<4>(lastCommand);
-
-            // Delete the command from history stack
-            commandsHistory.removeLast();
-
-            // Add command to the queue of the robot with given ID
-            robots[robotID].commandsQueue.addFirst(std::make_tuple(commandType, x, y, numberBoxes));
-
-            /**
-                UNDO execution
-                Perform the reverse operation of the extracted one
-            */
+            // Take the last command out of the history stack and revert it
+            RevertCommand(commandsHistory.removeLast());
+            DropInvalidCheckpoints();
 
-            //Case 1: for DROP type command - execute GET
-            if (commandType == CommandType::DROP) {
-                /* 
-                if the number of boxes to be taken is greater than the
-                number of boxes in the cell -> will take all existing boxes
-                */
-                if (numberBoxes >= map[x][y]) {
+            return STATUS_EXECUTED;
+        }
+    }
 
-                    numberBoxes = map[x][y];
-                    robots[robotID].numberBoxes += map[x][y];
-                    map[x][y] = 0;
+    /**
+        * Undo the last numberCommands executed commands in one pass,
+        * leaving the same state as that many calls of Undo()
+        * The commands are reverted one by one: the reverse operations
+        * clamp to the boxes of the cell and of the robot at that point, so
+        * they can not be summed per cell. Storing each touched cell once
+        * instead was measured with engine_bench's undo_many, and saved
+        * nothing next to taking the records off the history
+        *
+        * @return The number of commands undone, smaller than
+        * numberCommands if the history ran out
+    */
+    long UndoMany(long numberCommands) {
+        long undone = 0;
+        while (undone < numberCommands && !commandsHistory.isEmpty()) {
+            RevertCommand(commandsHistory.removeLast());
+            undone++;
+        }
 
+        DropInvalidCheckpoints();
+        return undone;
+    }
 
-                } else {
-                    // else the robot will take the given number of boxes
-                    robots[robotID].numberBoxes += numberBoxes;
-                    map[x][y] -= numberBoxes;
+    /**
+        * Remember the current depth of the history under the given ID,
+        * replacing an older checkpoint with the same ID
+    */
+    void SetCheckpoint(int checkpointID) {
+        if (checkpointID >= (int) checkpoints.size()) {
+            checkpoints.resize(checkpointID + 1);
+        }
 
+        Checkpoint &checkpoint = checkpoints[checkpointID];
+        checkpoint.checkpointID = checkpointID;
+        checkpoint.depth = commandsHistory.size();
+        checkpoint.serial++;
+        checkpointStack.push_back(checkpoint);
+
+        // Forget the settings that were replaced, once they pile up
+        if (checkpointStack.size() > 2 * checkpoints.size() + 16) {
+            size_t kept = 0;
+            for (size_t i = 0; i < checkpointStack.size(); i++) {
+                if (checkpoints[checkpointStack[i].checkpointID].serial == checkpointStack[i].serial) {
+                    checkpointStack[kept++] = checkpointStack[i];
                 }
+            }
+            checkpointStack.resize(kept);
+        }
+    }
 
-            // Case 2: for GET type command - execute DROP
-            } else {
-                /* 
-                if the number of boxes to be dropped is greater than the 
-                number of boxes of the robot -> will drop all its boxes
-                */
-                if (robots[robotID].numberBoxes <= numberBoxes) {
+    /**
+        * Undo every command executed after the given checkpoint
+        *
+        * @return STATUS_NO_CHECKPOINT if the checkpoint was never set or
+        * the history went below it since
+    */
+    WarehouseStatus RollbackTo(int checkpointID) {
+        if (checkpointID < 0 || checkpointID >= (int) checkpoints.size()
+                || checkpoints[checkpointID].depth < 0) {
+            return STATUS_NO_CHECKPOINT;
+        }
 
-                    numberBoxes = robots[robotID].numberBoxes;
-                    map[x][y] = robots[robotID].numberBoxes;
-                    robots[robotID].numberBoxes = 0;
+        UndoMany(commandsHistory.size() - checkpoints[checkpointID].depth);
+        return STATUS_EXECUTED;
+    }
 
-                } else {
-                    // else the robot will drop the given number of boxes
-                    map[x][y] += numberBoxes;
-                    robots[robotID].numberBoxes -= numberBoxes;
+    /**
+        * Writes the map, the robots with their queues, the history, the
+        * checkpoints and the pending tasks to a snapshot (see Snapshot.h);
+        * the obstacles of path planning are written as -1 cells, the way
+        * the map was read. With a command log, the log is committed first
+        * and the snapshot records how many of its records it holds, and
+        * where it is in the stream
+        *
+        * @param checkpointNames The names of the checkpoint IDs
+        * @param outputBytes The length of the output, synced, before the
+        * snapshot; --recover goes on from there. -1 if it is not known
+        *
+        * @return STATUS_NO_SNAPSHOT if the file could not be written
+    */
+    WarehouseStatus SaveSnapshot(const char *path, const std::vector<std::string> &checkpointNames,
+            long long outputBytes = -1) {
+        SnapshotWriter writer;
+        if ((log != NULL && !log->commit()) || !writer.open(path)) {
+            return STATUS_NO_SNAPSHOT;
+        }
 
+        SnapshotHeader &header = writer.getHeader();
+        header.numberRobots = numberRobots;
+        header.numberRows = numberRows;
+        header.numberColumns = numberColumns;
+        header.priorityLevels = priorityLevels;
+        header.rowStride = (uint32_t) rowStride;
+        header.numberCheckpoints = checkpoints.size();
+        header.checkpointStackSize = checkpointStack.size();
+        if (log != NULL) {
+            header.logID = log->getLogID();
+            header.logRecords = log->getNumberRecords();
+            header.logSequence = log->getNextSequence();
+        }
+        header.outputBytes = outputBytes;
+
+        writer.beginSection(SECTION_MAP);
+        std::vector<int> row(rowStride, 0);
+        for (int x = 0; x < numberRows; x++) {
+            if (tiles) {
+                tiles->copyRow(x, row.data());
+            } else {
+                memcpy(row.data(), map + x * rowStride, numberColumns * sizeof(int));
+            }
+            if (planner) {
+                for (int y = 0; y < numberColumns; y++) {
+                    if (planner->isObstacle(x, y)) {
+                        row[y] = -1;
+                    }
+                }
+            }
+            writer.write(row.data(), rowStride * sizeof(int));
+        }
+        writer.endSection();
+
+        writer.beginSection(SECTION_ROBOTS);
+        for (int i = 0; i < numberRobots; i++) {
+            SnapshotRobot robot;
+            robot.numberBoxes = robots[i].numberBoxes;
+            robot.positionX = robots[i].positionX;
+            robot.positionY = robots[i].positionY;
+            robot.numberCommands = robots[i].commandsQueue.size();
+            robot.time = robots[i].time;
+            writer.write(&robot, sizeof(robot));
+        }
+        writer.endSection();
+
+        writer.beginSection(SECTION_QUEUES);
+        for (int i = 0; i < numberRobots; i++) {
+            BucketQueue<QueuedCommand> &queue = robots[i].commandsQueue;
+            for (int level = queue.firstLevel(); level >= 0; level = queue.nextLevel(level)) {
+                RingDeque<QueuedCommand> &bucket = queue.bucket(level);
+                for (int j = 0; j < bucket.size(); j++) {
+                    SnapshotCommand command = { level, bucket.get(j) };
+                    writer.write(&command, sizeof(command));
                 }
             }
+        }
+        writer.endSection();
+
+        writer.beginSection(SECTION_HISTORY);
+        bool readable = commandsHistory.forEachChunk([&writer](const HistoryRecord *records, long count) {
+            writer.write(records, count * sizeof(HistoryRecord));
+        });
+        writer.endSection();
+
+        writer.beginSection(SECTION_CHECKPOINTS);
+        for (int pass = 0; pass < 2; pass++) {
+            const std::vector<Checkpoint> &list = pass == 0 ? checkpoints : checkpointStack;
+            for (size_t i = 0; i < list.size(); i++) {
+                SnapshotCheckpoint checkpoint = { list[i].checkpointID, list[i].serial, list[i].depth };
+                writer.write(&checkpoint, sizeof(checkpoint));
+            }
+        }
+        writer.endSection();
+
+        writer.beginSection(SECTION_PENDING);
+        for (size_t i = 0; i < pendingTasks.size(); i++) {
+            SnapshotCommand task = { pendingTasks[i].priority, pendingTasks[i].command };
+            writer.write(&task, sizeof(task));
+        }
+        writer.endSection();
 
-            outputString += "Executed";
+        writer.beginSection(SECTION_NAMES);
+        for (size_t i = 0; i < checkpointNames.size(); i++) {
+            writer.writeName(checkpointNames[i]);
         }
-        return outputString;
+        writer.endSection();
+
+        return writer.finish() && readable ? STATUS_EXECUTED : STATUS_NO_SNAPSHOT;
+    }
+
+    /**
+        * Takes the whole state of a new warehouse from a snapshot with the
+        * same dimensions and priority levels; a dense map is mapped
+        * straight from the file when its rows have the same stride, so
+        * only the pages that are used get read. The queues and the history are
+        * copied, then the obstacles and the region index are set up as
+        * FinishLoading() does
+        *
+        * @return False if the snapshot does not fit this warehouse
+    */
+    bool RestoreSnapshot(const SnapshotReader &snapshot) {
+        const SnapshotHeader &header = snapshot.getHeader();
+        if (header.numberRobots != numberRobots || header.numberRows != numberRows
+                || header.numberColumns != numberColumns || header.priorityLevels != priorityLevels
+                || !commandsHistory.isEmpty()) {
+            return false;
+        }
+
+        // Every queued command must belong to a robot and a level
+        const SnapshotRobot *savedRobots = (const SnapshotRobot *) snapshot.sectionData(SECTION_ROBOTS);
+        const SnapshotCommand *queued = (const SnapshotCommand *) snapshot.sectionData(SECTION_QUEUES);
+        uint64_t numberQueued = snapshot.sectionSize(SECTION_QUEUES) / sizeof(SnapshotCommand);
+        uint64_t expectedQueued = 0;
+        for (int i = 0; i < numberRobots; i++) {
+            if (savedRobots[i].numberCommands < 0) {
+                return false;
+            }
+            expectedQueued += savedRobots[i].numberCommands;
+        }
+        int numberLevels = priorityLevels > 0 ? priorityLevels : 1;
+        for (uint64_t i = 0; i < numberQueued; i++) {
+            if (queued[i].level < 0 || queued[i].level >= numberLevels) {
+                return false;
+            }
+        }
+        if (expectedQueued != numberQueued) {
+            return false;
+        }
+
+        int *cells = !tiles && header.rowStride == rowStride ? snapshot.mapCells() : NULL;
+        if (cells != NULL) {
+            free(map);
+            map = cells;
+            mappedMapBytes = snapshot.sectionSize(SECTION_MAP);
+        } else {
+            const int *savedMap = (const int *) snapshot.sectionData(SECTION_MAP);
+            for (int x = 0; x < numberRows; x++) {
+                LoadMapRow(x, savedMap + (size_t) x * header.rowStride);
+            }
+        }
+
+        for (int i = 0; i < numberRobots; i++) {
+            robots[i].numberBoxes = savedRobots[i].numberBoxes;
+            robots[i].positionX = savedRobots[i].positionX;
+            robots[i].positionY = savedRobots[i].positionY;
+            robots[i].time = savedRobots[i].time;
+            for (int j = 0; j < savedRobots[i].numberCommands; j++, queued++) {
+                robots[i].commandsQueue.addLast(queued->level, queued->command);
+            }
+#ifdef WAREHOUSE_STATS
+            stats.noteQueueDepth(i, robots[i].commandsQueue.size());
+#endif
+        }
+
+        commandsHistory.addAll((const HistoryRecord *) snapshot.sectionData(SECTION_HISTORY),
+                snapshot.sectionSize(SECTION_HISTORY) / sizeof(HistoryRecord));
+#ifdef WAREHOUSE_STATS
+        stats.noteHistorySize(commandsHistory.size());
+#endif
+
+        const SnapshotCheckpoint *savedCheckpoints =
+                (const SnapshotCheckpoint *) snapshot.sectionData(SECTION_CHECKPOINTS);
+        checkpoints.resize(header.numberCheckpoints);
+        checkpointStack.resize(header.checkpointStackSize);
+        for (size_t i = 0; i < checkpoints.size() + checkpointStack.size(); i++) {
+            Checkpoint &checkpoint = i < checkpoints.size() ? checkpoints[i] : checkpointStack[i - checkpoints.size()];
+            checkpoint.checkpointID = savedCheckpoints[i].checkpointID;
+            checkpoint.serial = savedCheckpoints[i].serial;
+            checkpoint.depth = savedCheckpoints[i].depth;
+        }
+
+        const SnapshotCommand *tasks = (const SnapshotCommand *) snapshot.sectionData(SECTION_PENDING);
+        pendingTasks.clear();
+        for (uint64_t i = 0; i < snapshot.sectionSize(SECTION_PENDING) / sizeof(SnapshotCommand); i++) {
+            pendingTasks.push_back(PendingTask(tasks[i].command, tasks[i].level));
+        }
+
+        FinishLoading();
+        return true;
+    }
+
+    /**
+        * Prints the counters of WarehouseStats; without WAREHOUSE_STATS
+        * there is nothing to print but a note
+        *
+        * @param output The buffer the lines are formatted into
+        * 
+    */
+    void PrintStats(OutputBuffer &output) {
+#ifdef WAREHOUSE_STATS
+        stats.print(output);
+#else
+        output.writeLine("STATS: Statistics are not compiled in");
+#endif
     }
 
     /**
         * Returns the number of boxes that the robot with the given ID has
         * at that time
         *
-        * @param outputString Constructs the string to be displayed
+        * @param output The buffer the line is formatted into
         * 
     */
-    std::string HowManyBoxes(int robotID) {
-        std::string outputString;
-        outputString += "HOW_MANY_BOXES: ";
+    void HowManyBoxes(int robotID, OutputBuffer &output) {
+        output.write("HOW_MANY_BOXES: ");
 
         int currentBoxes = robots[robotID].numberBoxes;
-        outputString += std::to_string(currentBoxes);
+        output.writeInt(currentBoxes);
+        output.writeChar('\n');
+    }
+
+    /**
+        * Returns the number of boxes in the cells of rows x1..x2 and
+        * columns y1..y2; the corners may be given in any order and the
+        * region is cut to the map
+        * O(log rows * log columns) with the region index, otherwise the
+        * cells are added up one by one
+        *
+        * @param output The buffer the line is formatted into
+        * 
+    */
+    void QueryRegion(int x1, int y1, int x2, int y2, OutputBuffer &output) {
+        if (x1 > x2) {
+            std::swap(x1, x2);
+        }
+        if (y1 > y2) {
+            std::swap(y1, y2);
+        }
+        x1 = std::max(x1, 0);
+        y1 = std::max(y1, 0);
+        x2 = std::min(x2, numberRows - 1);
+        y2 = std::min(y2, numberColumns - 1);
+
+        long long numberBoxes = 0;
+        if (x1 <= x2 && y1 <= y2) {
+            if (hasRegionIndex) {
+                numberBoxes = regionIndex.regionSum(x1, y1, x2, y2);
+            } else {
+                for (int x = x1; x <= x2; x++) {
+                    for (int y = y1; y <= y2; y++) {
+                        numberBoxes += cell(x, y);
+                    }
+                }
+            }
+        }
 
-        return outputString;
+        output.write("QUERY_REGION: ");
+        output.writeInt(numberBoxes);
+        output.writeChar('\n');
+    }
+
+    /**
+        * Returns the time the robot with the given ID has spent on the
+        * commands it executed, following the TimeModel of the warehouse;
+        * kept up to date by Execute and Undo, so it is never recomputed
+        *
+        * @param output The buffer the line is formatted into
+        * 
+    */
+    void HowMuchTime(int robotID, OutputBuffer &output) {
+        output.write("HOW_MUCH_TIME: ");
+        output.writeInt(robots[robotID].time);
+        output.writeChar('\n');
     }
 
 };
@@ -0,0 +1,203 @@
+/**
+ * Counters of a warehouse run, only built with WAREHOUSE_STATS
+ * (make STATS=1): commands and latency histograms per opcode, the
+ * deepest queue of every robot and the largest the history got
+ * Read through the STATS command and dumped as JSON at the end of a run
+ */
+
+#ifndef __WAREHOUSESTATS_H__
+#define __WAREHOUSESTATS_H__
+
+#ifdef WAREHOUSE_STATS
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+#include "CommandParser.h"
+#include "OutputBuffer.h"
+
+// Bucket i of a histogram counts the latencies of 2^i to 2^(i+1)-1 ns, the last one everything longer
+const int STATS_LATENCY_BUCKETS = 40;
+
+class WarehouseStats {
+private:
+    /**
+        Per opcode: the commands seen, the nanoseconds they took and their
+        histogram; commands run by the workers of ParallelRunner are
+        counted but not timed, so they are not in the histogram
+    */
+    long long counts[OP_INVALID + 1];
+    long long totalNanoseconds[OP_INVALID + 1];
+    long long latencies[OP_INVALID + 1][STATS_LATENCY_BUCKETS];
+
+    std::vector<int> maxQueueDepths;
+    long historyHighWater;
+
+    static int bucketOf(uint64_t nanoseconds) {
+        int bucket = nanoseconds > 0 ? 63 - __builtin_clzll(nanoseconds) : 0;
+        return bucket < STATS_LATENCY_BUCKETS ? bucket : STATS_LATENCY_BUCKETS - 1;
+    }
+
+    long long timedCount(int opcode) const {
+        long long timed = 0;
+        for (int b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+            timed += latencies[opcode][b];
+        }
+        return timed;
+    }
+
+    /**
+        Upper bound of the latency under which the given fraction of the
+        timed commands of an opcode stay, to the precision of the buckets
+    */
+    long long percentile(int opcode, double fraction) const {
+        long long timed = timedCount(opcode);
+        long long rank = (long long) (fraction * timed);
+        long long seen = 0;
+        for (int b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+            seen += latencies[opcode][b];
+            if (seen > rank) {
+                return (2LL << b) - 1;
+            }
+        }
+        return 0;
+    }
+
+public:
+    WarehouseStats(int numberRobots = 0) : maxQueueDepths(numberRobots, 0), historyHighWater(0) {
+        memset(counts, 0, sizeof(counts));
+        memset(totalNanoseconds, 0, sizeof(totalNanoseconds));
+        memset(latencies, 0, sizeof(latencies));
+    }
+
+    void record(int opcode, uint64_t nanoseconds) {
+        counts[opcode]++;
+        totalNanoseconds[opcode] += nanoseconds;
+        latencies[opcode][bucketOf(nanoseconds)]++;
+    }
+
+    void count(int opcode) {
+        counts[opcode]++;
+    }
+
+    // Robots are only updated by the thread driving them, see ParallelRunner
+    void noteQueueDepth(int robotID, int depth) {
+        if (depth > maxQueueDepths[robotID]) {
+            maxQueueDepths[robotID] = depth;
+        }
+    }
+
+    void noteHistorySize(long size) {
+        if (size > historyHighWater) {
+            historyHighWater = size;
+        }
+    }
+
+    // One line for the whole run, then one per opcode that was seen
+    void print(OutputBuffer &output) const {
+        long long numberCommands = 0;
+        for (int op = 0; op <= OP_INVALID; op++) {
+            numberCommands += counts[op];
+        }
+        int deepestRobot = 0;
+        for (int i = 1; i < (int) maxQueueDepths.size(); i++) {
+            if (maxQueueDepths[i] > maxQueueDepths[deepestRobot]) {
+                deepestRobot = i;
+            }
+        }
+
+        output.write("STATS: ");
+        output.writeInt(numberCommands);
+        output.write(" commands, history high-water ");
+        output.writeInt(historyHighWater);
+        output.write(", max queue depth ");
+        output.writeInt(maxQueueDepths.empty() ? 0 : maxQueueDepths[deepestRobot]);
+        output.write(" (robot ");
+        output.writeInt(deepestRobot);
+        output.write(")\n");
+
+        for (int op = 0; op <= OP_INVALID; op++) {
+            if (counts[op] == 0) {
+                continue;
+            }
+            output.write("STATS: ");
+            output.write(op == OP_INVALID ? "INVALID" : OpcodeName((Opcode) op));
+            output.writeChar(' ');
+            output.writeInt(counts[op]);
+            output.write(" p50 ");
+            output.writeInt(percentile(op, 0.5));
+            output.write(" ns p99 ");
+            output.writeInt(percentile(op, 0.99));
+            output.write(" ns\n");
+        }
+    }
+
+    /**
+        Writes everything as one JSON object; the histograms only list
+        their buckets that are not empty, as [lowest ns, commands]
+    */
+    void writeJson(FILE *file) const {
+        fprintf(file, "{\"history_high_water\": %ld, \"opcodes\": {", historyHighWater);
+        bool first = true;
+        for (int op = 0; op <= OP_INVALID; op++) {
+            if (counts[op] == 0) {
+                continue;
+            }
+            long long timed = timedCount(op);
+            fprintf(file, "%s\"%s\": {\"count\": %lld, \"timed\": %lld, \"mean_ns\": %.1f, "
+                    "\"p50_ns\": %lld, \"p99_ns\": %lld, \"histogram\": [",
+                    first ? "" : ", ", op == OP_INVALID ? "INVALID" : OpcodeName((Opcode) op),
+                    counts[op], timed, timed > 0 ? (double) totalNanoseconds[op] / timed : 0.0,
+                    percentile(op, 0.5), percentile(op, 0.99));
+            bool firstBucket = true;
+            for (int b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+                if (latencies[op][b] > 0) {
+                    fprintf(file, "%s[%lld, %lld]", firstBucket ? "" : ", ",
+                            b == 0 ? 0LL : 1LL << b, latencies[op][b]);
+                    firstBucket = false;
+                }
+            }
+            fprintf(file, "]}");
+            first = false;
+        }
+
+        fprintf(file, "}, \"max_queue_depth\": [");
+        for (size_t i = 0; i < maxQueueDepths.size(); i++) {
+            fprintf(file, "%s%d", i == 0 ? "" : ", ", maxQueueDepths[i]);
+        }
+        fprintf(file, "]}\n");
+    }
+};
+
+/**
+ * Times a command from its construction to its destruction and records
+ * it under the opcode
+ */
+class StatsTimer {
+private:
+    WarehouseStats &stats;
+    int opcode;
+    uint64_t start;
+
+    static uint64_t now() {
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+    }
+
+public:
+    StatsTimer(WarehouseStats &stats, int opcode)
+            : stats(stats), opcode(opcode >= 0 && opcode < OP_INVALID ? opcode : OP_INVALID),
+              start(now()) {}
+
+    ~StatsTimer() {
+        stats.record(opcode, now() - start);
+    }
+};
+
+#endif // WAREHOUSE_STATS
+
+#endif // __WAREHOUSESTATS_H__
@@ -0,0 +1,96 @@
+/**
+ * Thread pool for coarse independent tasks, such as whole scenarios
+ * Every worker has its own queue of tasks and takes them from the front;
+ * a worker whose queue is empty steals from the back of another one
+ */
+
+#ifndef __WORKSTEALINGPOOL_H__
+#define __WORKSTEALINGPOOL_H__
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+
+    int numberWorkers;
+    std::vector<std::unique_ptr<WorkerQueue> > queues;
+
+    WorkStealingPool(const WorkStealingPool &);
+    WorkStealingPool &operator=(const WorkStealingPool &);
+
+    bool takeOwn(int worker, int &task) {
+        WorkerQueue &queue = *queues[worker];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    // Tries the other queues in turn, starting with the next worker's
+    bool steal(int worker, int &task) {
+        for (int i = 1; i < numberWorkers; i++) {
+            WorkerQueue &queue = *queues[(worker + i) % numberWorkers];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.tasks.empty()) {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int worker, const std::function<void(int, int)> &function) {
+        int task;
+        while (takeOwn(worker, task) || steal(worker, task)) {
+            function(task, worker);
+        }
+    }
+
+public:
+    // Constructor
+    explicit WorkStealingPool(int numberWorkers)
+            : numberWorkers(numberWorkers > 1 ? numberWorkers : 1) {
+        for (int i = 0; i < this->numberWorkers; i++) {
+            queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        }
+    }
+
+    int size() const {
+        return numberWorkers;
+    }
+
+    /**
+     * Runs function(task, worker) for every task in [0, numberTasks)
+     * The tasks are dealt to the workers in turn, so every worker starts
+     * with the first tasks of the list; the caller is worker 0
+     */
+    void run(int numberTasks, const std::function<void(int, int)> &function) {
+        for (int i = 0; i < numberTasks; i++) {
+            queues[i % numberWorkers]->tasks.push_back(i);
+        }
+
+        std::vector<std::thread> threads;
+        for (int w = 1; w < numberWorkers; w++) {
+            threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, w, std::cref(function)));
+        }
+        workerLoop(0, function);
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+};
+
+#endif // __WORKSTEALINGPOOL_H__
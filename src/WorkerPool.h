@@ -0,0 +1,129 @@
+/**
+ * Fixed pool of worker threads
+ * The calling thread hands out a batch of independent tasks, takes part
+ * in running them and returns once all of them are done
+ */
+
+#ifndef __WORKERPOOL_H__
+#define __WORKERPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex lock;
+    std::condition_variable batchStarted;
+    std::condition_variable batchFinished;
+
+    // The current batch, replaced by every call of run()
+    const std::function<void(int, int)> *task;
+    int numberTasks;
+    unsigned long batch;            // counts the batches handed out
+    std::atomic<int> nextTask;
+    int busyWorkers;                // workers still inside the current batch
+    bool stopping;
+
+    WorkerPool(const WorkerPool &);
+    WorkerPool &operator=(const WorkerPool &);
+
+    // Takes tasks of the current batch until there are none left
+    void runTasks(int worker) {
+        int index;
+        while ((index = nextTask.fetch_add(1, std::memory_order_relaxed)) < numberTasks) {
+            (*task)(index, worker);
+        }
+    }
+
+    void workerLoop(int worker) {
+        unsigned long seenBatch = 0;
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (true) {
+            batchStarted.wait(guard, [&] { return stopping || batch != seenBatch; });
+            if (stopping) {
+                return;
+            }
+            seenBatch = batch;
+
+            guard.unlock();
+            runTasks(worker);
+            guard.lock();
+
+            if (--busyWorkers == 0) {
+                batchFinished.notify_one();
+            }
+        }
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param numberWorkers Threads running the tasks, including the
+     * caller of run(); 1 runs everything on the calling thread.
+     */
+    explicit WorkerPool(int numberWorkers)
+            : task(NULL), numberTasks(0), batch(0), nextTask(0), busyWorkers(0), stopping(false) {
+        for (int i = 1; i < numberWorkers; i++) {
+            threads.push_back(std::thread(&WorkerPool::workerLoop, this, i));
+        }
+    }
+
+    // Destructor
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        batchStarted.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+
+    /**
+     * Number of threads running the tasks, including the caller.
+     */
+    int size() const {
+        return (int) threads.size() + 1;
+    }
+
+    /**
+     * Runs function(task, worker) for every task in [0, numberTasks)
+     * Tasks are handed out in increasing order, so the longest ones
+     * should come first; worker is in [0, size()), the caller being 0
+     */
+    void run(int numberTasks, const std::function<void(int, int)> &function) {
+        if (threads.empty() || numberTasks <= 1) {
+            for (int i = 0; i < numberTasks; i++) {
+                function(i, 0);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            task = &function;
+            this->numberTasks = numberTasks;
+            nextTask.store(0, std::memory_order_relaxed);
+            busyWorkers = (int) threads.size();
+            batch++;
+        }
+        batchStarted.notify_all();
+
+        runTasks(0);
+
+        std::unique_lock<std::mutex> guard(lock);
+        batchFinished.wait(guard, [&] { return busyWorkers == 0; });
+        task = NULL;
+    }
+};
+
+#endif // __WORKERPOOL_H__
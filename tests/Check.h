@@ -0,0 +1,88 @@
+/**
+ * What the tests share: checks that count their failures, and runs of
+ * tema1 on an input written to a temporary directory
+ */
+
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// The executable under test, set by the Makefile to the tema1 just built
+#ifndef TEST_EXECUTABLE
+#define TEST_EXECUTABLE "./tema1"
+#endif
+
+static int numberFailures = 0;
+
+// Prints the check if it fails
+inline void Check(bool passed, const char *what) {
+    if (!passed) {
+        printf("FAILED: %s\n", what);
+        numberFailures++;
+    }
+}
+
+// Reads a whole file, empty if it can not be opened
+inline std::string ReadFile(const std::string &path) {
+    std::string contents;
+    FILE *file = fopen(path.c_str(), "r");
+    char buffer[4096];
+    size_t count;
+    while (file != NULL && (count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, count);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    return contents;
+}
+
+/**
+    Runs tema1 with the given options in a new temporary directory, with
+    the input as robots.in; files named by the options without a path are
+    created there and removed with it
+
+    @return What the run wrote to robots.out, or "exit status <n>" if it
+    did not finish successfully
+*/
+inline std::string RunInput(const std::string &input, const std::string &options = "") {
+    char directory[] = "/tmp/warehouse_testXXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        return "no temporary directory";
+    }
+    std::string inputPath = std::string(directory) + "/robots.in";
+    FILE *inputFile = fopen(inputPath.c_str(), "w");
+    if (inputFile == NULL || fwrite(input.data(), 1, input.size(), inputFile) != input.size()) {
+        return "no temporary file";
+    }
+    fclose(inputFile);
+
+    std::string command = std::string("cd ") + directory + " && " TEST_EXECUTABLE " "
+            + options + " > /dev/null 2>&1";
+    int status = system(command.c_str());
+    std::string output = ReadFile(std::string(directory) + "/robots.out");
+    command = std::string("rm -rf ") + directory;
+    if (system(command.c_str()) != 0) {
+        printf("could not remove %s\n", directory);
+    }
+
+    if (status != 0) {
+        char message[32];
+        snprintf(message, sizeof(message), "exit status %d", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return message;
+    }
+    return output;
+}
+
+// Prints the result of the test program, its exit status
+inline int Report(const char *test) {
+    printf("%s: %s\n", test, numberFailures == 0 ? "OK" : "FAILED");
+    return numberFailures == 0 ? 0 : 1;
+}
+
+#endif // __CHECK_H__
@@ -0,0 +1,58 @@
+/**
+ * Tests of the commands run by several threads: a command that does not
+ * run, because its cell can not be reached, must not reach the history,
+ * through ExecuteConcurrent() or through --threads
+ */
+
+#include "Check.h"
+#include "Warehouse.h"
+
+// Robot 1 is sent to the obstacle in the middle of the map
+static const char *UNREACHABLE_INPUT =
+        "2 3 3\n"
+        "4 4 4\n"
+        "4 -1 4\n"
+        "4 4 4\n"
+        "ADD_GET_BOX 0 0 0 2 1\n"
+        "ADD_GET_BOX 1 1 1 2 1\n"
+        "EXECUTE 0\n"
+        "EXECUTE 1\n"
+        "UNDO\n"
+        "LAST_EXECUTED_COMMAND\n"
+        "HOW_MANY_BOXES 0\n"
+        "UNDO\n"
+        "EXECUTE 1\n"
+        "LAST_EXECUTED_COMMAND\n";
+
+static void TestExecuteConcurrent() {
+    WarehouseOptions options;
+    options.pathPlanning = true;
+    Warehouse warehouse(2, 3, 3, options);
+    const int map[] = { 4, 4, 4, 4, -1, 4, 4, 4, 4 };
+    warehouse.LoadMap(map);
+
+    warehouse.AddGetBox(0, 0, 0, 2, 1);
+    warehouse.AddGetBox(1, 1, 1, 2, 1);
+    Check(warehouse.ExecuteConcurrent(1) == STATUS_UNREACHABLE, "the obstacle is unreachable");
+    warehouse.CommitConcurrentHistory();
+    Check(warehouse.Undo() == STATUS_NO_HISTORY, "an unreachable command is not in the history");
+
+    Check(warehouse.ExecuteConcurrent(0) == STATUS_EXECUTED, "a reachable command runs");
+    Check(warehouse.ExecuteConcurrent(1) == STATUS_UNREACHABLE, "the obstacle is still unreachable");
+    warehouse.CommitConcurrentHistory();
+    Check(warehouse.Undo() == STATUS_EXECUTED, "the reachable command is undone");
+    Check(warehouse.Undo() == STATUS_NO_HISTORY, "nothing else is in the history");
+}
+
+static void TestThreads() {
+    std::string expected = RunInput(UNREACHABLE_INPUT, "--path-planning");
+    Check(expected.find("Unreachable") != std::string::npos, "the sequential run reports the unreachable cell");
+    Check(RunInput(UNREACHABLE_INPUT, "--path-planning --threads 3") == expected,
+            "--threads writes the same robots.out");
+}
+
+int main() {
+    TestExecuteConcurrent();
+    TestThreads();
+    return Report("concurrent_test");
+}
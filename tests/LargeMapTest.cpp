@@ -0,0 +1,85 @@
+/**
+ * Tests of maps larger than 65536 rows or columns in the default build:
+ * a 100000 x 100000 warehouse is loaded tiled and run, and a 100000-row
+ * robots.in runs through the whole scenario; a map MAP_AUTO finds
+ * mostly used goes dense while it loads
+ */
+
+#include "Check.h"
+#include "Warehouse.h"
+
+const int LARGE_SIDE = 100000;
+
+static void TestSparseWarehouse() {
+    Check(Warehouse::SupportsDimensions(2, LARGE_SIDE, LARGE_SIDE), "the default build takes 100000 x 100000");
+
+    Warehouse warehouse(2, LARGE_SIDE, LARGE_SIDE);
+    Check(warehouse.IsMapTiled(), "a sparse 100000 x 100000 map is tiled");
+    warehouse.SetMapValue(LARGE_SIDE - 1, LARGE_SIDE - 1, 7);
+    warehouse.SetMapValue(70000, 3, 5);
+    warehouse.FinishLoading();
+    Check(warehouse.IsMapTiled(), "the map stays tiled once loaded");
+    Check(warehouse.MemoryUsage() < ((size_t) 64 << 20), "the map takes a few MB, not 40 GB");
+
+    warehouse.AddGetBox(0, LARGE_SIDE - 1, LARGE_SIDE - 1, 3, 1);
+    warehouse.AddGetBox(1, 70000, 3, 5, 1);
+    Check(warehouse.Execute(0) == STATUS_EXECUTED, "a GET on the last cell runs");
+    Check(warehouse.GetMapValue(LARGE_SIDE - 1, LARGE_SIDE - 1) == 4, "the GET takes its boxes");
+    Check(warehouse.Execute(1) == STATUS_EXECUTED, "a GET past row 65536 runs");
+    Check(warehouse.GetMapValue(70000, 3) == 0, "the GET takes all the boxes of the cell");
+    Check(warehouse.Undo() == STATUS_EXECUTED && warehouse.GetMapValue(70000, 3) == 5,
+            "UNDO puts the boxes back past row 65536");
+
+    // The executed command stays first in the queue, so the same GET runs again
+    Check(warehouse.Execute(0) == STATUS_EXECUTED && warehouse.GetMapValue(LARGE_SIDE - 1, LARGE_SIDE - 1) == 1,
+            "a second GET on the last cell runs");
+    Check(warehouse.Undo() == STATUS_EXECUTED && warehouse.GetMapValue(LARGE_SIDE - 1, LARGE_SIDE - 1) == 4,
+            "UNDO puts the boxes back on the last cell");
+}
+
+// With MAP_AUTO, a map that turns out mostly used goes dense after its first band of tiles
+static void TestAutoLayout() {
+    WarehouseOptions options;
+    options.autoTiledBytes = 0;
+    Warehouse warehouse(1, 1000, 1000, options);
+    Check(warehouse.IsMapTiled(), "MAP_AUTO starts tiled above autoTiledBytes");
+
+    std::vector<int> row(1000, 3);
+    int side = TiledMap::getTileSide();
+    for (int x = 0; x < side; x++) {
+        warehouse.LoadMapRow(x, row.data());
+    }
+    Check(!warehouse.IsMapTiled(), "a full band of tiles moves the map to a dense block");
+    for (int x = side; x < 1000; x++) {
+        warehouse.LoadMapRow(x, row.data());
+    }
+    warehouse.FinishLoading();
+    Check(warehouse.GetMapValue(0, 0) == 3 && warehouse.GetMapValue(999, 999) == 3,
+            "the rows before and after the move are kept");
+}
+
+// A map of 100000 rows and 2 columns, with boxes in the last row
+static void TestLargeInput() {
+    std::string input = "1 100000 2\n";
+    for (int x = 0; x < LARGE_SIDE - 1; x++) {
+        input += "0 0\n";
+    }
+    input += "9 4\n"
+            "ADD_GET_BOX 0 99999 0 6 1\n"
+            "EXECUTE 0\n"
+            "HOW_MANY_BOXES 0\n"
+            "UNDO\n"
+            "HOW_MANY_BOXES 0\n";
+
+    Check(RunInput(input) == "HOW_MANY_BOXES: 6\nHOW_MANY_BOXES: 0\n",
+            "a 100000-row robots.in runs");
+    Check(RunInput(input, "--map tiled") == "HOW_MANY_BOXES: 6\nHOW_MANY_BOXES: 0\n",
+            "a 100000-row robots.in runs on a tiled map");
+}
+
+int main() {
+    TestSparseWarehouse();
+    TestAutoLayout();
+    TestLargeInput();
+    return Report("large_map_test");
+}
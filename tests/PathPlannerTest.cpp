@@ -0,0 +1,67 @@
+/**
+ * Tests of the distance-field cache of PathPlanner: destinations asked
+ * for alike do not keep replacing each other's fields, and a plan gives
+ * the same distance whether it comes from a field or from A*, and a map
+ * above PATH_MAX_CELLS is refused
+ */
+
+#include "Check.h"
+#include "PathPlanner.h"
+
+const int GRID_SIDE = 40;
+
+static void AddWall(PathPlanner &planner) {
+    // A wall down the middle, open at the bottom
+    for (int x = 0; x < GRID_SIDE - 1; x++) {
+        planner.addObstacle(x, GRID_SIDE / 2);
+    }
+}
+
+static void TestAlternatingTargets() {
+    PathPlanner planner(GRID_SIDE, GRID_SIDE, 1);
+    AddWall(planner);
+
+    const int targetsX[] = { 0, 5, 10, 15 };
+    bool same = true;
+    for (int i = 0; i < 400; i++) {
+        int target = i % 4;
+        int fromY = i % (GRID_SIDE / 2);
+        int distance = planner.distance(0, fromY, targetsX[target], GRID_SIDE - 1);
+        // Down to the opening at the bottom of the wall, then right, then up
+        int expected = 3 * (GRID_SIDE - 1) - fromY - targetsX[target];
+        same = same && distance == expected;
+    }
+    Check(same, "the cache gives the shortest distances");
+    Check(planner.getNumberFields() <= 2, "targets asked for alike do not replace the only field");
+    Check(planner.getNumberHits() > 0, "the field that is kept answers plans");
+}
+
+static void TestHotTarget() {
+    PathPlanner planner(GRID_SIDE, GRID_SIDE, 1);
+    AddWall(planner);
+
+    // Every other plan goes to one cell, the rest to cells asked for once
+    for (int i = 0; i < 400; i++) {
+        if (i % 2 == 0) {
+            planner.distance(i % GRID_SIDE, 0, 0, GRID_SIDE - 1);
+        } else {
+            planner.distance(0, 0, i % GRID_SIDE, GRID_SIDE - 1 - i / GRID_SIDE);
+        }
+    }
+    Check(planner.getNumberFields() == 1, "cells asked for once never replace the field of a hot one");
+    Check(planner.getNumberHits() >= 190, "the hot cell is answered from its field");
+}
+
+static void TestTooLarge() {
+    Check(PathPlanner::SupportsGrid(8190, 8190) && !PathPlanner::SupportsGrid(8191, 8191),
+            "grids are planned on up to PATH_MAX_CELLS cells");
+    Check(RunInput("1 100000 100000\n", "--path-planning").find("exit status") == 0,
+            "--path-planning refuses a map above the limit");
+}
+
+int main() {
+    TestAlternatingTargets();
+    TestHotTarget();
+    TestTooLarge();
+    return Report("path_planner_test");
+}
@@ -0,0 +1,67 @@
+/**
+ * Tests of the packed command records: every coordinate the build
+ * supports and every box count come back as they were stored, and so
+ * UNDO restores cells holding more boxes than a narrower field would
+ */
+
+#include <climits>
+
+#include "Check.h"
+#include "CommandRecord.h"
+
+static void TestRoundTrip() {
+    const int boxes[] = { 0, 1, -1, 1 << 30, (1 << 30) + 1, INT_MAX, INT_MIN };
+    int last = QueuedCommand::maxCoordinate;
+    for (size_t i = 0; i < sizeof(boxes) / sizeof(boxes[0]); i++) {
+        QueuedCommand command(DROP, last, last - 1, boxes[i]);
+        Check(command.type() == DROP && command.x() == last && command.y() == last - 1,
+                "the type and the coordinates are stored");
+        Check(command.numberBoxes() == boxes[i], "the number of boxes is stored whole");
+    }
+}
+
+static void TestHistoryRecord() {
+    int last = QueuedCommand::maxCoordinate;
+    QueuedCommand command(GET, last, 0, -7);
+    HistoryRecord moved(HistoryRecord::maxRobotID, command, 0, last);
+    Check(moved.robotID() == HistoryRecord::maxRobotID && moved.originX() == 0 && moved.originY() == last,
+            "the robot and its cell are stored");
+    Check(moved.command().type() == GET && moved.command().x() == last && moved.command().y() == 0
+            && moved.command().numberBoxes() == -7, "the command is stored beside them");
+
+    HistoryRecord first(5, command);
+    Check(first.robotID() == 5 && first.originX() == -1 && first.originY() == -1,
+            "a robot without a cell before is stored as such");
+}
+
+// Robot 0 moves 2000000000 boxes from one cell to the next, then the DROP is undone
+static const char *LARGE_INPUT =
+        "1 1 2\n"
+        "2000000000 0\n"
+        "ADD_GET_BOX 0 0 0 2000000000 1\n"
+        "EXECUTE 0\n"
+        "ADD_DROP_BOX 0 0 1 2000000000 0\n"
+        "EXECUTE 0\n"
+        "HOW_MANY_BOXES 0\n"
+        "UNDO\n"
+        "HOW_MANY_BOXES 0\n";
+
+static void TestLargeUndo() {
+    std::string output = RunInput(LARGE_INPUT);
+    Check(output.find("HOW_MANY_BOXES: 0\nHOW_MANY_BOXES: 2000000000\n") != std::string::npos,
+            "UNDO gives the robot back all the boxes it dropped");
+}
+
+static void TestTooManyRobots() {
+    char input[64];
+    snprintf(input, sizeof(input), "%d 1 1\n0\n", HistoryRecord::maxRobotID + 2);
+    Check(RunInput(input).find("exit status") == 0, "more robots than the records can tell apart are refused");
+}
+
+int main() {
+    TestRoundTrip();
+    TestHistoryRecord();
+    TestTooManyRobots();
+    TestLargeUndo();
+    return Report("record_test");
+}
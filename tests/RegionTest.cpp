@@ -0,0 +1,92 @@
+/**
+ * Tests of QUERY_REGION: the sums of small regions, and the same
+ * robots.out with and without --region-index while EXECUTE and UNDO
+ * change the map
+ */
+
+#include <cstdio>
+
+#include "Check.h"
+
+static const char *MAP_INPUT =
+        "1 3 4\n"
+        "1 2 3 4\n"
+        "5 6 7 8\n"
+        "9 10 11 12\n"
+        "QUERY_REGION 0 0 2 3\n"
+        "QUERY_REGION 1 1 1 1\n"
+        "QUERY_REGION 2 3 1 2\n"
+        "QUERY_REGION -5 -5 0 100\n"
+        "QUERY_REGION 5 5 9 9\n"
+        "ADD_GET_BOX 0 1 1 4 1\n"
+        "EXECUTE 0\n"
+        "QUERY_REGION 0 0 2 3\n";
+
+static const char *MAP_OUTPUT =
+        "QUERY_REGION: 78\n"
+        "QUERY_REGION: 6\n"
+        "QUERY_REGION: 38\n"
+        "QUERY_REGION: 10\n"
+        "QUERY_REGION: 0\n"
+        "QUERY_REGION: 74\n";
+
+static void TestSums() {
+    Check(RunInput(MAP_INPUT) == MAP_OUTPUT, "the regions are added up");
+    Check(RunInput(MAP_INPUT, "--region-index") == MAP_OUTPUT, "the index gives the same sums");
+}
+
+// Commands from a fixed linear congruential sequence on a 30 x 30 map
+static std::string RandomInput() {
+    const int robots = 4, size = 30;
+    unsigned state = 12345;
+    char line[96];
+    snprintf(line, sizeof(line), "%d %d %d\n", robots, size, size);
+    std::string input = line;
+    for (int x = 0; x < size; x++) {
+        for (int y = 0; y < size; y++) {
+            state = state * 1103515245 + 12345;
+            snprintf(line, sizeof(line), "%u ", (state >> 16) % 50);
+            input += line;
+        }
+        input += "\n";
+    }
+
+    for (int i = 0; i < 3000; i++) {
+        state = state * 1103515245 + 12345;
+        unsigned value = state >> 8;
+        int robot = value % robots;
+        int x = (value >> 4) % size, y = (value >> 10) % size;
+        switch ((value >> 16) % 6) {
+        case 0:
+            snprintf(line, sizeof(line), "ADD_GET_BOX %d %d %d %u 1\n", robot, x, y, (value >> 20) % 20);
+            break;
+        case 1:
+            snprintf(line, sizeof(line), "ADD_DROP_BOX %d %d %d %u 0\n", robot, x, y, (value >> 20) % 20);
+            break;
+        case 2:
+            snprintf(line, sizeof(line), "EXECUTE %d\n", robot);
+            break;
+        case 3:
+            snprintf(line, sizeof(line), "UNDO %u\n", 1 + (value >> 20) % 3);
+            break;
+        default:
+            snprintf(line, sizeof(line), "QUERY_REGION %d %d %d %d\n", x, y, (value >> 20) % size, (value >> 25) % size);
+        }
+        input += line;
+    }
+    return input;
+}
+
+static void TestIndexMatchesScan() {
+    std::string input = RandomInput();
+    std::string scanned = RunInput(input);
+    Check(scanned.find("QUERY_REGION") != std::string::npos, "the random input queries regions");
+    Check(RunInput(input, "--region-index") == scanned,
+            "the index and the scan agree while the map changes");
+}
+
+int main() {
+    TestSums();
+    TestIndexMatchesScan();
+    return Report("region_test");
+}
@@ -0,0 +1,86 @@
+/**
+ * Tests of SNAPSHOT and --restore: a run cut at a snapshot and restored
+ * from it writes what the whole run writes, and a damaged snapshot is
+ * refused
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "Check.h"
+
+// The state at the snapshot: queued commands, a history, a checkpoint
+static const char *BEFORE =
+        "3 3 3\n"
+        "4 5 6\n"
+        "7 8 9\n"
+        "1 2 3\n"
+        "ADD_GET_BOX 0 0 0 2 1\n"
+        "ADD_GET_BOX 0 1 1 3 2\n"
+        "EXECUTE 0\n"
+        "CHECKPOINT first\n"
+        "ADD_DROP_BOX 1 2 2 1 0\n"
+        "ADD_GET_BOX 1 2 1 2 1\n"
+        "EXECUTE 1\n"
+        "EXECUTE 0\n"
+        "ADD_GET_BOX 2 0 2 6 3\n";
+
+static const char *AFTER =
+        "HOW_MANY_BOXES 0\n"
+        "HOW_MANY_BOXES 1\n"
+        "QUERY_REGION 0 0 2 2\n"
+        "EXECUTE 2\n"
+        "EXECUTE 1\n"
+        "UNDO 2\n"
+        "HOW_MANY_BOXES 1\n"
+        "HOW_MANY_BOXES 2\n"
+        "ROLLBACK_TO first\n"
+        "HOW_MANY_BOXES 0\n"
+        "QUERY_REGION 0 0 2 2\n"
+        "UNDO 3\n";
+
+static void TestRestore(const std::string &snapshotPath, const std::string &options) {
+    std::string snapshot = "SNAPSHOT " + snapshotPath + "\n";
+    std::string whole = RunInput(std::string(BEFORE) + snapshot + AFTER, options);
+    Check(whole.find("HOW_MANY_BOXES") != std::string::npos, "the whole run finishes");
+
+    std::string before = RunInput(std::string(BEFORE) + snapshot, options);
+    std::string after = RunInput(AFTER, options + " --restore " + snapshotPath);
+    Check(before + after == whole, "the restored run goes on as the whole run");
+    Check(RunInput(AFTER, options + " --trust-snapshot --restore " + snapshotPath) == after,
+            "--trust-snapshot restores the same state");
+}
+
+static void TestDamaged(const std::string &snapshotPath) {
+    RunInput(std::string(BEFORE) + "SNAPSHOT " + snapshotPath + "\n");
+    FILE *file = fopen(snapshotPath.c_str(), "r+b");
+    Check(file != NULL, "the snapshot is written");
+    if (file == NULL) {
+        return;
+    }
+
+    // One byte near the end of the file, in the last section
+    fseek(file, -1, SEEK_END);
+    int last = fgetc(file);
+    fseek(file, -1, SEEK_END);
+    fputc(last ^ 1, file);
+    fclose(file);
+    Check(RunInput(AFTER, "--restore " + snapshotPath).find("exit status") == 0,
+            "a snapshot that fails its checksum is refused");
+}
+
+int main() {
+    char snapshotPath[] = "/tmp/warehouse_snapshotXXXXXX";
+    int fd = mkstemp(snapshotPath);
+    if (fd < 0) {
+        return Report("snapshot_test");
+    }
+    close(fd);
+
+    TestRestore(snapshotPath, "");
+    TestRestore(snapshotPath, "--region-index");
+    TestDamaged(snapshotPath);
+    unlink(snapshotPath);
+    return Report("snapshot_test");
+}
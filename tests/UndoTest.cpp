@@ -0,0 +1,72 @@
+/**
+ * Tests of UNDO <n>, CHECKPOINT and ROLLBACK_TO: each must leave the
+ * warehouse as the same number of single UNDOs would, and print the same
+ */
+
+#include "Check.h"
+
+// Robot 0 and robot 1 take boxes three times from a 2 x 2 map
+static const char *EXECUTED =
+        "2 2 2\n"
+        "5 5\n"
+        "5 5\n"
+        "ADD_GET_BOX 0 0 0 2 1\n"
+        "EXECUTE 0\n"
+        "ADD_GET_BOX 1 0 1 3 1\n"
+        "EXECUTE 1\n"
+        "ADD_GET_BOX 0 1 0 1 1\n"
+        "EXECUTE 0\n";
+
+static const char *COUNTS =
+        "HOW_MANY_BOXES 0\n"
+        "HOW_MANY_BOXES 1\n";
+
+static void TestUndoMany() {
+    std::string single = RunInput(std::string(EXECUTED) + "UNDO\nUNDO\n" + COUNTS);
+    Check(single == "HOW_MANY_BOXES: 2\nHOW_MANY_BOXES: 0\n", "two UNDOs revert the last two commands");
+    Check(RunInput(std::string(EXECUTED) + "UNDO 2\n" + COUNTS) == single,
+            "UNDO 2 is the same as two UNDOs");
+    Check(RunInput(std::string(EXECUTED) + "UNDO 1\n" + COUNTS)
+            == RunInput(std::string(EXECUTED) + "UNDO\n" + COUNTS), "UNDO 1 is the same as UNDO");
+}
+
+static void TestShortHistory() {
+    std::string single = RunInput(std::string(EXECUTED) + "UNDO\nUNDO\nUNDO\nUNDO\nUNDO\n" + COUNTS);
+    Check(single == "UNDO: No History\nUNDO: No History\nHOW_MANY_BOXES: 0\nHOW_MANY_BOXES: 0\n",
+            "UNDOs past the history report it once each");
+    Check(RunInput(std::string(EXECUTED) + "UNDO 5\n" + COUNTS) == single,
+            "UNDO 5 on 3 commands prints what five UNDOs print");
+
+    // More lines than the output buffer holds
+    std::string lines;
+    for (int i = 0; i < 99997; i++) {
+        lines += "UNDO: No History\n";
+    }
+    Check(RunInput(std::string(EXECUTED) + "UNDO 100000\n") == lines,
+            "UNDO 100000 on 3 commands prints one line per missing command");
+}
+
+static void TestRollback() {
+    std::string input = std::string(EXECUTED) + "CHECKPOINT saved\n"
+            "ADD_GET_BOX 1 1 1 4 1\n"
+            "EXECUTE 1\n"
+            "ADD_GET_BOX 0 1 1 1 1\n"
+            "EXECUTE 0\n";
+    std::string undone = RunInput(input + "UNDO 2\n" + COUNTS);
+    Check(undone == "HOW_MANY_BOXES: 4\nHOW_MANY_BOXES: 3\n", "the commands after the checkpoint are undone");
+    Check(RunInput(input + "ROLLBACK_TO saved\n" + COUNTS) == undone,
+            "ROLLBACK_TO reverts what was executed after the checkpoint");
+    Check(RunInput(input + "ROLLBACK_TO saved\nROLLBACK_TO saved\n" + COUNTS) == undone,
+            "a checkpoint stays valid after rolling back to it");
+    Check(RunInput(input + "UNDO 3\nROLLBACK_TO saved\n").find("ROLLBACK_TO: No checkpoint") != std::string::npos,
+            "a checkpoint undone below is forgotten");
+    Check(RunInput(input + "ROLLBACK_TO never\n") == "ROLLBACK_TO: No checkpoint\n",
+            "a checkpoint that was never set is reported");
+}
+
+int main() {
+    TestUndoMany();
+    TestShortHistory();
+    TestRollback();
+    return Report("undo_test");
+}